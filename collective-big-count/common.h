@@ -30,9 +30,22 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
 #define PRIME_MODULUS 997
+#define INTER_HIGH_BASE 1000  // send_base of the high half of inter_comm (see coll_comm_t)
+#define BCAST_FIRST 0         // Element i of the bcast buffer is BCAST_FIRST + i
 
 /*
  * Debugging messages
@@ -44,6 +57,8 @@ int debug = 0;
 
 /*
  * Valid after MPI_Init
+ * While a communicator shape is running (see run_comm_shapes) world_size and
+ * world_rank are the size of, and the rank in, test_comm.
  */
 #ifndef MPI_MAX_PROCESSOR_NAME
 #define MPI_MAX_PROCESSOR_NAME 255
@@ -51,6 +66,47 @@ int debug = 0;
 int world_size = 0, world_rank = 0, local_size = 0;
 char my_hostname[MPI_MAX_PROCESSOR_NAME];
 
+/*
+ * Communicator shapes: run the collectives on subcommunicators of
+ * MPI_COMM_WORLD (BIGCOUNT_COMM_SHAPES, comma separated)
+ *  - world   : MPI_COMM_WORLD
+ *  - shared  : one communicator per node (MPI_COMM_TYPE_SHARED)
+ *  - leaders : the first process of every node
+ *  - split   : consecutive ranks in groups of 2, 4, 8, ... (< world size)
+ *  - inter   : intercommunicator between the two halves of MPI_COMM_WORLD
+ *              (only the tests that call run_comm_shapes_inter)
+ *  - all     : all of the above
+ */
+enum {
+      SHAPE_WORLD   = 0x01,
+      SHAPE_SHARED  = 0x02,
+      SHAPE_LEADERS = 0x04,
+      SHAPE_SPLIT   = 0x08,
+      SHAPE_INTER   = 0x10
+};
+#define SHAPE_ALL (SHAPE_WORLD | SHAPE_SHARED | SHAPE_LEADERS | SHAPE_SPLIT | SHAPE_INTER)
+int comm_shapes = SHAPE_WORLD;
+char comm_shape_name[32] = "world";
+
+/*
+ * Virtual topologies of the neighborhood collectives (BIGCOUNT_TOPOLOGIES,
+ * comma separated), created on test_comm (see run_topologies)
+ *  - cart2d : 2D Cartesian grid (MPI_Cart_create), 4 neighbors
+ *  - cart3d : 3D Cartesian grid, 6 neighbors
+ *  - graph  : distributed graph (MPI_Dist_graph_create_adjacent), each process
+ *             sends to the next 2 ranks and receives from the previous 2
+ * topo_blocks is the number of blocks (neighbors) of the running topology,
+ * 0 outside of run_topologies.
+ */
+enum {
+      TOPO_CART2D = 0x01,
+      TOPO_CART3D = 0x02,
+      TOPO_GRAPH  = 0x04
+};
+#define TOPO_ALL (TOPO_CART2D | TOPO_CART3D | TOPO_GRAPH)
+int topologies = TOPO_ALL;
+int topo_blocks = 0;
+
 /*
  * Limit how much total memory a collective can take on the system
  * across all processes.
@@ -67,6 +123,21 @@ int total_sys_mem_gb = 0;
  */
 int mem_diff_tolerance = 0;
 
+/*
+ * Memory budget of each node (shared memory domain, see init_environment).
+ * Nodes may differ in memory and number of processes: the count of a
+ * collective is the largest one that fits on every node (see node_max_count).
+ *  - num_nodes    : number of nodes (0 without MPI)
+ *  - node_budgets : processes and memory limit (as max_sys_mem_gb) of each node
+ */
+typedef struct {
+    int local_size;
+    int mem_gb;
+} node_budget_t;
+
+int num_nodes = 0;
+node_budget_t *node_budgets = NULL;
+
 /*
  * Percent of memory to allocate
  */
@@ -77,11 +148,200 @@ int mem_percent = 0;
  */
 bool allow_nonblocked = true;
 
+/*
+ * Allow the persistent collective (MPI_*_init) tests to run
+ *  - allow_persistent      : BIGCOUNT_ENABLE_PERSISTENT (y/Y/1 to enable)
+ *  - persistent_iterations : BIGCOUNT_PERSISTENT_ITERATIONS MPI_Start/MPI_Wait
+ *                            cycles per request (when timing is disabled)
+ */
+bool allow_persistent = false;
+int persistent_iterations = 3;
+
+/*
+ * Reference mode: also run the chunked implementation of the collective from
+ * reference.h and compare its time against the native collective
+ *  - allow_reference : BIGCOUNT_REFERENCE (y/Y/1 to enable)
+ *  - ref_chunk_bytes : BIGCOUNT_REFERENCE_CHUNK bytes per chunk
+ *  - ref_depth       : BIGCOUNT_REFERENCE_DEPTH chunks in flight
+ */
+#define REF_MAX_DEPTH 64
+bool allow_reference = false;
+size_t ref_chunk_bytes = (size_t)64 * 1024 * 1024;
+int ref_depth = 4;
+
+/*
+ * Collective variants
+ */
+enum {
+      COLL_BLOCKING    = 0,  // MPI_Allreduce
+      COLL_NONBLOCKING = 1,  // MPI_Iallreduce + MPI_Wait
+      COLL_PERSISTENT  = 2,  // MPI_Allreduce_init once, then MPI_Start + MPI_Wait
+      COLL_REFERENCE   = 3,  // ref_allreduce (chunked, see reference.h)
+      NUM_COLL_VARIANTS
+};
+
 /*
  * Algorithm expected inflation multiplier
  */
 double alg_inflation = 1.0;
 
+/*
+ * Timing mode: repeat each collective to measure latency and bandwidth
+ *  - timing_enabled    : BIGCOUNT_TIMING (y/Y/1 to enable)
+ *  - timing_warmup     : BIGCOUNT_TIMING_WARMUP untimed iterations
+ *  - timing_iterations : BIGCOUNT_TIMING_ITERATIONS timed iterations
+ */
+bool timing_enabled = false;
+int timing_warmup = 1;
+int timing_iterations = 5;
+
+/*
+ * Overlap mode: run a calibrated compute kernel between the start of the
+ * nonblocking collective and its MPI_Wait to measure asynchronous progress
+ *  - overlap_enabled : BIGCOUNT_OVERLAP (y/Y/1 to enable)
+ *  - overlap_poll_us : BIGCOUNT_OVERLAP_POLL microseconds of compute between
+ *                      MPI_Test calls (0 to never call MPI_Test)
+ */
+bool overlap_enabled = false;
+int overlap_poll_us = 0;
+
+/*
+ * Sweep mode: run the collective over a geometric series of payload sizes
+ * within a single MPI_Init (instead of the compiled in count)
+ *  - sweep_enabled : BIGCOUNT_SWEEP (y/Y/1 to enable)
+ *  - sweep_min     : BIGCOUNT_SWEEP_MIN smallest payload in bytes
+ *  - sweep_max     : BIGCOUNT_SWEEP_MAX largest payload in bytes
+ *  - sweep_factor  : BIGCOUNT_SWEEP_FACTOR ratio between consecutive payloads
+ *  - sweep_type    : BIGCOUNT_SWEEP_DATATYPE datatype (index in test_types, 'int' by default)
+ * The boundary payloads INT_MAX-1, INT_MAX, INT_MAX+1, UINT_MAX-1, UINT_MAX,
+ * UINT_MAX+1 and 2^33 bytes are added to the series (up to sweep_max).
+ */
+bool sweep_enabled = false;
+size_t sweep_min = (size_t)1024 * 1024;
+size_t sweep_max = (size_t)1 << 33;
+double sweep_factor = 4.0;
+int sweep_type = 0;
+
+/*
+ * Stride sweep: run the 'v' collectives over a list of displacement strides
+ * (disp_stride of MODE_SKIP, MODE_PACKED for a stride of 0), each in place
+ * and out of place, with the BIGCOUNT_SWEEP_DATATYPE datatype
+ *  - num_strides     : number of strides in BIGCOUNT_STRIDES (0 to disable)
+ *  - strides         : stride in elements, or in pages if stride_in_pages
+ *                      (e.g., '4p', converted to elements of the datatype)
+ * 'all' is 0,1,64,4096,1p,2p,16p.
+ */
+#define MAX_STRIDES 32
+int num_strides = 0;
+size_t strides[MAX_STRIDES];
+bool stride_in_pages[MAX_STRIDES];
+
+/*
+ * Structured results: one record per test case written by rank 0
+ *  - results_filename : BIGCOUNT_RESULTS_FILE (disabled if not set)
+ *  - results_csv      : BIGCOUNT_RESULTS_FORMAT 'csv' or 'json' (JSON Lines)
+ *                       Default: 'csv' if the filename ends in .csv, otherwise 'json'
+ */
+char *results_filename = NULL;
+bool results_csv = false;
+
+/*
+ * Progress journal: resume a sequence of tests after it was killed (e.g., by
+ * the OOM killer). Rank 0 of test_comm appends a 'start' record before each
+ * test case and a 'done' record after it. On restart the completed cases are
+ * skipped, and the count of a case that was started but never completed is
+ * lowered.
+ *  - journal_filename : BIGCOUNT_JOURNAL (disabled if not set)
+ *  - journal_shrink   : BIGCOUNT_JOURNAL_SHRINK factor applied to the count
+ *                       of a case for each run in which it did not complete
+ */
+char *journal_filename = NULL;
+double journal_shrink = 0.5;
+
+/*
+ * Name of the test program (basename of argv[0])
+ */
+char test_name[256] = "unknown";
+
+/*
+ * Percentage of the proposed count used by the last calc_uniform_count()/calc_coll_count()
+ */
+double count_adjust_perc = 100.0;
+
+/*
+ * Number of threads used to initialize and verify the buffers
+ *  - fill_threads : BIGCOUNT_THREADS (0 = all available threads)
+ * Only honored when built with OpenMP (-fopenmp), otherwise always serial.
+ */
+int fill_threads = 1;
+
+/*
+ * Memory instrumentation: sample the memory of the process before and after
+ * each collective to measure its temporary memory (see memtrack_report)
+ *  - memtrack_enabled : BIGCOUNT_MEMTRACK (y/Y/1 or 'smaps' to enable)
+ *  - memtrack_smaps   : BIGCOUNT_MEMTRACK=smaps also parses /proc/self/smaps_rollup
+ */
+bool memtrack_enabled = false;
+bool memtrack_smaps = false;
+
+/*
+ * Skew report: time stamp the entry and the exit of each collective call and
+ * report the arrival and completion skew across ranks (see skew_report)
+ *  - skew_enabled : BIGCOUNT_SKEW (y/Y/1 to enable)
+ *  - skew_top     : BIGCOUNT_SKEW_TOP number of slowest ranks to display
+ */
+bool skew_enabled = false;
+int skew_top = 3;
+
+/*
+ * Memory roofline: copy bandwidth of the node in GB/s (BIGCOUNT_ROOFLINE, as
+ * measured by diagnostic, 0 if not set). Each rank gets its share of the node
+ * (roofline_gbs / local_size), so the bandwidth of a collective is reported as
+ * a fraction of that share (see timer_roofline).
+ */
+double roofline_gbs = 0.0;
+
+/*
+ * Parallel fill/verify engine.
+ * Place immediately before a 'for' loop over buffer elements. The loop is
+ * split statically across 'fill_threads' threads (serial if 1 or if not built
+ * with OpenMP). Any extra OpenMP clauses can be passed, for example:
+ *   PARALLEL_FOR(private(exp) reduction(+:num_wrong))
+ * Variables assigned in the loop body must be listed as private, and
+ * counters must be listed in a reduction clause.
+ */
+#ifdef _OPENMP
+#define PARALLEL_PRAGMA(...) _Pragma(#__VA_ARGS__)
+#define PARALLEL_FOR(...) \
+    PARALLEL_PRAGMA(omp parallel for if(fill_threads > 1) num_threads(fill_threads) schedule(static) __VA_ARGS__)
+#else
+#define PARALLEL_FOR(...)
+#endif
+
+/*
+ * Buffer allocator for the collective payloads
+ *  - alloc_mode       : BIGCOUNT_ALLOC 'malloc', '4k', 'thp', 'hugetlb', 'shm',
+ *                       'mlock' or 'file'
+ *  - alloc_numa_local : BIGCOUNT_ALLOC modifier 'numa' (e.g., 'thp,numa')
+ *                       binds the buffer to the NUMA node of the calling process
+ *  - alloc_dir        : BIGCOUNT_ALLOC_DIR directory of the 'file' buffers
+ * Only buffers of at least ALLOC_MIN_SIZE bytes use the selected mode, smaller
+ * ones always come from malloc.
+ */
+enum {
+      ALLOC_MALLOC  = 0,  // malloc (default)
+      ALLOC_4K      = 1,  // mmap with transparent huge pages disabled
+      ALLOC_THP     = 2,  // mmap with transparent huge pages (madvise)
+      ALLOC_HUGETLB = 3,  // mmap from the hugetlbfs pool (falls back to thp)
+      ALLOC_SHM     = 4,  // POSIX shared memory segment (shm_open)
+      ALLOC_MLOCK   = 5,  // mmap locked in memory (mlock)
+      ALLOC_FILE    = 6   // Shared mmap of a file in alloc_dir
+};
+int alloc_mode = ALLOC_MALLOC;
+bool alloc_numa_local = false;
+char *alloc_dir = "/dev/shm";
+#define ALLOC_MIN_SIZE ((size_t)1 << 21)
+
 /*
  * 'v' collectives have two modes
  * Packed: contiguous packing of data
@@ -97,6 +357,275 @@ enum {
  */
 int disp_stride = 2;
 
+/*
+ * MPI-4 large count API
+ * Build with -DTEST_BIGCOUNT_API (see 'make bigcount') to call the MPI_Count
+ * ('_c') variants of the collectives (e.g., MPI_Allreduce_c) with MPI_Count
+ * counts and MPI_Aint displacements, so payloads can exceed INT_MAX elements.
+ *  - test_count_t   : type of the count arguments
+ *  - test_disp_t    : type of the displacement arguments
+ *  - TEST_COUNT_MAX : largest count (and displacement) supported
+ *  - MPI_COLL(fn)   : collective to call, e.g., MPI_COLL(MPI_Allreduce)(...)
+ */
+#ifdef TEST_BIGCOUNT_API
+#if defined(MPI_VERSION) && MPI_VERSION < 4
+#error "TEST_BIGCOUNT_API requires an MPI-4 implementation (MPI_Count collectives)"
+#endif
+#ifdef MPI_VERSION
+typedef MPI_Count test_count_t;
+typedef MPI_Aint test_disp_t;
+#endif
+#define TEST_COUNT_MAX ((size_t)LLONG_MAX)
+#define MPI_COLL(fn) fn ## _c
+#define V_SIZE_TYPE size_t
+#else
+typedef int test_count_t;
+typedef int test_disp_t;
+#define TEST_COUNT_MAX ((size_t)INT_MAX)
+#define MPI_COLL(fn) fn
+#define V_SIZE_TYPE int
+#endif
+
+/*
+ * Communicator of the collectives under test (see run_comm_shapes)
+ */
+#ifdef MPI_VERSION
+MPI_Comm test_comm = MPI_COMM_WORLD;
+
+/*
+ * Intercommunicator shape (see run_comm_shapes)
+ *  - inter_comm        : intercommunicator between the low and the high half
+ *                        of MPI_COMM_WORLD (MPI_COMM_NULL in the other shapes)
+ *  - inter_rank        : rank in the local group
+ *  - inter_size        : size of the local group
+ *  - inter_remote_size : size of the remote group
+ *  - inter_low         : true in the low half, the root group of the rooted collectives
+ * The collectives under test use inter_comm. test_comm is the merged
+ * intracommunicator (low half first) used to report the results, so
+ * world_size and world_rank are the size of, and the rank in, it.
+ */
+MPI_Comm inter_comm = MPI_COMM_NULL;
+int inter_rank = 0, inter_size = 0, inter_remote_size = 0;
+bool inter_low = false;
+bool inter_supported = false;
+
+/*
+ * Communicator of a test case: test_comm, or inter_comm in the 'inter' shape
+ *  - comm      : communicator of the collective
+ *  - rank      : rank in comm (in the local group for inter_comm)
+ *  - peers     : number of per-process blocks of the collective (the size of
+ *                the remote group for inter_comm)
+ *  - blocks    : number of blocks to divide a payload into. The groups of
+ *                inter_comm may differ in size, so that is the size of
+ *                test_comm in both of them (then the counts match)
+ *  - root      : root argument of the rooted collectives
+ *  - is_root   : this process is the root (rank 0, or rank 0 of the low half)
+ *  - inter     : comm is inter_comm
+ *  - send_base : offset of the values that this process sends
+ *  - recv_base : offset of the values that this process receives (the
+ *                send_base of the remote group, so that data that comes
+ *                from the local group is detected)
+ */
+typedef struct {
+    MPI_Comm comm;
+    int rank;
+    int peers;
+    int blocks;
+    int root;
+    bool is_root;
+    bool inter;
+    int send_base;
+    int recv_base;
+} coll_comm_t;
+
+/*
+ * Root argument of a rooted collective on inter_comm (root: rank 0 of the low half)
+ *
+ * @return MPI_ROOT at the root, MPI_PROC_NULL at the rest of the low half,
+ *         0 (the root in the remote group) in the high half
+ */
+static inline int inter_root(void)
+{
+    if( !inter_low ) {
+        return 0;
+    }
+    return (0 == inter_rank) ? MPI_ROOT : MPI_PROC_NULL;
+}
+
+/*
+ * Set up the communicator of a test case (see coll_comm_t)
+ *
+ * @param cc (OUT) communicator of the test case
+ */
+static inline void coll_comm_init(coll_comm_t *cc)
+{
+    cc->inter = (MPI_COMM_NULL != inter_comm);
+    cc->blocks = world_size;
+    if( !cc->inter ) {
+        cc->comm = test_comm;
+        cc->rank = world_rank;
+        cc->peers = world_size;
+        cc->root = 0;
+        cc->is_root = (0 == world_rank);
+        cc->send_base = cc->recv_base = 0;
+    } else {
+        cc->comm = inter_comm;
+        cc->rank = inter_rank;
+        cc->peers = inter_remote_size;
+        cc->root = inter_root();
+        cc->is_root = inter_low && 0 == inter_rank;
+        cc->send_base = inter_low ? 0 : INTER_HIGH_BASE;
+        cc->recv_base = inter_low ? INTER_HIGH_BASE : 0;
+    }
+}
+
+/*
+ * Virtual topology of the neighborhood collectives (see run_topologies)
+ *  - name         : name of the topology (e.g., "cart2d")
+ *  - comm         : communicator with the topology (same ranks as test_comm)
+ *  - dims         : processes in each dimension (Cartesian topologies)
+ *  - indegree     : number of sources (receive blocks)
+ *  - outdegree    : number of destinations (send blocks)
+ *  - sources      : rank of each source in the neighborhood order, or MPI_PROC_NULL
+ *  - destinations : rank of each destination, or MPI_PROC_NULL
+ *  - blocks       : largest degree, the same at all processes
+ * A Cartesian dimension is periodic only if it has at least 3 processes.
+ * Otherwise a process would be the neighbor twice in that dimension, and the
+ * two messages between the pair could match in either order.
+ */
+#define TOPO_MAX_DEGREE 6
+
+typedef struct {
+    const char *name;
+    MPI_Comm comm;
+    int ndims;
+    int dims[3];
+    int indegree;
+    int outdegree;
+    int sources[TOPO_MAX_DEGREE];
+    int destinations[TOPO_MAX_DEGREE];
+    int blocks;
+} test_topo_t;
+
+/*
+ * Topology of the running neighborhood collective (NULL outside run_topologies)
+ */
+const test_topo_t *test_topo = NULL;
+
+/*
+ * Create a virtual topology on test_comm
+ *
+ * @param topo TOPO_CART2D, TOPO_CART3D or TOPO_GRAPH
+ * @param tp (OUT) topology
+ */
+static void topo_create(int topo, test_topo_t *tp)
+{
+    int periods[3], weights[TOPO_MAX_DEGREE], degree, d;
+
+    memset(tp, 0, sizeof(test_topo_t));
+    if( TOPO_GRAPH == topo ) {
+        // Ring with skips: a single process is its own neighbor, two are each other's
+        degree = (world_size > 2) ? 2 : 1;
+        for( d = 0; d < degree; ++d ) {
+            tp->destinations[d] = (world_rank + d + 1) % world_size;
+            tp->sources[d] = (world_rank + world_size - d - 1) % world_size;
+            // Unit weights: GCC flags MPI_UNWEIGHTED (a constant address) as a zero size array
+            weights[d] = 1;
+        }
+        tp->name = "graph";
+        tp->indegree = tp->outdegree = tp->blocks = degree;
+        MPI_Dist_graph_create_adjacent(test_comm, degree, tp->sources, weights,
+                                       degree, tp->destinations, weights,
+                                       MPI_INFO_NULL, 0, &tp->comm);
+        return;
+    }
+
+    tp->name = (TOPO_CART2D == topo) ? "cart2d" : "cart3d";
+    tp->ndims = (TOPO_CART2D == topo) ? 2 : 3;
+    MPI_Dims_create(world_size, tp->ndims, tp->dims);
+    for( d = 0; d < tp->ndims; ++d ) {
+        periods[d] = (tp->dims[d] >= 3) ? 1 : 0;
+    }
+    MPI_Cart_create(test_comm, tp->ndims, tp->dims, periods, 0, &tp->comm);
+    // Neighborhood order: the -1 then the +1 neighbor of each dimension
+    for( d = 0; d < tp->ndims; ++d ) {
+        MPI_Cart_shift(tp->comm, d, 1, &tp->sources[2 * d], &tp->sources[2 * d + 1]);
+        tp->destinations[2 * d] = tp->sources[2 * d];
+        tp->destinations[2 * d + 1] = tp->sources[2 * d + 1];
+    }
+    tp->indegree = tp->outdegree = tp->blocks = 2 * tp->ndims;
+}
+
+/*
+ * Value of an element of the block that a process sends to a neighbor in the
+ * neighborhood collectives. Each source of a process sends different values.
+ *
+ * @param src rank of the sender in test_topo->comm
+ * @param dst rank of the receiver (0 for the allgathers, the same block goes to all)
+ * @param k index of the element in the block
+ * @return value of the element
+ */
+static inline int64_t neighbor_value(int src, int dst, size_t k)
+{
+    return (int64_t)(k % PRIME_MODULUS) + (src + 1) * 2 + dst;
+}
+
+/*
+ * Payload that a neighborhood collective actually moves at this process: the
+ * bytes received from the sources that are not MPI_PROC_NULL (the boundary of
+ * a non-periodic Cartesian grid exchanges nothing)
+ *
+ * @param tp topology
+ * @param counts number of elements of each receive block, NULL if all the
+ *               blocks have block_count elements
+ * @param block_count number of elements of each receive block (counts NULL)
+ * @param size size of an element in bytes
+ * @return number of bytes received from the real neighbors
+ */
+static inline size_t topo_moved_bytes(const test_topo_t *tp, const test_count_t *counts,
+                                      size_t block_count, size_t size)
+{
+    size_t bytes = 0;
+    int j;
+
+    for( j = 0; j < tp->indegree; ++j ) {
+        if( MPI_PROC_NULL != tp->sources[j] ) {
+            bytes += ((NULL != counts) ? (size_t)counts[j] : block_count) * size;
+        }
+    }
+    return bytes;
+}
+#endif
+
+/*
+ * Persistent collectives: MPI-4, or the Open MPI 'pcollreq' extension (MPIX_)
+ *  - MPI_PCOLL(name)      : e.g., MPI_PCOLL(Allreduce)(..., MPI_INFO_NULL, &request)
+ *  - HAVE_PERSISTENT_COLL : defined if persistent collectives are available
+ */
+#ifdef MPI_VERSION
+#if defined(OPEN_MPI) && MPI_VERSION < 4
+#include <mpi-ext.h>
+#endif
+#if defined(TEST_BIGCOUNT_API)
+#define MPI_PCOLL(name) MPI_ ## name ## _init_c
+#define HAVE_PERSISTENT_COLL 1
+#elif MPI_VERSION >= 4
+#define MPI_PCOLL(name) MPI_ ## name ## _init
+#define HAVE_PERSISTENT_COLL 1
+#elif defined(OMPI_HAVE_MPI_EXT_PCOLLREQ)
+#define MPI_PCOLL(name) MPIX_ ## name ## _init
+#define HAVE_PERSISTENT_COLL 1
+#else
+#define MPI_PCOLL(name) pcoll_unsupported
+static int pcoll_unsupported(const void *buf, ...)
+{
+    fprintf(stderr, "Rank %d on %s) Error: Persistent collectives are not supported\n", world_rank, my_hostname);
+    MPI_Abort(MPI_COMM_WORLD, 3);
+    return MPI_ERR_OTHER;
+}
+#endif
+#endif
+
 /*
  * Define count paramters to use in the tests
  */
@@ -109,27 +638,42 @@ int disp_stride = 2;
 #ifndef TEST_UNIFORM_COUNT
 #ifndef V_SIZE_DOUBLE_COMPLEX
 // double _Complex  = 16 bytes x  268435455.9375
-#define V_SIZE_DOUBLE_COMPLEX    (int)(TEST_PAYLOAD_SIZE / sizeof(double _Complex))
+#define V_SIZE_DOUBLE_COMPLEX    (V_SIZE_TYPE)(TEST_PAYLOAD_SIZE / sizeof(double _Complex))
 #endif
 
 #ifndef V_SIZE_DOUBLE
 // double           =  8 bytes x  536870911.875
-#define V_SIZE_DOUBLE            (int)(TEST_PAYLOAD_SIZE / sizeof(double))
+#define V_SIZE_DOUBLE            (V_SIZE_TYPE)(TEST_PAYLOAD_SIZE / sizeof(double))
 #endif
 
 #ifndef V_SIZE_FLOAT_COMPLEX
 // float _Complex   =  8 bytes x  536870911.875
-#define V_SIZE_FLOAT_COMPLEX     (int)(TEST_PAYLOAD_SIZE / sizeof(float _Complex))
+#define V_SIZE_FLOAT_COMPLEX     (V_SIZE_TYPE)(TEST_PAYLOAD_SIZE / sizeof(float _Complex))
 #endif
 
 #ifndef V_SIZE_FLOAT
 // float            =  4 bytes x 1073741823.75
-#define V_SIZE_FLOAT             (int)(TEST_PAYLOAD_SIZE / sizeof(float))
+#define V_SIZE_FLOAT             (V_SIZE_TYPE)(TEST_PAYLOAD_SIZE / sizeof(float))
 #endif
 
 #ifndef V_SIZE_INT
 // int              =  4 bytes x 1073741823.75
-#define V_SIZE_INT               (int)(TEST_PAYLOAD_SIZE / sizeof(int))
+#define V_SIZE_INT               (V_SIZE_TYPE)(TEST_PAYLOAD_SIZE / sizeof(int))
+#endif
+
+#ifndef V_SIZE_INT64
+// int64_t          =  8 bytes x  536870911.875
+#define V_SIZE_INT64             (V_SIZE_TYPE)(TEST_PAYLOAD_SIZE / sizeof(int64_t))
+#endif
+
+#ifndef V_SIZE_CHAR
+// unsigned char    =  1 byte  x 4294967295
+#define V_SIZE_CHAR              (V_SIZE_TYPE)(TEST_PAYLOAD_SIZE / sizeof(unsigned char))
+#endif
+
+#ifndef V_SIZE_CONTIG
+// 2 x int          =  8 bytes x  536870911.875
+#define V_SIZE_CONTIG            (V_SIZE_TYPE)(TEST_PAYLOAD_SIZE / (2 * sizeof(int)))
 #endif
 
 #else
@@ -138,11 +682,204 @@ int disp_stride = 2;
 #define V_SIZE_FLOAT_COMPLEX     TEST_UNIFORM_COUNT
 #define V_SIZE_FLOAT             TEST_UNIFORM_COUNT
 #define V_SIZE_INT               TEST_UNIFORM_COUNT
+#define V_SIZE_INT64             TEST_UNIFORM_COUNT
 #define V_SIZE_CHAR              TEST_UNIFORM_COUNT
+#define V_SIZE_CONTIG            TEST_UNIFORM_COUNT
+#endif
+
+/*
+ * Buffers allocated with mmap by safe_malloc (released by safe_free)
+ */
+typedef struct alloc_region {
+    void *ptr;
+    size_t size;
+    struct alloc_region *next;
+} alloc_region_t;
+alloc_region_t *alloc_regions = NULL;
+
+/*
+ * String representation of the allocator mode
+ *
+ * @return static string
+ */
+static inline const char * alloc_mode_name(void)
+{
+    static char *names[] = {"malloc", "4k", "thp", "hugetlb", "shm", "mlock", "file"};
+    return names[alloc_mode];
+}
+
+/*
+ * Size of the default huge page (Hugepagesize in /proc/meminfo)
+ *
+ * @return huge page size in bytes (2 MB if unknown)
+ */
+static size_t get_hugepage_size(void)
+{
+    static size_t hugepage_size = 0;
+    FILE *meminfo_file;
+    char line[256];
+
+    if( 0 != hugepage_size ) {
+        return hugepage_size;
+    }
+
+    hugepage_size = (size_t)2 * 1024 * 1024;
+    meminfo_file = fopen("/proc/meminfo", "r");
+    if( NULL != meminfo_file ) {
+        while( NULL != fgets(line, sizeof(line), meminfo_file) ) {
+            if( 0 == strncmp(line, "Hugepagesize:", 13) ) {
+                hugepage_size = (size_t)strtoul(line + 13, NULL, 10) * 1024;
+                break;
+            }
+        }
+        fclose(meminfo_file);
+    }
+    return hugepage_size;
+}
+
+/*
+ * Bind a buffer to the NUMA node of the CPU that this process is running on.
+ * Uses the raw system calls so that libnuma is not required.
+ *
+ * @param ptr start of the buffer (page aligned)
+ * @param sz size of the buffer
+ */
+static void bind_local_numa(void *ptr, size_t sz)
+{
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+    static bool warned = false;
+    unsigned int cpu = 0, node = 0;
+    unsigned long nodemask[16];
+    const int mpol_bind = 2; // MPOL_BIND in <numaif.h>
+
+    if( 0 != syscall(SYS_getcpu, &cpu, &node, NULL) ||
+        node >= sizeof(nodemask) * 8 ) {
+        return;
+    }
+    memset(nodemask, 0, sizeof(nodemask));
+    nodemask[node / (sizeof(unsigned long) * 8)] = 1UL << (node % (sizeof(unsigned long) * 8));
+
+    if( 0 != syscall(SYS_mbind, ptr, sz, mpol_bind, nodemask, sizeof(nodemask) * 8, 0) && !warned ) {
+        fprintf(stderr, "Rank %d on %s) Warning: Failed to bind buffer to NUMA node %u: %s\n",
+                world_rank, my_hostname, node, strerror(errno));
+        warned = true;
+    }
 #endif
+}
+
+/*
+ * Map a new POSIX shared memory segment (ALLOC_SHM) or file in alloc_dir
+ * (ALLOC_FILE). The name is removed right away, so the memory is released
+ * by munmap (or when the process exits). The space is reserved with
+ * posix_fallocate so that a full tmpfs fails here rather than with a
+ * SIGBUS when the buffer is first touched.
+ *
+ * @param sz size of the buffer
+ * @return pointer to the memory, or MAP_FAILED on error
+ */
+static void * mmap_shared(size_t sz)
+{
+    static int seq = 0;
+    char name[PATH_MAX];
+    void * ptr = MAP_FAILED;
+    int fd, rc;
+
+    if( ALLOC_SHM == alloc_mode ) {
+        snprintf(name, sizeof(name), "/bigcount-%d-%d", (int)getpid(), seq++);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if( fd >= 0 ) {
+            shm_unlink(name);
+        }
+    } else {
+        snprintf(name, sizeof(name), "%s/bigcount-%d-%d", alloc_dir, (int)getpid(), seq++);
+        fd = open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if( fd >= 0 ) {
+            unlink(name);
+        }
+    }
+    if( fd < 0 ) {
+        fprintf(stderr, "Rank %d on %s) Error: Failed to create %s: %s\n",
+                world_rank, my_hostname, name, strerror(errno));
+        return MAP_FAILED;
+    }
+
+    rc = posix_fallocate(fd, 0, (off_t)sz);
+    if( 0 == rc ) {
+        ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    } else {
+        fprintf(stderr, "Rank %d on %s) Error: Failed to allocate %zu bytes in %s: %s\n",
+                world_rank, my_hostname, sz, name, strerror(rc));
+    }
+    close(fd);
+    return ptr;
+}
+
+/*
+ * Allocate a buffer with mmap according to the BIGCOUNT_ALLOC mode
+ *
+ * @param sz size of the buffer
+ * @param map_size (OUT) size of the mapping
+ * @return pointer to the memory, or NULL on error
+ */
+static void * mmap_alloc(size_t sz, size_t *map_size)
+{
+    static bool warned = false;
+    size_t hp_size;
+    void * ptr = MAP_FAILED;
+
+    *map_size = sz;
+    if( ALLOC_SHM == alloc_mode || ALLOC_FILE == alloc_mode ) {
+        ptr = mmap_shared(sz);
+        if( MAP_FAILED == ptr ) {
+            return NULL;
+        }
+    }
+#ifdef MAP_HUGETLB
+    if( ALLOC_HUGETLB == alloc_mode ) {
+        hp_size = get_hugepage_size();
+        *map_size = ((sz + hp_size - 1) / hp_size) * hp_size;
+        ptr = mmap(NULL, *map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if( MAP_FAILED == ptr && !warned ) {
+            fprintf(stderr, "Rank %d on %s) Warning: Failed to mmap(%zu) from the huge page pool (%s). Falling back to thp\n",
+                    world_rank, my_hostname, *map_size, strerror(errno));
+            warned = true;
+        }
+    }
+#endif
+    if( MAP_FAILED == ptr ) {
+        *map_size = sz;
+        ptr = mmap(NULL, *map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if( MAP_FAILED == ptr ) {
+            return NULL;
+        }
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+        if( ALLOC_4K == alloc_mode ) {
+            madvise(ptr, *map_size, MADV_NOHUGEPAGE);
+        } else if( ALLOC_THP == alloc_mode || ALLOC_HUGETLB == alloc_mode ) {
+            madvise(ptr, *map_size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    if( ALLOC_MLOCK == alloc_mode && 0 != mlock(ptr, *map_size) && !warned ) {
+        fprintf(stderr, "Rank %d on %s) Warning: Failed to mlock(%zu) (%s). Check the locked memory limit (ulimit -l)\n",
+                world_rank, my_hostname, *map_size, strerror(errno));
+        warned = true;
+    }
+
+    if( alloc_numa_local ) {
+        bind_local_numa(ptr, *map_size);
+    }
+
+    return ptr;
+}
 
 /*
  * Wrapper around 'malloc' that errors out if we cannot allocate the buffer.
+ * Large buffers are allocated according to BIGCOUNT_ALLOC.
+ * Release the buffer with safe_free().
  *
  * @param sz size of the buffer
  * @return pointer to the memory. Does not return on error.
@@ -150,7 +887,23 @@ int disp_stride = 2;
 static inline void * safe_malloc(size_t sz)
 {
     void * ptr = NULL;
-    ptr = malloc(sz);
+    alloc_region_t *region = NULL;
+
+    if( sz >= ALLOC_MIN_SIZE && (ALLOC_MALLOC != alloc_mode || alloc_numa_local) ) {
+        region = (alloc_region_t*)malloc(sizeof(alloc_region_t));
+        if( NULL != region ) {
+            ptr = mmap_alloc(sz, &region->size);
+            if( NULL != ptr ) {
+                region->ptr = ptr;
+                region->next = alloc_regions;
+                alloc_regions = region;
+            } else {
+                free(region);
+            }
+        }
+    } else {
+        ptr = malloc(sz);
+    }
     if( NULL == ptr ) {
         fprintf(stderr, "Rank %d on %s) Error: Failed to malloc(%zu)\n", world_rank, my_hostname, sz);
 #ifdef MPI_VERSION
@@ -159,9 +912,40 @@ static inline void * safe_malloc(size_t sz)
         exit(ENOMEM);
 #endif
     }
+    if( memtrack_enabled ) {
+        // Touch the pages so that they are resident before the collective
+        memset(ptr, 0, sz);
+    }
     return ptr;
 }
 
+/*
+ * Release a buffer allocated by safe_malloc()
+ *
+ * @param ptr pointer to the memory (may be NULL)
+ */
+static inline void safe_free(void *ptr)
+{
+    alloc_region_t **prev = &alloc_regions;
+    alloc_region_t *region;
+
+    if( NULL == ptr ) {
+        return;
+    }
+
+    for( region = alloc_regions; NULL != region; region = region->next ) {
+        if( ptr == region->ptr ) {
+            munmap(region->ptr, region->size);
+            *prev = region->next;
+            free(region);
+            return;
+        }
+        prev = &region->next;
+    }
+
+    free(ptr);
+}
+
 /*
  * Convert a value in whole bytes to the abbreviated form
  *
@@ -187,11 +971,1107 @@ static inline const char * human_bytes(size_t value)
 }
 
 /*
- * Determine amount of memory to use, in GBytes as a percentage of total physical memory
- *
- * @return Amount of memory to use (in GB)
+ * Vectorized checkers for the PRIME_MODULUS patterns:
+ *   expected[j] = ((start + j) % PRIME_MODULUS) * scale + base
+ * The modulus is only computed once per chunk. The expected values are then
+ * produced incrementally (wrap by compare & subtract instead of a division).
+ * Uses AVX-512 or AVX2 when the compiler targets them (e.g., -mavx2, -mavx512f
+ * or -march=native), otherwise a portable scalar loop.
  */
-static int get_max_memory(void) {
+#define CHECK_CHUNK_SIZE ((size_t)1 << 20)
+
+static inline size_t check_prime_pattern_int_chunk(const int *buf, size_t count,
+                                                   size_t start, int scale, int base,
+                                                   size_t *first_bad)
+{
+    size_t j = 0;
+    size_t num_wrong = 0;
+    int phase = (int)(start % PRIME_MODULUS);
+
+#if defined(__AVX512F__)
+    const __m512i iota  = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i v_mod = _mm512_set1_epi32(PRIME_MODULUS);
+    const __m512i v_scale = _mm512_set1_epi32(scale);
+    const __m512i v_base  = _mm512_set1_epi32(base);
+    __m512i idx, exp;
+    __mmask16 bad;
+
+    for( ; j + 16 <= count; j += 16 ) {
+        idx = _mm512_add_epi32(_mm512_set1_epi32(phase), iota);
+        idx = _mm512_mask_sub_epi32(idx, _mm512_cmpge_epi32_mask(idx, v_mod), idx, v_mod);
+        exp = _mm512_add_epi32(_mm512_mullo_epi32(idx, v_scale), v_base);
+        bad = _mm512_cmpneq_epi32_mask(_mm512_loadu_si512((const void*)(buf + j)), exp);
+        if( 0 != bad ) {
+            if( 0 == num_wrong ) {
+                *first_bad = j + __builtin_ctz(bad);
+            }
+            num_wrong += __builtin_popcount(bad);
+        }
+        phase += 16;
+        if( phase >= PRIME_MODULUS ) {
+            phase -= PRIME_MODULUS;
+        }
+    }
+#elif defined(__AVX2__)
+    const __m256i iota  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i v_mod = _mm256_set1_epi32(PRIME_MODULUS);
+    const __m256i v_max = _mm256_set1_epi32(PRIME_MODULUS - 1);
+    const __m256i v_scale = _mm256_set1_epi32(scale);
+    const __m256i v_base  = _mm256_set1_epi32(base);
+    __m256i idx, exp;
+    unsigned int bad;
+
+    for( ; j + 8 <= count; j += 8 ) {
+        idx = _mm256_add_epi32(_mm256_set1_epi32(phase), iota);
+        idx = _mm256_sub_epi32(idx, _mm256_and_si256(_mm256_cmpgt_epi32(idx, v_max), v_mod));
+        exp = _mm256_add_epi32(_mm256_mullo_epi32(idx, v_scale), v_base);
+        exp = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(buf + j)), exp);
+        bad = ~(unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(exp)) & 0xff;
+        if( 0 != bad ) {
+            if( 0 == num_wrong ) {
+                *first_bad = j + __builtin_ctz(bad);
+            }
+            num_wrong += __builtin_popcount(bad);
+        }
+        phase += 8;
+        if( phase >= PRIME_MODULUS ) {
+            phase -= PRIME_MODULUS;
+        }
+    }
+#endif
+
+    for( ; j < count; ++j ) {
+        if( buf[j] != phase * scale + base ) {
+            if( 0 == num_wrong ) {
+                *first_bad = j;
+            }
+            ++num_wrong;
+        }
+        if( ++phase == PRIME_MODULUS ) {
+            phase = 0;
+        }
+    }
+
+    return num_wrong;
+}
+
+static inline size_t check_prime_pattern_dc_chunk(const double _Complex *buf, size_t count,
+                                                  size_t start, int scale, int base,
+                                                  size_t *first_bad)
+{
+    size_t j;
+    size_t num_wrong = 0;
+    int phase = (int)(start % PRIME_MODULUS);
+    double exp;
+
+    for( j = 0; j < count; ++j ) {
+        exp = (double)(phase * scale + base);
+        if( creal(buf[j]) != exp || cimag(buf[j]) != -exp ) {
+            if( 0 == num_wrong ) {
+                *first_bad = j;
+            }
+            ++num_wrong;
+        }
+        if( ++phase == PRIME_MODULUS ) {
+            phase = 0;
+        }
+    }
+
+    return num_wrong;
+}
+
+/*
+ * Check an int buffer against the PRIME_MODULUS pattern
+ *   buf[j] == ((start + j) % PRIME_MODULUS) * scale + base
+ * Chunks are checked in parallel by the fill/verify engine.
+ *
+ * @param buf buffer to check
+ * @param count number of elements in the buffer
+ * @param start pattern index of buf[0]
+ * @param scale multiplier applied to the pattern
+ * @param base offset added to the pattern
+ * @param first_bad (IN/OUT) lowered to the index of the first mismatch (initialize
+ *                  to SIZE_MAX, which is left unchanged if there is no mismatch)
+ * @return number of mismatched elements
+ */
+static inline size_t check_prime_pattern_int(const int *buf, size_t count,
+                                             size_t start, int scale, int base,
+                                             size_t *first_bad)
+{
+    size_t num_wrong = 0;
+    size_t first = SIZE_MAX;
+    size_t c, chunk_first, chunk_wrong, len;
+    size_t num_chunks = (count + CHECK_CHUNK_SIZE - 1) / CHECK_CHUNK_SIZE;
+
+    PARALLEL_FOR(private(chunk_first, chunk_wrong, len) reduction(+:num_wrong) reduction(min:first))
+    for( c = 0; c < num_chunks; ++c ) {
+        len = (c + 1 == num_chunks) ? count - c * CHECK_CHUNK_SIZE : CHECK_CHUNK_SIZE;
+        chunk_wrong = check_prime_pattern_int_chunk(buf + c * CHECK_CHUNK_SIZE, len,
+                                                    start + c * CHECK_CHUNK_SIZE, scale, base,
+                                                    &chunk_first);
+        if( 0 != chunk_wrong ) {
+            num_wrong += chunk_wrong;
+            if( c * CHECK_CHUNK_SIZE + chunk_first < first ) {
+                first = c * CHECK_CHUNK_SIZE + chunk_first;
+            }
+        }
+    }
+
+    if( first < *first_bad ) {
+        *first_bad = first;
+    }
+    return num_wrong;
+}
+
+/*
+ * Check a double _Complex buffer against the PRIME_MODULUS pattern
+ *   buf[j] == exp - exp*I where exp = ((start + j) % PRIME_MODULUS) * scale + base
+ * Chunks are checked in parallel by the fill/verify engine.
+ *
+ * @param buf buffer to check
+ * @param count number of elements in the buffer
+ * @param start pattern index of buf[0]
+ * @param scale multiplier applied to the pattern
+ * @param base offset added to the pattern
+ * @param first_bad (IN/OUT) lowered to the index of the first mismatch (initialize
+ *                  to SIZE_MAX, which is left unchanged if there is no mismatch)
+ * @return number of mismatched elements
+ */
+static inline size_t check_prime_pattern_dc(const double _Complex *buf, size_t count,
+                                            size_t start, int scale, int base,
+                                            size_t *first_bad)
+{
+    size_t num_wrong = 0;
+    size_t first = SIZE_MAX;
+    size_t c, chunk_first, chunk_wrong, len;
+    size_t num_chunks = (count + CHECK_CHUNK_SIZE - 1) / CHECK_CHUNK_SIZE;
+
+    PARALLEL_FOR(private(chunk_first, chunk_wrong, len) reduction(+:num_wrong) reduction(min:first))
+    for( c = 0; c < num_chunks; ++c ) {
+        len = (c + 1 == num_chunks) ? count - c * CHECK_CHUNK_SIZE : CHECK_CHUNK_SIZE;
+        chunk_wrong = check_prime_pattern_dc_chunk(buf + c * CHECK_CHUNK_SIZE, len,
+                                                   start + c * CHECK_CHUNK_SIZE, scale, base,
+                                                   &chunk_first);
+        if( 0 != chunk_wrong ) {
+            num_wrong += chunk_wrong;
+            if( c * CHECK_CHUNK_SIZE + chunk_first < first ) {
+                first = c * CHECK_CHUNK_SIZE + chunk_first;
+            }
+        }
+    }
+
+    if( first < *first_bad ) {
+        *first_bad = first;
+    }
+    return num_wrong;
+}
+
+/*
+ * Datatypes under test (BIGCOUNT_DATATYPES)
+ * Every element holds an integer test value: the value itself for the real
+ * types, value - value*I for the complex types (as the PRIME_MODULUS
+ * checkers expect), {value, -value} for the derived contiguous type and
+ * {value % 2^32, value / 2^32} for the MPI_2INT (value, location) pair.
+ * Values are stored modulo the 'modulus' of the datatype so they are exact
+ * in it (e.g., 2^24 for float). unsigned char wraps modulo 256, so the
+ * reductions stay exact (modulo 256) for it as well.
+ */
+typedef struct {
+    int pair[2];
+} test_contig_t;
+
+typedef struct {
+    int value;
+    int loc;
+} test_pair_t;
+
+#define TEST_PAIR_LOC ((int64_t)1 << 32)
+
+/*
+ * Kind of datatype, selects the reduction ops that apply to it
+ */
+enum {
+      TT_KIND_INTEGER = 0x01,
+      TT_KIND_FLOAT   = 0x02,
+      TT_KIND_COMPLEX = 0x04,
+      TT_KIND_DERIVED = 0x08,
+      TT_KIND_PAIR    = 0x10
+};
+
+typedef struct {
+    const char *key;        // Name in BIGCOUNT_DATATYPES
+    const char *name;       // Name in the output
+    size_t size;            // Bytes per element
+    size_t v_size;          // Count with TEST_PAYLOAD_SIZE (or TEST_UNIFORM_COUNT)
+    void (*set)(void *buf, size_t i, int64_t value);
+    bool (*check)(const void *buf, size_t i, int64_t value);
+    void (*fill)(void *buf, size_t count, size_t start, const int64_t *values, int period);
+    size_t (*verify)(const void *buf, size_t count, size_t start, const int64_t *values,
+                     int period, size_t *first_bad);
+    void (*fill_linear)(void *buf, size_t count, int64_t first);
+    size_t (*verify_linear)(const void *buf, size_t count, int64_t first, size_t *first_bad);
+    int kind;               // TT_KIND_*
+    bool enabled;
+#ifdef MPI_VERSION
+    MPI_Datatype dtype;     // Set by init_test_types
+    MPI_Op sum_op;          // MPI_SUM, or a user defined op for the derived type
+#endif
+} test_type_t;
+
+/*
+ * Whole buffer kernels of a datatype, called once per buffer
+ *  - test_fill_<type>   : buf[j] = values[(start + j) % period]
+ *  - test_verify_<type> : number of j with buf[j] != values[(start + j) % period],
+ *                         first_bad (IN/OUT) lowered to the first of them
+ * for j in [0, count), with period <= PRIME_MODULUS. The values are converted
+ * to the datatype once, then the typed loops walk them with a phase counter
+ * (no division and no indirect call per element). Chunks of CHECK_CHUNK_SIZE
+ * elements run in parallel with BIGCOUNT_THREADS.
+ */
+#define TEST_EQUAL(a, b)        ((a) == (b))
+#define TEST_EQUAL_CONTIG(a, b) ((a).pair[0] == (b).pair[0] && (a).pair[1] == (b).pair[1])
+#define TEST_EQUAL_PAIR(a, b)   ((a).value == (b).value && (a).loc == (b).loc)
+
+#define DEFINE_TEST_TYPE_KERNELS(suffix, ctype, equal)                         \
+static void test_fill_ ## suffix(void *buf, size_t count, size_t start,        \
+                                 const int64_t *values, int period)            \
+{                                                                              \
+    ctype table[PRIME_MODULUS], *out = (ctype*)buf;                            \
+    size_t num_chunks = (count + CHECK_CHUNK_SIZE - 1) / CHECK_CHUNK_SIZE;     \
+    size_t c, j, end;                                                          \
+    int phase;                                                                 \
+                                                                               \
+    for(phase = 0; phase < period; ++phase) {                                  \
+        test_set_ ## suffix(table, phase, values[phase]);                      \
+    }                                                                          \
+    PARALLEL_FOR(private(j, end, phase))                                       \
+    for(c = 0; c < num_chunks; ++c) {                                          \
+        end = (c + 1 == num_chunks) ? count : (c + 1) * CHECK_CHUNK_SIZE;      \
+        phase = (int)((start + c * CHECK_CHUNK_SIZE) % period);                \
+        for(j = c * CHECK_CHUNK_SIZE; j < end; ++j) {                          \
+            out[j] = table[phase];                                             \
+            if( ++phase == period ) {                                          \
+                phase = 0;                                                     \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+}                                                                              \
+static size_t test_verify_ ## suffix(const void *buf, size_t count,            \
+                                     size_t start, const int64_t *values,      \
+                                     int period, size_t *first_bad)            \
+{                                                                              \
+    ctype table[PRIME_MODULUS];                                                \
+    const ctype *in = (const ctype*)buf;                                       \
+    size_t num_chunks = (count + CHECK_CHUNK_SIZE - 1) / CHECK_CHUNK_SIZE;     \
+    size_t num_wrong = 0, first = SIZE_MAX, c, j, end;                         \
+    int phase;                                                                 \
+                                                                               \
+    for(phase = 0; phase < period; ++phase) {                                  \
+        test_set_ ## suffix(table, phase, values[phase]);                      \
+    }                                                                          \
+    PARALLEL_FOR(private(j, end, phase)                                        \
+                 reduction(+:num_wrong) reduction(min:first))                  \
+    for(c = 0; c < num_chunks; ++c) {                                          \
+        end = (c + 1 == num_chunks) ? count : (c + 1) * CHECK_CHUNK_SIZE;      \
+        phase = (int)((start + c * CHECK_CHUNK_SIZE) % period);                \
+        for(j = c * CHECK_CHUNK_SIZE; j < end; ++j) {                          \
+            if( !equal(in[j], table[phase]) ) {                                \
+                ++num_wrong;                                                   \
+                if( j < first ) {                                              \
+                    first = j;                                                 \
+                }                                                              \
+            }                                                                  \
+            if( ++phase == period ) {                                          \
+                phase = 0;                                                     \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+    if( first < *first_bad ) {                                                 \
+        *first_bad = first;                                                    \
+    }                                                                          \
+    return num_wrong;                                                          \
+}
+
+/*
+ * Whole buffer kernels of the linear pattern of a datatype (bcast, scatter,
+ * alltoall), called once per buffer or block
+ *  - test_fill_linear_<type>   : buf[j] = first + j
+ *  - test_verify_linear_<type> : number of j with buf[j] != first + j,
+ *                                first_bad (IN/OUT) lowered to the first of them
+ * for j in [0, count), converted as by test_set_<type>. The value is converted
+ * once per chunk, then stepped by one per element (step), and wraps to 0 at
+ * the modulus of the datatype (no division and no indirect call per element).
+ */
+#define TEST_STEP_REAL(x, v)    ((x) += 1)
+#define TEST_STEP_COMPLEX(x, v) ((x) += 1 - I)
+#define TEST_STEP_CONTIG(x, v)  (++(x).pair[0], --(x).pair[1])
+// The value of the pair wraps to INT_MIN, and the location changes after -1
+#define TEST_STEP_PAIR(x, v)    ((INT_MAX == (x).value || -1 == (x).value) ? \
+                                 test_set_pair(&(x), 0, (v)) : (void)++(x).value)
+
+#define DEFINE_TEST_TYPE_LINEAR(suffix, ctype, equal, step, modulus)           \
+static void test_fill_linear_ ## suffix(void *buf, size_t count, int64_t first)\
+{                                                                              \
+    ctype *out = (ctype*)buf, x;                                               \
+    size_t num_chunks = (count + CHECK_CHUNK_SIZE - 1) / CHECK_CHUNK_SIZE;     \
+    size_t c, j, end;                                                          \
+    int64_t v;                                                                 \
+                                                                               \
+    PARALLEL_FOR(private(j, end, v, x))                                        \
+    for(c = 0; c < num_chunks; ++c) {                                          \
+        end = (c + 1 == num_chunks) ? count : (c + 1) * CHECK_CHUNK_SIZE;      \
+        v = (first + (int64_t)(c * CHECK_CHUNK_SIZE)) % (modulus);             \
+        test_set_ ## suffix(&x, 0, v);                                         \
+        for(j = c * CHECK_CHUNK_SIZE; j < end; ++j) {                          \
+            out[j] = x;                                                        \
+            if( ++v == (modulus) ) {                                           \
+                v = 0;                                                         \
+                test_set_ ## suffix(&x, 0, 0);                                 \
+            } else {                                                           \
+                step(x, v);                                                    \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+}                                                                              \
+static size_t test_verify_linear_ ## suffix(const void *buf, size_t count,     \
+                                            int64_t first, size_t *first_bad)  \
+{                                                                              \
+    const ctype *in = (const ctype*)buf;                                       \
+    ctype x;                                                                   \
+    size_t num_chunks = (count + CHECK_CHUNK_SIZE - 1) / CHECK_CHUNK_SIZE;     \
+    size_t num_wrong = 0, first_j = SIZE_MAX, c, j, end;                       \
+    int64_t v;                                                                 \
+                                                                               \
+    PARALLEL_FOR(private(j, end, v, x)                                         \
+                 reduction(+:num_wrong) reduction(min:first_j))                \
+    for(c = 0; c < num_chunks; ++c) {                                          \
+        end = (c + 1 == num_chunks) ? count : (c + 1) * CHECK_CHUNK_SIZE;      \
+        v = (first + (int64_t)(c * CHECK_CHUNK_SIZE)) % (modulus);             \
+        test_set_ ## suffix(&x, 0, v);                                         \
+        for(j = c * CHECK_CHUNK_SIZE; j < end; ++j) {                          \
+            if( !equal(in[j], x) ) {                                           \
+                ++num_wrong;                                                   \
+                if( j < first_j ) {                                            \
+                    first_j = j;                                               \
+                }                                                              \
+            }                                                                  \
+            if( ++v == (modulus) ) {                                           \
+                v = 0;                                                         \
+                test_set_ ## suffix(&x, 0, 0);                                 \
+            } else {                                                           \
+                step(x, v);                                                    \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+    if( first_j < *first_bad ) {                                               \
+        *first_bad = first_j;                                                  \
+    }                                                                          \
+    return num_wrong;                                                          \
+}
+
+#define DEFINE_TEST_TYPE_REAL(suffix, ctype, modulus)                          \
+static void test_set_ ## suffix(void *buf, size_t i, int64_t value)            \
+{                                                                              \
+    ((ctype*)buf)[i] = (ctype)(value % (modulus));                             \
+}                                                                              \
+static bool test_check_ ## suffix(const void *buf, size_t i, int64_t value)    \
+{                                                                              \
+    return ((const ctype*)buf)[i] == (ctype)(value % (modulus));               \
+}                                                                              \
+DEFINE_TEST_TYPE_KERNELS(suffix, ctype, TEST_EQUAL)                            \
+DEFINE_TEST_TYPE_LINEAR(suffix, ctype, TEST_EQUAL, TEST_STEP_REAL, modulus)
+
+#define DEFINE_TEST_TYPE_COMPLEX(suffix, ctype, rtype, modulus)                \
+static void test_set_ ## suffix(void *buf, size_t i, int64_t value)            \
+{                                                                              \
+    rtype x = (rtype)(value % (modulus));                                      \
+    ((ctype*)buf)[i] = x - x*I;                                                \
+}                                                                              \
+static bool test_check_ ## suffix(const void *buf, size_t i, int64_t value)    \
+{                                                                              \
+    rtype x = (rtype)(value % (modulus));                                      \
+    return ((const ctype*)buf)[i] == x - x*I;                                  \
+}                                                                              \
+DEFINE_TEST_TYPE_KERNELS(suffix, ctype, TEST_EQUAL)                            \
+DEFINE_TEST_TYPE_LINEAR(suffix, ctype, TEST_EQUAL, TEST_STEP_COMPLEX, modulus)
+
+DEFINE_TEST_TYPE_REAL(int, int, (int64_t)INT_MAX + 1)
+DEFINE_TEST_TYPE_COMPLEX(dc, double _Complex, double, (int64_t)1 << 53)
+DEFINE_TEST_TYPE_REAL(char, unsigned char, 256)
+DEFINE_TEST_TYPE_REAL(int64, int64_t, INT64_MAX)
+DEFINE_TEST_TYPE_REAL(float, float, (int64_t)1 << 24)
+DEFINE_TEST_TYPE_REAL(double, double, (int64_t)1 << 53)
+DEFINE_TEST_TYPE_COMPLEX(fc, float _Complex, float, (int64_t)1 << 24)
+
+static void test_set_contig(void *buf, size_t i, int64_t value)
+{
+    ((test_contig_t*)buf)[i].pair[0] = (int)(value % ((int64_t)INT_MAX + 1));
+    ((test_contig_t*)buf)[i].pair[1] = -(int)(value % ((int64_t)INT_MAX + 1));
+}
+
+static bool test_check_contig(const void *buf, size_t i, int64_t value)
+{
+    int x = (int)(value % ((int64_t)INT_MAX + 1));
+    return ((const test_contig_t*)buf)[i].pair[0] == x && ((const test_contig_t*)buf)[i].pair[1] == -x;
+}
+
+static void test_set_pair(void *buf, size_t i, int64_t value)
+{
+    ((test_pair_t*)buf)[i].value = (int)(value % TEST_PAIR_LOC);
+    ((test_pair_t*)buf)[i].loc = (int)(value / TEST_PAIR_LOC);
+}
+
+static bool test_check_pair(const void *buf, size_t i, int64_t value)
+{
+    return ((const test_pair_t*)buf)[i].value == (int)(value % TEST_PAIR_LOC) &&
+           ((const test_pair_t*)buf)[i].loc == (int)(value / TEST_PAIR_LOC);
+}
+
+DEFINE_TEST_TYPE_KERNELS(contig, test_contig_t, TEST_EQUAL_CONTIG)
+DEFINE_TEST_TYPE_KERNELS(pair, test_pair_t, TEST_EQUAL_PAIR)
+DEFINE_TEST_TYPE_LINEAR(contig, test_contig_t, TEST_EQUAL_CONTIG, TEST_STEP_CONTIG,
+                        (int64_t)INT_MAX + 1)
+DEFINE_TEST_TYPE_LINEAR(pair, test_pair_t, TEST_EQUAL_PAIR, TEST_STEP_PAIR, INT64_MAX)
+
+/*
+ * Table of the datatypes, in the order in which the tests run them.
+ * int and double _Complex are enabled by default.
+ */
+enum {
+      TT_INT            = 0,
+      TT_DOUBLE_COMPLEX = 1,
+      TT_CHAR           = 2,
+      TT_INT64          = 3,
+      TT_FLOAT          = 4,
+      TT_DOUBLE         = 5,
+      TT_FLOAT_COMPLEX  = 6,
+      TT_CONTIG         = 7,
+      TT_PAIR           = 8,
+      NUM_TEST_TYPES
+};
+
+test_type_t test_types[NUM_TEST_TYPES] = {
+    {"int",            "int",             sizeof(int),             V_SIZE_INT,
+     test_set_int, test_check_int, test_fill_int, test_verify_int,
+     test_fill_linear_int, test_verify_linear_int,
+     TT_KIND_INTEGER, true},
+    {"double_complex", "double _Complex", sizeof(double _Complex), V_SIZE_DOUBLE_COMPLEX,
+     test_set_dc, test_check_dc, test_fill_dc, test_verify_dc,
+     test_fill_linear_dc, test_verify_linear_dc,
+     TT_KIND_COMPLEX, true},
+    {"char",           "unsigned char",   sizeof(unsigned char),   V_SIZE_CHAR,
+     test_set_char, test_check_char, test_fill_char, test_verify_char,
+     test_fill_linear_char, test_verify_linear_char,
+     TT_KIND_INTEGER, false},
+    {"int64",          "int64_t",         sizeof(int64_t),         V_SIZE_INT64,
+     test_set_int64, test_check_int64, test_fill_int64, test_verify_int64,
+     test_fill_linear_int64, test_verify_linear_int64,
+     TT_KIND_INTEGER, false},
+    {"float",          "float",           sizeof(float),           V_SIZE_FLOAT,
+     test_set_float, test_check_float, test_fill_float, test_verify_float,
+     test_fill_linear_float, test_verify_linear_float,
+     TT_KIND_FLOAT,   false},
+    {"double",         "double",          sizeof(double),          V_SIZE_DOUBLE,
+     test_set_double, test_check_double, test_fill_double, test_verify_double,
+     test_fill_linear_double, test_verify_linear_double,
+     TT_KIND_FLOAT,   false},
+    {"float_complex",  "float _Complex",  sizeof(float _Complex),  V_SIZE_FLOAT_COMPLEX,
+     test_set_fc, test_check_fc, test_fill_fc, test_verify_fc,
+     test_fill_linear_fc, test_verify_linear_fc,
+     TT_KIND_COMPLEX, false},
+    {"contig",         "contig(2 x int)", sizeof(test_contig_t),   V_SIZE_CONTIG,
+     test_set_contig, test_check_contig, test_fill_contig, test_verify_contig,
+     test_fill_linear_contig, test_verify_linear_contig,
+     TT_KIND_DERIVED, false},
+    {"2int",           "2int(value, loc)", sizeof(test_pair_t),    V_SIZE_CONTIG,
+     test_set_pair, test_check_pair, test_fill_pair, test_verify_pair,
+     test_fill_linear_pair, test_verify_linear_pair,
+     TT_KIND_PAIR,    false}
+};
+
+#ifdef MPI_VERSION
+/*
+ * Find the test_types entry of a datatype
+ *
+ * @param dtype datatype
+ * @return entry of the table (aborts if the datatype is not in the table)
+ */
+static inline const test_type_t * find_test_type(MPI_Datatype dtype)
+{
+    int i;
+
+    for(i = 0; i < NUM_TEST_TYPES; ++i) {
+        if( test_types[i].dtype == dtype ) {
+            return &test_types[i];
+        }
+    }
+    fprintf(stderr, "Rank %d on %s) Error: Datatype not in the test_types table\n", world_rank, my_hostname);
+    MPI_Abort(MPI_COMM_WORLD, 3);
+    return NULL;
+}
+
+/*
+ * User defined sum of the test_types datatypes: the 'user' op of the
+ * reductions, and the sum of the derived contiguous type (predefined ops
+ * only apply to predefined datatypes)
+ */
+#define TEST_USER_SUM(ctype)                                                   \
+    for(i = 0; i < n; ++i) {                                                   \
+        ((ctype*)inout)[i] += ((const ctype*)in)[i];                           \
+    }
+
+#ifdef TEST_BIGCOUNT_API
+static void test_user_sum(void *in, void *inout, MPI_Count *len, MPI_Datatype *dtype)
+#else
+static void test_user_sum(void *in, void *inout, int *len, MPI_Datatype *dtype)
+#endif
+{
+    size_t i, n = (size_t)*len;
+
+    switch( find_test_type(*dtype) - test_types ) {
+    case TT_INT:            TEST_USER_SUM(int); break;
+    case TT_DOUBLE_COMPLEX: TEST_USER_SUM(double _Complex); break;
+    case TT_CHAR:           TEST_USER_SUM(unsigned char); break;
+    case TT_INT64:          TEST_USER_SUM(int64_t); break;
+    case TT_FLOAT:          TEST_USER_SUM(float); break;
+    case TT_DOUBLE:         TEST_USER_SUM(double); break;
+    case TT_FLOAT_COMPLEX:  TEST_USER_SUM(float _Complex); break;
+    case TT_CONTIG:
+        for(i = 0; i < n; ++i) {
+            ((test_contig_t*)inout)[i].pair[0] += ((const test_contig_t*)in)[i].pair[0];
+            ((test_contig_t*)inout)[i].pair[1] += ((const test_contig_t*)in)[i].pair[1];
+        }
+        break;
+    }
+}
+#endif
+
+/*
+ * Reduction ops under test (BIGCOUNT_OPS)
+ * Rank r contributes value(i, r) at index i, and the reduction of the
+ * contributions of ranks [0, nranks) at index i is expect(i, nranks), in
+ * closed form. Both only depend on i % period, so fill_op_input and
+ * check_op_result evaluate them once per phase, not once per element. The
+ * values are small non-negative integers, so they are exact in every
+ * datatype the op applies to (e.g., MPI_PROD multiplies by 1 or 2 at most
+ * 3 times). With x = i % 64 and m = min(nranks - 1, 127):
+ *  - sum, user : (i + r) % PRIME_MODULUS        -> sum of it over r, see test_expect_sum
+ *  - max       : x + r % 128                    -> x + m
+ *  - min       : x + 128 - r % 128              -> x + 128 - m
+ *  - prod      : 2 if r < i % 4, 1 otherwise    -> 2^min(nranks, i % 4)
+ *  - band      : x << 8 | all bits but r % 8    -> x << 8 | bits min(nranks, 8) and up
+ *  - bxor      : x << 8 | r % 256               -> parity of nranks, 0 ^ 1 ^ ... ^ (nranks - 1)
+ *  - maxloc    : (x + r % 128, r)               -> (x + m, m) (ties go to the lowest rank)
+ */
+static int64_t test_value_sum(size_t i, int rank)
+{
+    return (int64_t)((i + (size_t)rank) % PRIME_MODULUS);
+}
+
+static int64_t test_expect_sum(size_t i, int nranks)
+{
+    // Each full cycle of PRIME_MODULUS ranks adds 0 + 1 + ... + (PRIME_MODULUS - 1),
+    // the m other ranks add p, p + 1, ..., p + m - 1, less PRIME_MODULUS for
+    // each of them that wraps (those at or above PRIME_MODULUS)
+    int64_t p = (int64_t)(i % PRIME_MODULUS);
+    int64_t cycles = nranks / PRIME_MODULUS, m = nranks % PRIME_MODULUS;
+    int64_t wraps = (p + m > PRIME_MODULUS) ? p + m - PRIME_MODULUS : 0;
+
+    return cycles * PRIME_MODULUS * (PRIME_MODULUS - 1) / 2 + m * p + m * (m - 1) / 2
+           - wraps * PRIME_MODULUS;
+}
+
+static int64_t test_value_max(size_t i, int rank)
+{
+    return (int64_t)(i % 64) + rank % 128;
+}
+
+static int64_t test_expect_max(size_t i, int nranks)
+{
+    return (int64_t)(i % 64) + ((nranks - 1 < 127) ? nranks - 1 : 127);
+}
+
+static int64_t test_value_min(size_t i, int rank)
+{
+    return (int64_t)(i % 64) + 128 - rank % 128;
+}
+
+static int64_t test_expect_min(size_t i, int nranks)
+{
+    return (int64_t)(i % 64) + 128 - ((nranks - 1 < 127) ? nranks - 1 : 127);
+}
+
+static int64_t test_value_prod(size_t i, int rank)
+{
+    return ((size_t)rank < i % 4) ? 2 : 1;
+}
+
+static int64_t test_expect_prod(size_t i, int nranks)
+{
+    return (int64_t)1 << (((size_t)nranks < i % 4) ? (size_t)nranks : i % 4);
+}
+
+static int64_t test_value_band(size_t i, int rank)
+{
+    return (int64_t)(i % 64) << 8 | (0xff & ~(1 << (rank % 8)));
+}
+
+static int64_t test_expect_band(size_t i, int nranks)
+{
+    return (int64_t)(i % 64) << 8 | (0xff & ~((1 << ((nranks < 8) ? nranks : 8)) - 1));
+}
+
+static int64_t test_value_bxor(size_t i, int rank)
+{
+    return (int64_t)(i % 64) << 8 | (rank & 0xff);
+}
+
+static int64_t test_expect_bxor(size_t i, int nranks)
+{
+    // 0 ^ 1 ^ ... ^ m is m, 1, m + 1 or 0 depending on m % 4
+    int m = nranks - 1;
+    int xor_ranks = (0 == m % 4) ? m : (1 == m % 4) ? 1 : (2 == m % 4) ? m + 1 : 0;
+
+    if( 0 == nranks ) {
+        return 0;
+    }
+    return ((nranks & 1) ? (int64_t)(i % 64) << 8 : 0) | (xor_ranks & 0xff);
+}
+
+static int64_t test_value_maxloc(size_t i, int rank)
+{
+    return test_value_max(i, rank) + TEST_PAIR_LOC * rank;
+}
+
+static int64_t test_expect_maxloc(size_t i, int nranks)
+{
+    return test_expect_max(i, nranks) + TEST_PAIR_LOC * ((nranks - 1 < 127) ? nranks - 1 : 127);
+}
+
+typedef struct {
+    const char *key;        // Name in BIGCOUNT_OPS
+    const char *name;       // Name in the output
+    int kinds;              // TT_KIND_* of the datatypes the op applies to
+    int64_t (*value)(size_t i, int rank);
+    int64_t (*expect)(size_t i, int nranks);
+    int period;             // value and expect only depend on i % period
+    bool enabled;
+#ifdef MPI_VERSION
+    MPI_Op op;              // Set by init_test_types
+#endif
+} test_op_t;
+
+/*
+ * Table of the reduction ops, in the order in which the tests run them.
+ * Only sum is enabled by default.
+ */
+enum {
+      TO_SUM    = 0,
+      TO_MAX    = 1,
+      TO_MIN    = 2,
+      TO_PROD   = 3,
+      TO_BAND   = 4,
+      TO_BXOR   = 5,
+      TO_MAXLOC = 6,
+      TO_USER   = 7,
+      NUM_TEST_OPS
+};
+
+#define TT_KIND_REAL (TT_KIND_INTEGER | TT_KIND_FLOAT)
+#define TT_KIND_SUM  (TT_KIND_REAL | TT_KIND_COMPLEX | TT_KIND_DERIVED)
+
+test_op_t test_ops[NUM_TEST_OPS] = {
+    {"sum",    "MPI_SUM",    TT_KIND_SUM,     test_value_sum,    test_expect_sum,    PRIME_MODULUS, true},
+    {"max",    "MPI_MAX",    TT_KIND_REAL,    test_value_max,    test_expect_max,    64,            false},
+    {"min",    "MPI_MIN",    TT_KIND_REAL,    test_value_min,    test_expect_min,    64,            false},
+    {"prod",   "MPI_PROD",   TT_KIND_REAL,    test_value_prod,   test_expect_prod,   4,             false},
+    {"band",   "MPI_BAND",   TT_KIND_INTEGER, test_value_band,   test_expect_band,   64,            false},
+    {"bxor",   "MPI_BXOR",   TT_KIND_INTEGER, test_value_bxor,   test_expect_bxor,   64,            false},
+    {"maxloc", "MPI_MAXLOC", TT_KIND_PAIR,    test_value_maxloc, test_expect_maxloc, 64,            false},
+    {"user",   "user(sum)",  TT_KIND_SUM,     test_value_sum,    test_expect_sum,    PRIME_MODULUS, false}
+};
+
+/*
+ * Reduction op of the test case (set by the reduction tests, NULL otherwise)
+ */
+const test_op_t *test_op = NULL;
+
+#ifdef MPI_VERSION
+/*
+ * Create the MPI datatypes and ops of the test_types and test_ops tables
+ * Note: Called by init_environment
+ */
+static void init_test_types(void)
+{
+    int i;
+
+    test_types[TT_INT].dtype            = MPI_INT;
+    test_types[TT_DOUBLE_COMPLEX].dtype = MPI_C_DOUBLE_COMPLEX;
+    test_types[TT_CHAR].dtype           = MPI_UNSIGNED_CHAR;
+    test_types[TT_INT64].dtype          = MPI_INT64_T;
+    test_types[TT_FLOAT].dtype          = MPI_FLOAT;
+    test_types[TT_DOUBLE].dtype         = MPI_DOUBLE;
+    test_types[TT_FLOAT_COMPLEX].dtype  = MPI_C_FLOAT_COMPLEX;
+    test_types[TT_PAIR].dtype           = MPI_2INT;
+
+    test_ops[TO_SUM].op    = MPI_SUM;
+    test_ops[TO_MAX].op    = MPI_MAX;
+    test_ops[TO_MIN].op    = MPI_MIN;
+    test_ops[TO_PROD].op   = MPI_PROD;
+    test_ops[TO_BAND].op   = MPI_BAND;
+    test_ops[TO_BXOR].op   = MPI_BXOR;
+    test_ops[TO_MAXLOC].op = MPI_MAXLOC;
+#ifdef TEST_BIGCOUNT_API
+    MPI_Op_create_c(test_user_sum, 1, &test_ops[TO_USER].op);
+#else
+    MPI_Op_create(test_user_sum, 1, &test_ops[TO_USER].op);
+#endif
+
+    for(i = 0; i < NUM_TEST_TYPES; ++i) {
+        test_types[i].sum_op = MPI_SUM;
+    }
+
+    MPI_Type_contiguous(2, MPI_INT, &test_types[TT_CONTIG].dtype);
+    MPI_Type_set_name(test_types[TT_CONTIG].dtype, "MPI_CONTIG_2INT");
+    MPI_Type_commit(&test_types[TT_CONTIG].dtype);
+    test_types[TT_CONTIG].sum_op = test_ops[TO_USER].op;
+}
+#endif
+
+/*
+ * Values of the blocks that the tests send and check. The sender fills a
+ * block from its send_base and the receiver checks it from its recv_base
+ * (see coll_comm_t). selftest uses the same values.
+ */
+/*
+ * Constant value of the block of a process in the gathers and the v-collectives
+ *
+ * @param rank rank of the process that sends the block
+ * @param base send_base of the sender (0 in the v-collectives)
+ * @return value of all the elements of the block
+ */
+static inline int64_t gather_value(int rank, int base)
+{
+    return 1 + rank + base;
+}
+
+/*
+ * First value of the linear block that the root of scatter sends to a peer
+ *
+ * @param peer rank of the receiver
+ * @param base send_base of the root
+ * @return value of the first element of the block
+ */
+static inline int64_t scatter_first(int peer, int base)
+{
+    return peer + base;
+}
+
+/*
+ * First value of the linear block that a process sends to a peer in alltoall
+ *
+ * @param src rank of the sender
+ * @param dst rank of the receiver
+ * @param base send_base of the sender
+ * @return value of the first element of the block
+ */
+static inline int64_t alltoall_first(int src, int dst, int base)
+{
+    return dst + (src + 1) * 2 + base;
+}
+
+/*
+ * Base of the PRIME_MODULUS pattern that a process sends in alltoallv and
+ * alltoallw (see fill_prime_pattern)
+ *
+ * @param src rank of the sender
+ * @return base of the pattern
+ */
+static inline int alltoallv_base(int src)
+{
+    return PRIME_MODULUS * src;
+}
+
+/*
+ * Set buf[i] = value for i in [0, count) (in parallel with BIGCOUNT_THREADS)
+ *
+ * @param tt datatype of the buffer
+ * @param buf buffer
+ * @param count number of elements
+ * @param value test value
+ */
+static inline void fill_value(const test_type_t *tt, void *buf, size_t count, int64_t value)
+{
+    tt->fill(buf, count, 0, &value, 1);
+}
+
+/*
+ * Set buf[j] = first + j for j in [0, count), the linear pattern of bcast,
+ * scatter and alltoall (in parallel with BIGCOUNT_THREADS)
+ *
+ * @param tt datatype of the buffer
+ * @param buf buffer
+ * @param count number of elements
+ * @param first test value of buf[0]
+ */
+static inline void fill_linear(const test_type_t *tt, void *buf, size_t count, int64_t first)
+{
+    tt->fill_linear(buf, count, first);
+}
+
+/*
+ * Check that buf[i] == value for i in [offset, offset + count), e.g., the
+ * block of one peer or the gap before it (in parallel with BIGCOUNT_THREADS)
+ *
+ * @param tt datatype of the buffer
+ * @param buf buffer to check
+ * @param offset index of the first element to check
+ * @param count number of elements to check
+ * @param value test value
+ * @param first_bad (IN/OUT) lowered to the index (in buf) of the first mismatch
+ * @return number of mismatched elements
+ */
+static inline size_t check_value(const test_type_t *tt, const void *buf, size_t offset,
+                                 size_t count, int64_t value, size_t *first_bad)
+{
+    size_t first = SIZE_MAX;
+    size_t num_wrong = tt->verify((const char*)buf + offset * tt->size, count, 0, &value, 1, &first);
+
+    if( SIZE_MAX != first && offset + first < *first_bad ) {
+        *first_bad = offset + first;
+    }
+    return num_wrong;
+}
+
+/*
+ * Check that buf[offset + j] == first + j for j in [0, count), the linear
+ * pattern of fill_linear (in parallel with BIGCOUNT_THREADS)
+ *
+ * @param tt datatype of the buffer
+ * @param buf buffer to check
+ * @param offset index of the first element to check
+ * @param count number of elements to check
+ * @param first test value of buf[offset]
+ * @param first_bad (IN/OUT) lowered to the index (in buf) of the first mismatch
+ * @return number of mismatched elements
+ */
+static inline size_t check_linear(const test_type_t *tt, const void *buf, size_t offset,
+                                  size_t count, int64_t first, size_t *first_bad)
+{
+    size_t first_j = SIZE_MAX;
+    size_t num_wrong = tt->verify_linear((const char*)buf + offset * tt->size, count, first, &first_j);
+
+    if( SIZE_MAX != first_j && offset + first_j < *first_bad ) {
+        *first_bad = offset + first_j;
+    }
+    return num_wrong;
+}
+
+/*
+ * Fill a buffer with the PRIME_MODULUS pattern checked by check_prime_pattern:
+ * buf[j] = ((start + j) % PRIME_MODULUS) * scale + base
+ *
+ * @param tt datatype of the buffer
+ * @param buf buffer
+ * @param count number of elements in the buffer
+ * @param start pattern index of buf[0]
+ * @param scale multiplier applied to the pattern
+ * @param base offset added to the pattern
+ */
+static inline void fill_prime_pattern(const test_type_t *tt, void *buf, size_t count,
+                                      size_t start, int scale, int base)
+{
+    int64_t values[PRIME_MODULUS];
+    int phase;
+
+    for(phase = 0; phase < PRIME_MODULUS; ++phase) {
+        values[phase] = (int64_t)phase * scale + base;
+    }
+    tt->fill(buf, count, start, values, PRIME_MODULUS);
+}
+
+/*
+ * Check a buffer against the PRIME_MODULUS pattern (see check_prime_pattern_int)
+ * Uses the vectorized checkers for int and double _Complex.
+ *
+ * @param tt datatype of the buffer
+ * @param buf buffer to check
+ * @param count number of elements in the buffer
+ * @param start pattern index of buf[0]
+ * @param scale multiplier applied to the pattern
+ * @param base offset added to the pattern
+ * @param first_bad (IN/OUT) lowered to the index of the first mismatch
+ * @return number of mismatched elements
+ */
+static inline size_t check_prime_pattern(const test_type_t *tt, const void *buf, size_t count,
+                                         size_t start, int scale, int base, size_t *first_bad)
+{
+    int64_t values[PRIME_MODULUS];
+    int phase;
+
+    if( &test_types[TT_INT] == tt ) {
+        return check_prime_pattern_int((const int*)buf, count, start, scale, base, first_bad);
+    } else if( &test_types[TT_DOUBLE_COMPLEX] == tt ) {
+        return check_prime_pattern_dc((const double _Complex*)buf, count, start, scale, base, first_bad);
+    }
+
+    for(phase = 0; phase < PRIME_MODULUS; ++phase) {
+        values[phase] = (int64_t)phase * scale + base;
+    }
+    return tt->verify(buf, count, start, values, PRIME_MODULUS, first_bad);
+}
+
+#ifdef MPI_VERSION
+/*
+ * Fill the block that a process sends to a neighbor (see neighbor_value)
+ *
+ * @param tt datatype of the buffer
+ * @param buf first element of the block
+ * @param count number of elements in the block
+ * @param src rank of the sender in test_topo->comm
+ * @param dst rank of the receiver (0 for the allgathers)
+ */
+static inline void fill_neighbor_block(const test_type_t *tt, void *buf, size_t count,
+                                       int src, int dst)
+{
+    fill_prime_pattern(tt, buf, count, 0, 1, (int)neighbor_value(src, dst, 0));
+}
+
+/*
+ * Check the block received from a source in a neighborhood collective. The
+ * block of an MPI_PROC_NULL source must not be modified (-1).
+ *
+ * @param tt datatype of the buffer
+ * @param buf receive buffer
+ * @param offset index of the first element of the block in buf
+ * @param count number of elements in the block
+ * @param src rank of the sender in test_topo->comm, or MPI_PROC_NULL
+ * @param dst rank of the receiver (0 for the allgathers)
+ * @param first_bad lowered to the index in buf of the first wrong element
+ * @return number of wrong elements in the block
+ */
+static inline size_t check_neighbor_block(const test_type_t *tt, const void *buf, size_t offset,
+                                          size_t count, int src, int dst, size_t *first_bad)
+{
+    size_t first = SIZE_MAX;
+    size_t num_wrong;
+
+    if( MPI_PROC_NULL == src ) {
+        return check_value(tt, buf, offset, count, -1, first_bad);
+    }
+    num_wrong = check_prime_pattern(tt, (const char*)buf + offset * tt->size, count, 0, 1,
+                                    (int)neighbor_value(src, dst, 0), &first);
+    if( SIZE_MAX != first && offset + first < *first_bad ) {
+        *first_bad = offset + first;
+    }
+    return num_wrong;
+}
+#endif
+
+/*
+ * Check if a reduction test case runs an op on a datatype. MPI_MAXLOC only
+ * applies to the 2int pair, so it runs on it even if the pair is not in
+ * BIGCOUNT_DATATYPES.
+ *
+ * @param op reduction op
+ * @param tt datatype
+ * @return true if the test case runs
+ */
+static inline bool op_runs_on(const test_op_t *op, const test_type_t *tt)
+{
+    if( 0 == (op->kinds & tt->kind) ) {
+        return false;
+    }
+    return tt->enabled || TT_KIND_PAIR == op->kinds;
+}
+
+#ifdef MPI_VERSION
+/*
+ * MPI_Op of a reduction op on a datatype (MPI_SUM is a user defined op on
+ * the derived type)
+ *
+ * @param op reduction op
+ * @param tt datatype
+ * @return MPI_Op to pass to the collective
+ */
+static inline MPI_Op op_handle(const test_op_t *op, const test_type_t *tt)
+{
+    return (TO_SUM == op - test_ops) ? tt->sum_op : op->op;
+}
+#endif
+
+/*
+ * Set buf[i] to the input of an op on this rank, for i in [0, count)
+ *
+ * @param tt datatype of the buffer
+ * @param op reduction op
+ * @param buf buffer
+ * @param count number of elements
+ * @param start op index of buf[0]
+ * @param rank contributing rank
+ */
+static inline void fill_op_input(const test_type_t *tt, const test_op_t *op, void *buf,
+                                 size_t count, size_t start, int rank)
+{
+    int64_t values[PRIME_MODULUS];
+    int phase;
+
+    for(phase = 0; phase < op->period; ++phase) {
+        values[phase] = op->value(phase, rank);
+    }
+    tt->fill(buf, count, start, values, op->period);
+}
+
+/*
+ * Check a buffer against the reduction of the inputs of ranks [0, nranks)
+ *
+ * @param tt datatype of the buffer
+ * @param op reduction op
+ * @param buf buffer to check
+ * @param count number of elements in the buffer
+ * @param start op index of buf[0]
+ * @param nranks number of contributing ranks
+ * @param first_bad (IN/OUT) lowered to the index of the first mismatch
+ * @return number of mismatched elements
+ */
+static inline size_t check_op_result(const test_type_t *tt, const test_op_t *op, const void *buf,
+                                     size_t count, size_t start, int nranks, size_t *first_bad)
+{
+    int64_t values[PRIME_MODULUS];
+    int phase;
+
+    for(phase = 0; phase < op->period; ++phase) {
+        values[phase] = op->expect(phase, nranks);
+    }
+    return tt->verify(buf, count, start, values, op->period, first_bad);
+}
+
+/*
+ * Convert a string to a number of bytes. Accepts an optional K, M or G suffix
+ * (powers of 1024).
+ *
+ * @param str string to convert
+ * @return number of bytes
+ */
+static inline size_t parse_bytes(const char *str)
+{
+    char *endp = NULL;
+    size_t value = (size_t)strtoull(str, &endp, 10);
+
+    switch( *endp ) {
+    case 'g': case 'G': value *= 1024; // fall through
+    case 'm': case 'M': value *= 1024; // fall through
+    case 'k': case 'K': value *= 1024;
+    }
+    return value;
+}
+
+/*
+ * Determine amount of memory to use, in GBytes as a percentage of total physical memory
+ *
+ * @return Amount of memory to use (in GB)
+ */
+static int get_max_memory(void) {
     char *mem_percent_str;
     char *endp;
     FILE *meminfo_file;
@@ -201,271 +2081,2469 @@ static int get_max_memory(void) {
     int mem_to_use;
     int rc;
 
-    mem_percent_str = getenv("BIGCOUNT_MEMORY_PERCENT");
-    if (NULL == mem_percent_str) {
-        mem_percent_str = "80";
+    mem_percent_str = getenv("BIGCOUNT_MEMORY_PERCENT");
+    if (NULL == mem_percent_str) {
+        mem_percent_str = "80";
+    }
+
+    mem_percent = strtol(mem_percent_str, &endp, 10);
+    if ('\0' != *endp) {
+        fprintf(stderr, "BIGCOUNT_MEMORY_PERCENT is not numeric\n");
+        exit(1);
+    }
+
+    meminfo_file = fopen("/proc/meminfo", "r");
+    if (NULL == meminfo_file) {
+        fprintf(stderr, "Unable to open /proc/meminfo file: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    bufsize = 0;
+    proc_data = NULL;
+    mem_to_use = 0;
+    rc = getline(&proc_data, &bufsize, meminfo_file);
+    while (rc > 0) {
+        token = strtok(proc_data, " ");
+        if (NULL != token) {
+            if (!strcmp(token, "MemTotal:")) {
+                token = strtok(NULL, " ");
+                total_sys_mem_gb = strtol(token, NULL, 10);
+                total_sys_mem_gb = (int)(total_sys_mem_gb / 1048576.0);
+                /* /proc/meminfo specifies memory in KBytes, convert to GBytes */
+                mem_to_use = (int)(total_sys_mem_gb * (mem_percent / 100.0));
+                break;
+             }
+        }
+        rc = getline(&proc_data, &bufsize, meminfo_file);
+    }
+
+    if (0 == mem_to_use) {
+        fprintf(stderr, "Unable to determine memory to use\n");
+        exit(1);
+    }
+
+    free(proc_data);
+    fclose(meminfo_file);
+    return mem_to_use;
+}
+
+/*
+ * Memory model of a collective: the buffers used per process as multiples of
+ * the count (per process) passed to calc_coll_count(), as a linear function of
+ * the communicator size (np):
+ *   root buffers : root_base + root_np x np
+ *   peer buffers : peer_base + peer_np x np
+ *   temporary    : tmp_base  + tmp_np  x np (internal to the collective, all processes)
+ * The root/peer buffers are scaled by BIGCOUNT_ALG_INFLATION.
+ * For the neighborhood collectives np is the number of neighbors (topo_blocks).
+ */
+typedef struct {
+    const char *coll;       // Collective name (e.g., "allreduce")
+    const char *component;  // coll component (e.g., "tuned") or NULL for any
+    double root_base, root_np;
+    double peer_base, peer_np;
+    double tmp_base, tmp_np;
+} mem_model_t;
+
+/*
+ * Default memory models, matching the buffers allocated by the tests plus one
+ * payload of temporary space for the reductions. Component specific entries
+ * (non-NULL component) take precedence over the generic ones, and can be
+ * added here or with BIGCOUNT_MEMORY_MODEL.
+ */
+static const mem_model_t mem_models[] = {
+    //  coll              component  root        peer        temporary
+    { "allgather",        NULL,      1.0, 1.0,   1.0, 1.0,   0.0, 0.0 },
+    { "allgatherv",       NULL,      1.0, 1.0,   1.0, 1.0,   0.0, 0.0 },
+    { "allreduce",        NULL,      2.0, 0.0,   2.0, 0.0,   1.0, 0.0 },
+    { "alltoall",         NULL,      0.0, 1.0,   0.0, 1.0,   1.0, 0.0 },
+    { "alltoallv",        NULL,      0.0, 2.0,   0.0, 2.0,   0.0, 0.0 },
+    { "alltoallw",        NULL,      0.0, 2.0,   0.0, 2.0,   0.0, 0.0 },
+    { "bcast",            NULL,      1.0, 0.0,   1.0, 0.0,   0.0, 0.0 },
+    { "exscan",           NULL,      2.0, 0.0,   2.0, 0.0,   1.0, 0.0 },
+    { "gather",           NULL,      1.0, 1.0,   1.0, 0.0,   0.0, 0.0 },
+    { "gatherv",          NULL,      1.0, 1.0,   1.0, 0.0,   0.0, 0.0 },
+    { "neighbor_allgather",  NULL,   1.0, 1.0,   1.0, 1.0,   0.0, 0.0 },
+    { "neighbor_allgatherv", NULL,   1.0, 1.0,   1.0, 1.0,   0.0, 0.0 },
+    { "neighbor_alltoall",   NULL,   0.0, 2.0,   0.0, 2.0,   0.0, 0.0 },
+    { "neighbor_alltoallv",  NULL,   0.0, 2.0,   0.0, 2.0,   0.0, 0.0 },
+    { "neighbor_alltoallw",  NULL,   0.0, 2.0,   0.0, 2.0,   0.0, 0.0 },
+    { "reduce",           NULL,      2.0, 0.0,   1.0, 0.0,   1.0, 0.0 },
+    { "reduce_scatter",   NULL,      2.0, 0.0,   2.0, 0.0,   1.0, 0.0 },
+    { "reduce_scatter_block", NULL,  1.0, 1.0,   1.0, 1.0,   0.0, 1.0 },
+    { "scan",             NULL,      2.0, 0.0,   2.0, 0.0,   1.0, 0.0 },
+    { "scatter",          NULL,      1.0, 1.0,   1.0, 0.0,   0.0, 0.0 },
+    { "scatterv",         NULL,      1.0, 1.0,   1.0, 0.0,   0.0, 0.0 },
+};
+#define NUM_MEM_MODELS (sizeof(mem_models) / sizeof(mem_model_t))
+
+/*
+ * Memory model overrides from BIGCOUNT_MEMORY_MODEL
+ */
+mem_model_t *mem_model_overrides = NULL;
+int num_mem_model_overrides = 0;
+
+/*
+ * coll component whose memory models are used (BIGCOUNT_COLL_COMPONENT)
+ */
+char *coll_component = NULL;
+
+/*
+ * Parse the memory model overrides. Format (';' separated list):
+ *   coll[/component]=root_base:root_np,peer_base:peer_np[,tmp_base:tmp_np]
+ *
+ * @param str value of BIGCOUNT_MEMORY_MODEL
+ */
+static void parse_mem_model_overrides(const char *str)
+{
+    char *cpy_str = strdup(str);
+    char *entry, *saveptr = NULL;
+    char coll[64], component[64];
+    mem_model_t model;
+    int rc;
+
+    for( entry = strtok_r(cpy_str, ";", &saveptr); NULL != entry;
+         entry = strtok_r(NULL, ";", &saveptr) ) {
+        memset(&model, 0, sizeof(mem_model_t));
+        component[0] = '\0';
+        rc = sscanf(entry, " %63[^/=]/%63[^=]=%lf:%lf,%lf:%lf,%lf:%lf", coll, component,
+                    &model.root_base, &model.root_np, &model.peer_base, &model.peer_np,
+                    &model.tmp_base, &model.tmp_np);
+        if( rc < 6 ) {
+            component[0] = '\0';
+            rc = sscanf(entry, " %63[^/=]=%lf:%lf,%lf:%lf,%lf:%lf", coll,
+                        &model.root_base, &model.root_np, &model.peer_base, &model.peer_np,
+                        &model.tmp_base, &model.tmp_np) + 1;
+        }
+        if( rc < 6 ) {
+            fprintf(stderr, "BIGCOUNT_MEMORY_MODEL: invalid entry '%s'\n", entry);
+            exit(1);
+        }
+        model.coll = strdup(coll);
+        model.component = ('\0' != component[0]) ? strdup(component) : NULL;
+
+        mem_model_overrides = (mem_model_t*)realloc(mem_model_overrides,
+                                                    sizeof(mem_model_t) * (num_mem_model_overrides + 1));
+        assert(NULL != mem_model_overrides);
+        mem_model_overrides[num_mem_model_overrides++] = model;
+    }
+    free(cpy_str);
+}
+
+/*
+ * Find the memory model of a collective. Search order:
+ *  1) BIGCOUNT_MEMORY_MODEL entry for the collective and coll component
+ *  2) BIGCOUNT_MEMORY_MODEL entry for the collective
+ *  3) Default entry for the collective and coll component
+ *  4) Default entry for the collective
+ *
+ * @param coll name of the collective
+ * @return memory model. Does not return if the collective is unknown.
+ */
+static const mem_model_t * find_mem_model(const char *coll)
+{
+    int i, pass;
+    const mem_model_t *table;
+    int table_len;
+    bool component_pass;
+
+    for( pass = 0; pass < 4; ++pass ) {
+        table = (pass < 2) ? mem_model_overrides : mem_models;
+        table_len = (pass < 2) ? num_mem_model_overrides : (int)NUM_MEM_MODELS;
+        component_pass = (0 == pass % 2);
+        if( component_pass && NULL == coll_component ) {
+            continue;
+        }
+        for( i = 0; i < table_len; ++i ) {
+            if( 0 != strcmp(table[i].coll, coll) ) {
+                continue;
+            }
+            if( component_pass ) {
+                if( NULL != table[i].component && 0 == strcmp(table[i].component, coll_component) ) {
+                    return &table[i];
+                }
+            } else if( NULL == table[i].component ) {
+                return &table[i];
+            }
+        }
+    }
+
+    fprintf(stderr, "Error: No memory model for collective '%s'\n", coll);
+    exit(1);
+}
+
+#ifdef MPI_VERSION
+/*
+ * Test cases of the progress journal (see journal_filename). Records are
+ *   start <run> <case>
+ *   done <run> <case> passed|failed
+ * where <run> identifies the run of the test program that wrote the record.
+ *  - key    : <case>, the test program, communicator shape, topology, op,
+ *             datatype, variant, mode, in place, stride and requested count
+ *  - starts : number of runs that started the case
+ *  - done   : the case completed (passed: its result)
+ */
+typedef struct {
+    char *key;
+    int starts;
+    bool done;
+    bool passed;
+    char last_run[32];
+} journal_entry_t;
+
+journal_entry_t *journal_entries = NULL;
+int num_journal_entries = 0;
+char journal_run[32] = "";
+
+/*
+ * Find (or add) the journal entry of a test case
+ *
+ * @param key case of the entry
+ * @param add add the entry if not found
+ * @return entry, NULL if not found and not added
+ */
+static journal_entry_t * journal_find(const char *key, bool add)
+{
+    int i;
+
+    for(i = 0; i < num_journal_entries; ++i) {
+        if( 0 == strcmp(journal_entries[i].key, key) ) {
+            return &journal_entries[i];
+        }
+    }
+    if( !add ) {
+        return NULL;
+    }
+    journal_entries = (journal_entry_t*)realloc(journal_entries,
+                                                (num_journal_entries + 1) * sizeof(journal_entry_t));
+    memset(&journal_entries[num_journal_entries], 0, sizeof(journal_entry_t));
+    journal_entries[num_journal_entries].key = strdup(key);
+    return &journal_entries[num_journal_entries++];
+}
+
+/*
+ * Read the journal of the previous runs (rank 0 of MPI_COMM_WORLD reads the
+ * file and broadcasts it), and pick the identifier of this run.
+ * Note: Called by init_environment
+ */
+static void journal_load(void)
+{
+    FILE *journal_file = NULL;
+    char *contents = NULL, *line, *saveptr = NULL, *run, *key, *result;
+    long len = 0;
+    journal_entry_t *entry;
+
+    if( 0 == world_rank ) {
+        snprintf(journal_run, sizeof(journal_run), "%ld.%d", (long)time(NULL), (int)getpid());
+        journal_file = fopen(journal_filename, "r");
+        if( NULL != journal_file ) {
+            fseek(journal_file, 0, SEEK_END);
+            len = ftell(journal_file);
+            fseek(journal_file, 0, SEEK_SET);
+            contents = (char*)malloc(len + 1);
+            len = (long)fread(contents, 1, len, journal_file);
+            fclose(journal_file);
+        }
+    }
+    MPI_Bcast(journal_run, sizeof(journal_run), MPI_CHAR, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&len, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+    if( 0 == len ) {
+        free(contents);
+        return;
+    }
+    if( 0 != world_rank ) {
+        contents = (char*)malloc(len + 1);
+    }
+    MPI_Bcast(contents, (int)len, MPI_CHAR, 0, MPI_COMM_WORLD);
+    contents[len] = '\0';
+
+    for( line = strtok_r(contents, "\n", &saveptr); NULL != line; line = strtok_r(NULL, "\n", &saveptr) ) {
+        run = strchr(line, ' ');
+        key = (NULL != run) ? strchr(run + 1, ' ') : NULL;
+        if( NULL == key ) {
+            continue;
+        }
+        *run++ = '\0';
+        *key++ = '\0';
+        if( 0 == strcmp(line, "start") ) {
+            entry = journal_find(key, true);
+            if( 0 != strcmp(entry->last_run, run) ) {
+                entry->starts += 1;
+                snprintf(entry->last_run, sizeof(entry->last_run), "%s", run);
+            }
+        } else if( 0 == strcmp(line, "done") && NULL != (result = strrchr(key, ' ')) ) {
+            *result++ = '\0';
+            // Split shapes record one result per sub-communicator
+            entry = journal_find(key, true);
+            entry->passed = (entry->done ? entry->passed : true) && (0 == strcmp(result, "passed"));
+            entry->done = true;
+        }
+    }
+    free(contents);
+}
+#endif
+
+/*
+ * Display a diagnostic table
+ */
+static inline void display_diagnostics(void) {
+    printf("----------------------:-----------------------------------------\n");
+    printf("Total Memory Avail.   : %4d GB\n", total_sys_mem_gb);
+    printf("Percent memory to use : %4d %%\n", mem_percent);
+    printf("Tolerate diff.        : %4d GB\n", mem_diff_tolerance);
+    printf("Max memory to use     : %4d GB\n", max_sys_mem_gb);
+    if( num_nodes > 0 ) {
+        int min_local = node_budgets[0].local_size, max_local = min_local;
+        int max_mem = node_budgets[0].mem_gb;
+        for(int n = 1; n < num_nodes; ++n) {
+            min_local = (node_budgets[n].local_size < min_local) ? node_budgets[n].local_size : min_local;
+            max_local = (node_budgets[n].local_size > max_local) ? node_budgets[n].local_size : max_local;
+            max_mem = (node_budgets[n].mem_gb > max_mem) ? node_budgets[n].mem_gb : max_mem;
+        }
+        printf("Nodes                 : %4d (%d to %d processes, %d to %d GB per node)\n",
+               num_nodes, min_local, max_local, max_sys_mem_gb, max_mem);
+    }
+    if( NULL != coll_component || num_mem_model_overrides > 0 ) {
+        printf("Memory model          : %s (%d override%s)\n",
+               (NULL != coll_component) ? coll_component : "default",
+               num_mem_model_overrides, (1 == num_mem_model_overrides) ? "" : "s");
+    }
+    if( SHAPE_WORLD != comm_shapes ) {
+        printf("Communicator shapes   :%s%s%s%s%s\n",
+               (comm_shapes & SHAPE_WORLD) ? " world" : "", (comm_shapes & SHAPE_SHARED) ? " shared" : "",
+               (comm_shapes & SHAPE_LEADERS) ? " leaders" : "", (comm_shapes & SHAPE_SPLIT) ? " split" : "",
+               (comm_shapes & SHAPE_INTER) ? " inter" : "");
+    }
+    if( TOPO_ALL != topologies ) {
+        printf("Topologies            :%s%s%s\n",
+               (topologies & TOPO_CART2D) ? " cart2d" : "", (topologies & TOPO_CART3D) ? " cart3d" : "",
+               (topologies & TOPO_GRAPH) ? " graph" : "");
+    }
+    printf("Datatypes             :");
+    for(int t = 0; t < NUM_TEST_TYPES; ++t) {
+        if( test_types[t].enabled ) {
+            printf(" %s", test_types[t].key);
+        }
+    }
+    printf("\n");
+    printf("Reduction ops         :");
+    for(int o = 0; o < NUM_TEST_OPS; ++o) {
+        if( test_ops[o].enabled ) {
+            printf(" %s", test_ops[o].key);
+        }
+    }
+    printf("\n");
+#ifdef MPI_VERSION
+    if( sweep_enabled ) {
+        printf("Sweep payload         : %zu - %zu bytes (x %.2f, %s)\n", sweep_min, sweep_max,
+               sweep_factor, test_types[sweep_type].name);
+    }
+    if( num_strides > 0 ) {
+        printf("Stride sweep          :");
+        for(int d = 0; d < num_strides; ++d) {
+            printf(" %zu%s", strides[d], stride_in_pages[d] ? "p" : "");
+        }
+        printf(" (%s, page %ld bytes)\n", test_types[sweep_type].name, sysconf(_SC_PAGESIZE));
+    }
+    if( NULL != journal_filename ) {
+        int completed = 0, died = 0;
+        for(int e = 0; e < num_journal_entries; ++e) {
+            completed += journal_entries[e].done ? 1 : 0;
+            died += (!journal_entries[e].done && journal_entries[e].starts > 0) ? 1 : 0;
+        }
+        printf("Progress journal      : %s (%d completed, %d interrupted cases)\n",
+               journal_filename, completed, died);
+    }
+#endif
+    if( allow_persistent ) {
+        printf("Persistent iterations : %4d\n", timing_enabled ? timing_iterations + timing_warmup : persistent_iterations);
+    }
+    if( allow_reference ) {
+        printf("Reference chunks      : %10s x %d in flight\n", human_bytes(ref_chunk_bytes), ref_depth);
+    }
+    if( timing_enabled ) {
+        printf("Timing iterations     : %4d (+%d warmup)\n", timing_iterations, timing_warmup);
+    }
+    if( overlap_enabled ) {
+        if( overlap_poll_us > 0 ) {
+            printf("Overlap compute       : MPI_Test every %d usec\n", overlap_poll_us);
+        } else {
+            printf("Overlap compute       : no MPI_Test\n");
+        }
+    }
+    if( fill_threads > 1 ) {
+        printf("Fill/Verify threads   : %4d\n", fill_threads);
+    }
+    if( memtrack_enabled ) {
+        printf("Memory tracking       : VmHWM/VmRSS%s\n", memtrack_smaps ? " + smaps_rollup" : "");
+    }
+    if( skew_enabled ) {
+        printf("Skew report           : %4d slowest ranks\n", skew_top);
+    }
+    if( roofline_gbs > 0.0 ) {
+        printf("Memory roofline       : %10.3f GB/s per node\n", roofline_gbs);
+    }
+#ifdef TEST_BIGCOUNT_API
+    printf("Count API             : MPI-4 large count (MPI_Count / MPI_Aint)\n");
+#endif
+    if( ALLOC_MALLOC != alloc_mode || alloc_numa_local ) {
+        printf("Buffer allocator      : %s%s%s%s\n", alloc_mode_name(),
+               (ALLOC_FILE == alloc_mode) ? " in " : "", (ALLOC_FILE == alloc_mode) ? alloc_dir : "",
+               alloc_numa_local ? " (local NUMA node)" : "");
+    }
+#if defined(__AVX512F__)
+    printf("Verify kernel         : AVX-512\n");
+#elif defined(__AVX2__)
+    printf("Verify kernel         : AVX2\n");
+#endif
+    printf("----------------------:-----------------------------------------\n");
+    printf("INT_MAX               : %20zu\n", (size_t)INT_MAX);
+    printf("UINT_MAX              : %20zu\n", (size_t)UINT_MAX);
+    printf("SIZE_MAX              : %20zu\n", (size_t)SIZE_MAX);
+    printf("----------------------:-----------------------------------------\n");
+    printf("                      : Count x Datatype size      = Total Bytes\n");
+#ifndef TEST_UNIFORM_COUNT
+    printf("TEST_PAYLOAD_SIZE     : %20zu       = %10s\n", (size_t)TEST_PAYLOAD_SIZE, human_bytes((size_t)TEST_PAYLOAD_SIZE));
+#else
+    printf("TEST_UNIFORM_COUNT    : %20zu\n", (size_t)TEST_UNIFORM_COUNT);
+#endif
+    printf("V_SIZE_DOUBLE_COMPLEX : %20zu x %3zu = %10s\n", (size_t)V_SIZE_DOUBLE_COMPLEX, sizeof(double _Complex), human_bytes(V_SIZE_DOUBLE_COMPLEX * sizeof(double _Complex)));
+    printf("V_SIZE_DOUBLE         : %20zu x %3zu = %10s\n", (size_t)V_SIZE_DOUBLE, sizeof(double), human_bytes(V_SIZE_DOUBLE * sizeof(double)));
+    printf("V_SIZE_FLOAT_COMPLEX  : %20zu x %3zu = %10s\n", (size_t)V_SIZE_FLOAT_COMPLEX, sizeof(float _Complex), human_bytes(V_SIZE_FLOAT_COMPLEX * sizeof(float _Complex)));
+    printf("V_SIZE_FLOAT          : %20zu x %3zu = %10s\n", (size_t)V_SIZE_FLOAT, sizeof(float), human_bytes(V_SIZE_FLOAT * sizeof(float)));
+    printf("V_SIZE_INT            : %20zu x %3zu = %10s\n", (size_t)V_SIZE_INT, sizeof(int), human_bytes(V_SIZE_INT * sizeof(int)));
+    printf("V_SIZE_INT64          : %20zu x %3zu = %10s\n", (size_t)V_SIZE_INT64, sizeof(int64_t), human_bytes(V_SIZE_INT64 * sizeof(int64_t)));
+    printf("V_SIZE_CHAR           : %20zu x %3zu = %10s\n", (size_t)V_SIZE_CHAR, sizeof(unsigned char), human_bytes(V_SIZE_CHAR * sizeof(unsigned char)));
+    printf("V_SIZE_CONTIG         : %20zu x %3zu = %10s\n", (size_t)V_SIZE_CONTIG, 2 * sizeof(int), human_bytes(V_SIZE_CONTIG * (2 * sizeof(int))));
+    printf("----------------------:-----------------------------------------\n");
+}
+
+/*
+ * Initialize the unit testing environment
+ * Note: Must be called after MPI_Init()
+ *
+ * @param argc Argument count
+ * @param argv Array of string arguments
+ * @return 0 on success
+ */
+int init_environment(int argc, char** argv) {
+    char *alloc_str = NULL;
+    char *token = NULL;
+    char *env_str = NULL;
+    int t;
+
+    max_sys_mem_gb = get_max_memory();
+
+    if( NULL != getenv("BIGCOUNT_ALLOC") ) {
+        alloc_str = strdup(getenv("BIGCOUNT_ALLOC"));
+        for( token = strtok(alloc_str, ","); NULL != token; token = strtok(NULL, ",") ) {
+            if( 0 == strcasecmp(token, "malloc") ) {
+                alloc_mode = ALLOC_MALLOC;
+            } else if( 0 == strcasecmp(token, "4k") ) {
+                alloc_mode = ALLOC_4K;
+            } else if( 0 == strcasecmp(token, "thp") ) {
+                alloc_mode = ALLOC_THP;
+            } else if( 0 == strcasecmp(token, "hugetlb") ) {
+                alloc_mode = ALLOC_HUGETLB;
+            } else if( 0 == strcasecmp(token, "shm") ) {
+                alloc_mode = ALLOC_SHM;
+            } else if( 0 == strcasecmp(token, "mlock") ) {
+                alloc_mode = ALLOC_MLOCK;
+            } else if( 0 == strcasecmp(token, "file") ) {
+                alloc_mode = ALLOC_FILE;
+            } else if( 0 == strcasecmp(token, "numa") ) {
+                alloc_numa_local = true;
+            } else {
+                fprintf(stderr, "BIGCOUNT_ALLOC: unknown allocator '%s'\n", token);
+                exit(1);
+            }
+        }
+        free(alloc_str);
+    }
+
+    if( NULL != getenv("BIGCOUNT_ALLOC_DIR") && '\0' != getenv("BIGCOUNT_ALLOC_DIR")[0] ) {
+        alloc_dir = getenv("BIGCOUNT_ALLOC_DIR");
+    }
+
+    if( NULL != getenv("BIGCOUNT_COLL_COMPONENT") && '\0' != getenv("BIGCOUNT_COLL_COMPONENT")[0] ) {
+        coll_component = getenv("BIGCOUNT_COLL_COMPONENT");
+    }
+
+    if( NULL != getenv("BIGCOUNT_MEMORY_MODEL") ) {
+        parse_mem_model_overrides(getenv("BIGCOUNT_MEMORY_MODEL"));
+    }
+
+    if( argc > 0 && NULL != argv[0] ) {
+        snprintf(test_name, sizeof(test_name), "%s",
+                 (NULL != strrchr(argv[0], '/')) ? strrchr(argv[0], '/') + 1 : argv[0]);
+    }
+
+#ifdef MPI_VERSION
+    int i;
+    int local_rank;
+    MPI_Comm node_comm, leader_comm;
+    node_budget_t my_budget;
+    char *mem_diff_tolerance_str = NULL;
+    int min_mem = 0, max_mem = 0, min_local = 0, max_local = 0;
+
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Get_processor_name(my_hostname, &i);
+
+    // Processes of this node (shared memory domain)
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_size(node_comm, &local_size);
+    MPI_Comm_rank(node_comm, &local_rank);
+
+    if( NULL != (env_str = getenv("BIGCOUNT_COMM_SHAPES")) ) {
+        char *shapes = strdup(env_str), *saveptr = NULL, *tok;
+        comm_shapes = 0;
+        for( tok = strtok_r(shapes, ",", &saveptr); NULL != tok; tok = strtok_r(NULL, ",", &saveptr) ) {
+            if( 0 == strcasecmp(tok, "world") ) {
+                comm_shapes |= SHAPE_WORLD;
+            } else if( 0 == strcasecmp(tok, "shared") ) {
+                comm_shapes |= SHAPE_SHARED;
+            } else if( 0 == strcasecmp(tok, "leaders") ) {
+                comm_shapes |= SHAPE_LEADERS;
+            } else if( 0 == strcasecmp(tok, "split") ) {
+                comm_shapes |= SHAPE_SPLIT;
+            } else if( 0 == strcasecmp(tok, "inter") ) {
+                comm_shapes |= SHAPE_INTER;
+            } else if( 0 == strcasecmp(tok, "all") ) {
+                comm_shapes |= SHAPE_ALL;
+            } else if( 0 == world_rank ) {
+                printf("Warning: Unknown BIGCOUNT_COMM_SHAPES shape '%s' (world, shared, leaders, split, inter, all)\n", tok);
+            }
+        }
+        free(shapes);
+        if( 0 == comm_shapes ) {
+            comm_shapes = SHAPE_WORLD;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_TOPOLOGIES")) ) {
+        char *topos = strdup(env_str), *saveptr = NULL, *tok;
+        topologies = 0;
+        for( tok = strtok_r(topos, ",", &saveptr); NULL != tok; tok = strtok_r(NULL, ",", &saveptr) ) {
+            if( 0 == strcasecmp(tok, "cart2d") ) {
+                topologies |= TOPO_CART2D;
+            } else if( 0 == strcasecmp(tok, "cart3d") ) {
+                topologies |= TOPO_CART3D;
+            } else if( 0 == strcasecmp(tok, "graph") ) {
+                topologies |= TOPO_GRAPH;
+            } else if( 0 == strcasecmp(tok, "all") ) {
+                topologies |= TOPO_ALL;
+            } else if( 0 == world_rank ) {
+                printf("Warning: Unknown BIGCOUNT_TOPOLOGIES topology '%s' (cart2d, cart3d, graph, all)\n", tok);
+            }
+        }
+        free(topos);
+        if( 0 == topologies ) {
+            topologies = TOPO_ALL;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_ENABLE_NONBLOCKING")) ) {
+        if( 'y' == env_str[0] || 'Y' == env_str[0] || '1' == env_str[0] ) {
+            allow_nonblocked = true;
+        } else {
+            allow_nonblocked = false;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_ENABLE_PERSISTENT")) ) {
+        if( 'y' == env_str[0] || 'Y' == env_str[0] || '1' == env_str[0] ) {
+            allow_persistent = true;
+        } else {
+            allow_persistent = false;
+        }
+    }
+#ifndef HAVE_PERSISTENT_COLL
+    if( allow_persistent ) {
+        if( 0 == world_rank ) {
+            printf("Warning: Persistent collectives are not supported by this MPI. Disabling BIGCOUNT_ENABLE_PERSISTENT\n");
+        }
+        allow_persistent = false;
+    }
+#endif
+
+    if( NULL != (env_str = getenv("BIGCOUNT_PERSISTENT_ITERATIONS")) ) {
+        persistent_iterations = (int)strtol(env_str, NULL, 10);
+        if( persistent_iterations < 1 ) {
+            persistent_iterations = 1;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_REFERENCE")) ) {
+        if( 'y' == env_str[0] || 'Y' == env_str[0] || '1' == env_str[0] ) {
+            allow_reference = true;
+        } else {
+            allow_reference = false;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_REFERENCE_CHUNK")) ) {
+        ref_chunk_bytes = parse_bytes(env_str);
+        if( ref_chunk_bytes < 1 ) {
+            ref_chunk_bytes = 1;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_REFERENCE_DEPTH")) ) {
+        ref_depth = (int)strtol(env_str, NULL, 10);
+        if( ref_depth < 1 ) {
+            ref_depth = 1;
+        } else if( ref_depth > REF_MAX_DEPTH ) {
+            ref_depth = REF_MAX_DEPTH;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_ALG_INFLATION")) ) {
+        alg_inflation = strtod(env_str, NULL);
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_TIMING")) ) {
+        if( 'y' == env_str[0] || 'Y' == env_str[0] || '1' == env_str[0] ) {
+            timing_enabled = true;
+        } else {
+            timing_enabled = false;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_TIMING_WARMUP")) ) {
+        timing_warmup = (int)strtol(env_str, NULL, 10);
+        if( timing_warmup < 0 ) {
+            timing_warmup = 0;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_TIMING_ITERATIONS")) ) {
+        timing_iterations = (int)strtol(env_str, NULL, 10);
+        if( timing_iterations < 1 ) {
+            timing_iterations = 1;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_OVERLAP")) ) {
+        if( 'y' == env_str[0] || 'Y' == env_str[0] || '1' == env_str[0] ) {
+            overlap_enabled = true;
+        } else {
+            overlap_enabled = false;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_OVERLAP_POLL")) ) {
+        overlap_poll_us = (int)strtol(env_str, NULL, 10);
+        if( overlap_poll_us < 0 ) {
+            overlap_poll_us = 0;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SWEEP")) ) {
+        if( 'y' == env_str[0] || 'Y' == env_str[0] || '1' == env_str[0] ) {
+            sweep_enabled = true;
+        } else {
+            sweep_enabled = false;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SWEEP_MIN")) ) {
+        sweep_min = parse_bytes(env_str);
+        if( sweep_min < 1 ) {
+            sweep_min = 1;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SWEEP_MAX")) ) {
+        sweep_max = parse_bytes(env_str);
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SWEEP_FACTOR")) ) {
+        sweep_factor = strtod(env_str, NULL);
+        if( sweep_factor <= 1.0 ) {
+            sweep_factor = 2.0;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SWEEP_DATATYPE")) ) {
+        for(i = 0; i < NUM_TEST_TYPES; ++i) {
+            if( 0 == strcasecmp(env_str, test_types[i].key) ) {
+                sweep_type = i;
+            }
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_STRIDES")) ) {
+        char *list = strdup(env_str), *saveptr = NULL, *tok, *end;
+        if( 0 == strcasecmp(list, "all") ) {
+            free(list);
+            list = strdup("0,1,64,4096,1p,2p,16p");
+        }
+        num_strides = 0;
+        for( tok = strtok_r(list, ",", &saveptr); NULL != tok && num_strides < MAX_STRIDES;
+             tok = strtok_r(NULL, ",", &saveptr) ) {
+            strides[num_strides] = (size_t)strtoul(tok, &end, 10);
+            stride_in_pages[num_strides] = ('p' == *end || 'P' == *end);
+            if( end == tok || ('\0' != *end && !stride_in_pages[num_strides]) ) {
+                if( 0 == world_rank ) {
+                    printf("Warning: Invalid BIGCOUNT_STRIDES stride '%s' (elements, or pages with a 'p' suffix)\n", tok);
+                }
+                continue;
+            }
+            ++num_strides;
+        }
+        free(list);
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_MEMTRACK")) ) {
+        memtrack_smaps = (0 == strcasecmp(env_str, "smaps"));
+        memtrack_enabled = memtrack_smaps || 'y' == env_str[0] || 'Y' == env_str[0] || '1' == env_str[0];
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SKEW")) ) {
+        skew_enabled = ('y' == env_str[0] || 'Y' == env_str[0] || '1' == env_str[0]);
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_ROOFLINE")) ) {
+        roofline_gbs = strtod(env_str, NULL);
+        if( roofline_gbs < 0.0 ) {
+            roofline_gbs = 0.0;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SKEW_TOP")) ) {
+        skew_top = (int)strtol(env_str, NULL, 10);
+        if( skew_top < 1 ) {
+            skew_top = 1;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_RESULTS_FILE")) && '\0' != env_str[0] ) {
+        results_filename = env_str;
+        env_str = strrchr(results_filename, '.');
+        results_csv = (NULL != env_str && 0 == strcmp(env_str, ".csv"));
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_RESULTS_FORMAT")) ) {
+        results_csv = (0 == strcasecmp(env_str, "csv"));
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_JOURNAL")) && '\0' != env_str[0] ) {
+        journal_filename = env_str;
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_JOURNAL_SHRINK")) ) {
+        journal_shrink = strtod(env_str, NULL);
+        if( journal_shrink <= 0.0 || journal_shrink >= 1.0 ) {
+            journal_shrink = 0.5;
+        }
+    }
+    if( NULL != journal_filename ) {
+        journal_load();
+    }
+
+    mem_diff_tolerance_str = getenv("BIGCOUNT_MEMORY_DIFF");
+    if (NULL != mem_diff_tolerance_str) {
+        mem_diff_tolerance = strtol(mem_diff_tolerance_str, NULL, 10);
+    }
+
+    // Budget the memory per node: the processes of a node share the smallest
+    // memory limit that they see, and the leader of each node exchanges the
+    // processes and memory limit of its node with the other leaders
+    MPI_Allreduce(MPI_IN_PLACE, &max_sys_mem_gb, 1, MPI_INT, MPI_MIN, node_comm);
+    MPI_Comm_split(MPI_COMM_WORLD, (0 == local_rank) ? 0 : MPI_UNDEFINED, world_rank, &leader_comm);
+    if( 0 == local_rank ) {
+        MPI_Comm_size(leader_comm, &num_nodes);
+    }
+    MPI_Bcast(&num_nodes, 1, MPI_INT, 0, node_comm);
+    node_budgets = (node_budget_t*)safe_malloc(sizeof(node_budget_t) * num_nodes);
+    if( 0 == local_rank ) {
+        my_budget.local_size = local_size;
+        my_budget.mem_gb = max_sys_mem_gb;
+        MPI_Allgather(&my_budget, 2, MPI_INT, node_budgets, 2, MPI_INT, leader_comm);
+        MPI_Comm_free(&leader_comm);
+    }
+    MPI_Bcast(node_budgets, 2 * num_nodes, MPI_INT, 0, node_comm);
+    MPI_Comm_free(&node_comm);
+
+    min_mem = max_mem = node_budgets[0].mem_gb;
+    min_local = max_local = node_budgets[0].local_size;
+    for(i = 1; i < num_nodes; ++i) {
+        min_mem = (node_budgets[i].mem_gb < min_mem) ? node_budgets[i].mem_gb : min_mem;
+        max_mem = (node_budgets[i].mem_gb > max_mem) ? node_budgets[i].mem_gb : max_mem;
+        min_local = (node_budgets[i].local_size < min_local) ? node_budgets[i].local_size : min_local;
+        max_local = (node_budgets[i].local_size > max_local) ? node_budgets[i].local_size : max_local;
+    }
+    if( 0 == world_rank && (min_local != max_local || max_mem - min_mem > mem_diff_tolerance) ) {
+        printf("Warning: Non-uniform nodes: %d to %d processes, %d to %d GB. Counts are budgeted per node\n",
+               min_local, max_local, min_mem, max_mem);
+    }
+    // Smallest node limit (the counts use the budget of each node)
+    max_sys_mem_gb = min_mem;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+#else
+    world_size = world_rank = local_size = -1;
+    snprintf(my_hostname, MPI_MAX_PROCESSOR_NAME, "localhost");
+#endif
+
+    if( NULL != (env_str = getenv("BIGCOUNT_DATATYPES")) ) {
+        char *types = strdup(env_str), *saveptr = NULL, *tok;
+        bool found;
+        for(t = 0; t < NUM_TEST_TYPES; ++t) {
+            test_types[t].enabled = (0 == strcasecmp(env_str, "all"));
+        }
+        for( tok = strtok_r(types, ",", &saveptr); NULL != tok; tok = strtok_r(NULL, ",", &saveptr) ) {
+            found = (0 == strcasecmp(tok, "all"));
+            for(t = 0; t < NUM_TEST_TYPES; ++t) {
+                if( 0 == strcasecmp(tok, test_types[t].key) ) {
+                    test_types[t].enabled = found = true;
+                }
+            }
+            if( !found && world_rank <= 0 ) {
+                printf("Warning: Unknown BIGCOUNT_DATATYPES datatype '%s'\n", tok);
+            }
+        }
+        free(types);
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_OPS")) ) {
+        char *ops = strdup(env_str), *saveptr = NULL, *tok;
+        bool found;
+        for(t = 0; t < NUM_TEST_OPS; ++t) {
+            test_ops[t].enabled = (0 == strcasecmp(env_str, "all"));
+        }
+        for( tok = strtok_r(ops, ",", &saveptr); NULL != tok; tok = strtok_r(NULL, ",", &saveptr) ) {
+            found = (0 == strcasecmp(tok, "all"));
+            for(t = 0; t < NUM_TEST_OPS; ++t) {
+                if( 0 == strcasecmp(tok, test_ops[t].key) ) {
+                    test_ops[t].enabled = found = true;
+                }
+            }
+            if( !found && world_rank <= 0 ) {
+                printf("Warning: Unknown BIGCOUNT_OPS op '%s'\n", tok);
+            }
+        }
+        free(ops);
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_THREADS")) ) {
+        fill_threads = (int)strtol(env_str, NULL, 10);
+#ifdef _OPENMP
+        if( fill_threads <= 0 ) {
+            fill_threads = omp_get_max_threads();
+        }
+#else
+        fill_threads = 1;
+#endif
+    }
+
+#ifdef MPI_VERSION
+    init_test_types();
+#endif
+
+    if( 0 == world_rank || -1 == world_rank ) {
+        display_diagnostics();
+    }
+
+    return 0;
+}
+
+/*
+ * Largest count that fits in the memory limit of every node given the
+ * per-process buffer multipliers. The memory used on a node is linear in the
+ * count:
+ *   datatype_size x count x (mult_root + mult_peer x (local_size - 1))
+ * so the count of each node is computed directly instead of searched for.
+ * Any node may hold the root. Without MPI, this process is the only node.
+ *
+ * @param datatype_size size of the datatype
+ * @param mult_root memory multiplier at root (including temporary buffers)
+ * @param mult_peer memory multiplier at non-roots (including temporary buffers)
+ * @param node (OUT) budget of the node that limits the count
+ * @return largest count (SIZE_MAX if the collective uses no memory)
+ */
+static size_t node_max_count(size_t datatype_size, double mult_root, double mult_peer,
+                             node_budget_t *node)
+{
+    node_budget_t budget;
+    double bytes_per_count, count;
+    size_t max_count = SIZE_MAX;
+    int n;
+
+    node->local_size = (local_size > 0) ? local_size : 1;
+    node->mem_gb = max_sys_mem_gb;
+    for(n = 0; n < ((num_nodes > 0) ? num_nodes : 1); ++n) {
+        budget = (num_nodes > 0) ? node_budgets[n] : *node;
+        bytes_per_count = datatype_size * (mult_root + mult_peer * (budget.local_size - 1));
+        if( bytes_per_count <= 0.0 ) {
+            continue;
+        }
+        count = ((size_t)budget.mem_gb * 1024 * 1024 * 1024) / bytes_per_count;
+        if( count < (double)max_count ) {
+            max_count = (size_t)count;
+            *node = budget;
+        }
+    }
+    return max_count;
+}
+
+/*
+ * Solve for the largest count (up to proposed_count) that fits in the memory
+ * limit of every node given the per-process buffer multipliers (see
+ * node_max_count).
+ *
+ * @param coll_label label used in the adjustment message
+ * @param datatype_size size of the datatype
+ * @param proposed_count the count that the caller wishes to use
+ * @param mult_root memory multiplier at root (including temporary buffers)
+ * @param mult_peer memory multiplier at non-roots (including temporary buffers)
+ * @return proposed count to use in the collective
+ */
+static size_t solve_uniform_count(const char *coll_label, size_t datatype_size,
+                                  size_t proposed_count, double mult_root, double mult_peer)
+{
+    size_t orig_proposed_count = proposed_count;
+    size_t payload_size_root;
+    size_t payload_size_peer;
+    size_t payload_size_all;
+    size_t max_count;
+    node_budget_t node;
+    int num_local;
+    char *cpy_root = NULL, *cpy_peer = NULL;
+
+    max_count = node_max_count(datatype_size, mult_root, mult_peer, &node);
+    num_local = node.local_size;
+    if( proposed_count > max_count ) {
+        proposed_count = max_count;
+        if( 2 == debug && 0 == world_rank ) {
+            fprintf(stderr, "----DEBUG---- Adjusting count. %10zu x %.2f bytes per count to fit in %4d GB limit (%d processes) = %10zu\n",
+                    orig_proposed_count, datatype_size * (mult_root + mult_peer * (num_local - 1)),
+                    node.mem_gb, num_local, proposed_count);
+        }
+    }
+    assert(proposed_count > 0);
+
+    payload_size_root = (size_t)(datatype_size * proposed_count * mult_root);
+    payload_size_peer = (size_t)(datatype_size * proposed_count * mult_peer);
+    payload_size_all  = payload_size_root + (payload_size_peer * (num_local-1));
+
+    count_adjust_perc = (proposed_count / (double)orig_proposed_count) * 100.0;
+
+    if(proposed_count != orig_proposed_count ) {
+        if( 0 == world_rank ) {
+
+            printf("--------------------- Adjust count to fit in memory: %10zu x %5.1f%% = %10zu (%s)\n",
+                   orig_proposed_count,
+                   (proposed_count / (double)orig_proposed_count)*100,
+                   proposed_count, coll_label);
+
+            cpy_root = strdup(human_bytes(payload_size_root));
+            printf("Root  : payload %14zu %8s = %3zu dt x %10zu count x %7.2f buffers\n",
+                   payload_size_root, cpy_root,
+                   datatype_size, proposed_count, mult_root);
+
+            cpy_peer = strdup(human_bytes(payload_size_peer));
+            printf("Peer  : payload %14zu %8s = %3zu dt x %10zu count x %7.2f buffers\n",
+                   payload_size_peer, cpy_peer,
+                   datatype_size, proposed_count, mult_peer);
+
+            printf("Total : payload %14zu %8s = %8s root + %8s x %3d local peers\n",
+                   payload_size_all, human_bytes(payload_size_all),
+                   cpy_root, cpy_peer, num_local-1);
+
+            free(cpy_root);
+            free(cpy_peer);
+        }
+    }
+
+    return proposed_count;
+}
+
+/*
+ * Calculate the uniform count for this collective given the datatype size,
+ * number of processes (local and global), expected inflation in memory during
+ * the collective, and the amount of memory we are limiting this test to consuming
+ * on the system.
+ * Prefer calc_coll_count() which uses the per-collective memory model.
+ *
+ * @param datateye_size size of the datatype
+ * @param proposed_count the count that the caller wishes to use
+ * @param mult_root memory multiplier at root (useful in gather-like operations where the root gathers N times the count)
+ * @param mult_peer memory multiplier at non-roots (useful in allgather-like operations where the buffer is N times count)
+ * @return proposed count to use in the collective
+ */
+size_t calc_uniform_count(size_t datatype_size, size_t proposed_count,
+                          size_t mult_root, size_t mult_peer)
+{
+    return solve_uniform_count("custom", datatype_size, proposed_count,
+                               mult_root * alg_inflation, mult_peer * alg_inflation);
+}
+
+/*
+ * Buffer multipliers at the root and at the other processes of a collective,
+ * including the temporary buffers and BIGCOUNT_ALG_INFLATION.
+ *
+ * @param model memory model of the collective
+ * @param mult_root (OUT) memory multiplier at root
+ * @param mult_peer (OUT) memory multiplier at non-roots
+ */
+static void coll_mem_multipliers(const mem_model_t *model, double *mult_root, double *mult_peer)
+{
+    double np = (topo_blocks > 0) ? topo_blocks : (world_size > 0) ? world_size : 1;
+    double mult_tmp = model->tmp_base + model->tmp_np * np;
+
+    *mult_root = (model->root_base + model->root_np * np) * alg_inflation + mult_tmp;
+    *mult_peer = (model->peer_base + model->peer_np * np) * alg_inflation + mult_tmp;
+}
+
+/*
+ * Calculate the uniform count for a collective from its memory model
+ * (see mem_models and BIGCOUNT_MEMORY_MODEL), the datatype size, number of
+ * processes (local and global), and the amount of memory we are limiting this
+ * test to consuming on the system.
+ *
+ * @param coll name of the collective (e.g., "allreduce")
+ * @param datatype_size size of the datatype
+ * @param proposed_count the count per process that the caller wishes to use
+ * @return proposed count to use in the collective
+ */
+size_t calc_coll_count(const char *coll, size_t datatype_size, size_t proposed_count)
+{
+    const mem_model_t *model = find_mem_model(coll);
+    double mult_root, mult_peer;
+    char label[128];
+
+    coll_mem_multipliers(model, &mult_root, &mult_peer);
+
+    snprintf(label, sizeof(label), "%s%s%s", coll,
+             (NULL != model->component) ? "/" : "",
+             (NULL != model->component) ? model->component : "");
+
+    return solve_uniform_count(label, datatype_size, proposed_count,
+                               mult_root, mult_peer);
+}
+
+/*
+ * Largest count per process of a collective that fits in the memory limit
+ * (see calc_coll_count). Does not display anything.
+ *
+ * @param coll name of the collective (e.g., "allreduce")
+ * @param datatype_size size of the datatype
+ * @return largest count per process
+ */
+size_t coll_max_count(const char *coll, size_t datatype_size)
+{
+    double mult_root, mult_peer;
+    node_budget_t node;
+
+    coll_mem_multipliers(find_mem_model(coll), &mult_root, &mult_peer);
+
+    return node_max_count(datatype_size, mult_root, mult_peer, &node);
+}
+
+/*
+ * Memory of the process (see mem_sample)
+ */
+typedef struct {
+    size_t rss;        // VmRSS: resident memory (bytes)
+    size_t hwm;        // VmHWM: peak resident memory (bytes)
+    size_t pss;        // Pss of smaps_rollup (bytes, 0 unless memtrack_smaps)
+    size_t pss_shmem;  // Pss_Shmem of smaps_rollup (bytes, 0 unless memtrack_smaps)
+} mem_sample_t;
+
+/*
+ * Sample the memory of the process from /proc/self/status (and
+ * /proc/self/smaps_rollup with memtrack_smaps). Fields that cannot be read
+ * are left at 0.
+ *
+ * @param sample (OUT) memory of the process
+ */
+static inline void mem_sample(mem_sample_t *sample)
+{
+    char line[256];
+    size_t kb;
+    FILE *fp;
+
+    memset(sample, 0, sizeof(*sample));
+
+    if( NULL != (fp = fopen("/proc/self/status", "r")) ) {
+        while( NULL != fgets(line, sizeof(line), fp) ) {
+            if( 1 == sscanf(line, "VmRSS: %zu kB", &kb) ) {
+                sample->rss = kb * 1024;
+            } else if( 1 == sscanf(line, "VmHWM: %zu kB", &kb) ) {
+                sample->hwm = kb * 1024;
+            }
+        }
+        fclose(fp);
+    }
+
+    if( memtrack_smaps && NULL != (fp = fopen("/proc/self/smaps_rollup", "r")) ) {
+        while( NULL != fgets(line, sizeof(line), fp) ) {
+            if( 1 == sscanf(line, "Pss: %zu kB", &kb) ) {
+                sample->pss = kb * 1024;
+            } else if( 1 == sscanf(line, "Pss_Shmem: %zu kB", &kb) ) {
+                sample->pss_shmem = kb * 1024;
+            }
+        }
+        fclose(fp);
+    }
+}
+
+/*
+ * Reset VmHWM to the current resident memory (Linux 4.0 and later)
+ *
+ * @return true on success (otherwise VmHWM is the peak since the start of the process)
+ */
+static inline bool mem_reset_peak(void)
+{
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    bool ok;
+
+    if( NULL == fp ) {
+        return false;
+    }
+    ok = (EOF != fputs("5", fp));
+    return (0 == fclose(fp)) && ok;
+}
+
+#ifdef MPI_VERSION
+/*
+ * Timing state for a single collective test case.
+ * When timing is disabled the collective runs exactly once.
+ */
+typedef struct {
+    int variant;       // COLL_BLOCKING, COLL_NONBLOCKING, COLL_PERSISTENT or COLL_REFERENCE
+    bool overlap;      // Compute while the nonblocking collective progresses
+    int iter;          // Current iteration (including warmup)
+    int num_warmup;    // Untimed warmup iterations
+    int num_iters;     // Total iterations (warmup + timed)
+    double t_start;    // Start time of the current iteration
+    double t_min;      // Fastest timed iteration on this rank
+    double t_max;      // Slowest timed iteration on this rank
+    double t_sum;      // Sum of timed iterations on this rank
+    double t_setup;    // Time to create the persistent request on this rank
+    double t_comm;     // Overlap: time of the collective alone (last warmup iteration)
+    double t_compute;  // Overlap: compute time of the current iteration
+    double t_compute_sum; // Overlap: sum of the compute time of the timed iterations
+    double overlap_sum;   // Overlap: sum of the overlap ratio of the timed iterations
+    double g_min;      // Min across ranks of the average time (valid at rank 0 after timer_report)
+    double g_avg;      // Mean across ranks of the average time (valid at rank 0 after timer_report)
+    double g_max;      // Max across ranks of the average time (valid at rank 0 after timer_report)
+    double g_setup;    // Max across ranks of the setup time (valid at rank 0 after timer_report)
+    double g_comm;     // Max across ranks of the collective alone (valid at rank 0 after timer_report)
+    double g_compute;  // Max across ranks of the average compute time (valid at rank 0 after timer_report)
+    double g_overlap_min; // Min across ranks of the average overlap ratio (valid at rank 0 after timer_report)
+    double g_overlap;  // Mean across ranks of the average overlap ratio (valid at rank 0 after timer_report)
+    mem_sample_t mem_before; // Memtrack: memory of the process before the collective
+    bool mem_peak_reset;     // Memtrack: VmHWM was reset before the collective
+    double g_mem_temp;       // Memtrack: max across ranks of the temporary memory in bytes (valid at rank 0 after timer_report)
+    double g_mem_inflation;  // Memtrack: max across ranks of the peak / resident memory before (valid at rank 0 after timer_report)
+    double *skew_stamps;     // Skew: entry and exit time stamps of the timed iterations on this rank
+    double g_skew_arrival;   // Skew: max across timed iterations of the arrival skew (valid at rank 0 after timer_report)
+    double g_skew_completion; // Skew: max across timed iterations of the completion skew (valid at rank 0 after timer_report)
+} coll_timer_t;
+
+/*
+ * Units of work of the overlap compute kernel per second (see overlap_calibrate)
+ */
+double overlap_units_per_sec = 0.0;
+
+/*
+ * Compute kernel of the overlap mode: a dependent chain of floating point
+ * operations that does not touch memory (so does not compete with the
+ * collective for memory bandwidth).
+ *
+ * @param units amount of work
+ * @return value that depends on every step (to keep the loop)
+ */
+static inline double overlap_compute(size_t units)
+{
+    volatile double seed = 1.0;
+    double x = seed;
+    size_t i;
+
+    for(i = 0; i < units; ++i) {
+        x = x * 0.999999999 + 1.0e-9;
+    }
+    return x;
+}
+
+/*
+ * Measure the speed of the compute kernel (once per process)
+ */
+static void overlap_calibrate(void)
+{
+    size_t units = 1024;
+    double elapsed = 0.0, start;
+    volatile double sink;
+
+    if( overlap_units_per_sec > 0.0 ) {
+        return;
+    }
+    // Grow the amount of work until the measurement is long enough to be stable
+    while( elapsed < 0.05 ) {
+        units *= 2;
+        start = MPI_Wtime();
+        sink = overlap_compute(units);
+        elapsed = MPI_Wtime() - start;
+    }
+    (void)sink;
+    overlap_units_per_sec = units / elapsed;
+}
+
+/*
+ * Copy of the timer of the last test case (after timer_report)
+ */
+coll_timer_t last_timer;
+
+/*
+ * Times of the native blocking collective waiting for the reference run of
+ * the same test case (see native_case). The oldest entry is overwritten when
+ * the table is full.
+ *  - key  : native_case of the blocking run ('\0' if the entry is unused)
+ *  - time : max across ranks of the average time of the blocking run
+ */
+#define MAX_NATIVE_TIMES 64
+typedef struct {
+    char key[512];
+    double time;
+} native_time_t;
+native_time_t native_times[MAX_NATIVE_TIMES];
+int native_next = 0;
+
+/*
+ * Running test case without its variant (set by journal_start): test, shape,
+ * topology, op, datatype, mode, MPI_IN_PLACE, displacement stride and count
+ */
+char native_case[512] = "";
+
+/*
+ * Find the time of the native blocking run of a test case
+ *
+ * @param key native_case of the test case
+ * @return entry of the blocking run, NULL if none
+ */
+static inline native_time_t * native_find(const char *key)
+{
+    int i;
+
+    for(i = 0; i < MAX_NATIVE_TIMES; ++i) {
+        if( '\0' != native_times[i].key[0] && 0 == strcmp(native_times[i].key, key) ) {
+            return &native_times[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Reset the timer before the collective loop
+ * When timing is disabled the persistent variant runs persistent_iterations
+ * times (to exercise the reuse of the request), the others exactly once.
+ *
+ * @param timer timer to initialize
+ * @param variant COLL_BLOCKING, COLL_NONBLOCKING, COLL_PERSISTENT or COLL_REFERENCE
+ */
+static inline void timer_init(coll_timer_t *timer, int variant)
+{
+    timer->variant = variant;
+    timer->overlap = overlap_enabled && COLL_NONBLOCKING == variant;
+    timer->iter = 0;
+    timer->num_warmup = timing_enabled ? timing_warmup : 0;
+    if( timing_enabled ) {
+        timer->num_iters = timing_warmup + timing_iterations;
+    } else {
+        timer->num_iters = (COLL_PERSISTENT == variant) ? persistent_iterations : 1;
+    }
+    if( timer->overlap ) {
+        // One more warmup iteration without compute measures the collective alone
+        overlap_calibrate();
+        timer->num_warmup += 1;
+        timer->num_iters += 1;
+    }
+    timer->t_start = 0.0;
+    timer->t_min = 0.0;
+    timer->t_max = 0.0;
+    timer->t_sum = 0.0;
+    timer->t_setup = 0.0;
+    timer->t_comm = timer->t_compute = timer->t_compute_sum = timer->overlap_sum = 0.0;
+    timer->g_min = timer->g_avg = timer->g_max = timer->g_setup = 0.0;
+    timer->g_comm = timer->g_compute = timer->g_overlap_min = timer->g_overlap = 0.0;
+    timer->g_mem_temp = timer->g_mem_inflation = 0.0;
+    timer->g_skew_arrival = timer->g_skew_completion = 0.0;
+    timer->skew_stamps = NULL;
+    if( skew_enabled ) {
+        timer->skew_stamps = (double*)calloc(2 * (size_t)timer->num_iters, sizeof(double));
+    }
+    if( memtrack_enabled ) {
+        timer->mem_peak_reset = mem_reset_peak();
+        mem_sample(&timer->mem_before);
+    }
+}
+
+/*
+ * Check if there is another iteration of the collective to run
+ *
+ * @param timer timer state
+ * @return true if the collective should be called again
+ */
+static inline bool timer_more(const coll_timer_t *timer)
+{
+    return timer->iter < timer->num_iters;
+}
+
+/*
+ * Check if the receive buffer must be poisoned again before the next
+ * iteration: the persistent request already ran, and each MPI_Start must
+ * produce the result on its own
+ *
+ * @param timer timer state
+ * @return true before the second and later iterations of the persistent variant
+ */
+static inline bool timer_poison_due(const coll_timer_t *timer)
+{
+    return COLL_PERSISTENT == timer->variant && timer->iter > 0;
+}
+
+/*
+ * Check if the results must be checked after the iteration that just
+ * completed (outside the timed region): after every iteration of the
+ * persistent variant, after the last one otherwise
+ *
+ * @param timer timer state
+ * @return true if the receive buffer holds a result to check
+ */
+static inline bool timer_check_due(const coll_timer_t *timer)
+{
+    return COLL_PERSISTENT == timer->variant || !timer_more(timer);
+}
+
+/*
+ * Mark the start of the creation of the persistent request (MPI_*_init)
+ *
+ * @param timer timer state
+ */
+static inline void timer_setup_start(coll_timer_t *timer)
+{
+    if( timing_enabled ) {
+        MPI_Barrier(test_comm);
+    }
+    timer->t_start = MPI_Wtime();
+}
+
+/*
+ * Mark the completion of the creation of the persistent request. The setup
+ * time is reported separately from the iterations (steady state).
+ *
+ * @param timer timer state
+ */
+static inline void timer_setup_stop(coll_timer_t *timer)
+{
+    timer->t_setup = MPI_Wtime() - timer->t_start;
+}
+
+/*
+ * Mark the start of one collective call.
+ * All processes are synchronized first (timing and overlap modes) so that the
+ * iterations do not overlap.
+ *
+ * @param timer timer state
+ */
+static inline void timer_start(coll_timer_t *timer)
+{
+    if( timing_enabled || timer->overlap ) {
+        MPI_Barrier(test_comm);
+    }
+    timer->t_start = MPI_Wtime();
+    if( NULL != timer->skew_stamps ) {
+        timer->skew_stamps[2 * timer->iter] = timer->t_start;
+    }
+}
+
+/*
+ * Complete the nonblocking collective (instead of MPI_Wait).
+ * In the overlap mode the timed iterations first run the compute kernel for
+ * as long as the collective alone took, calling MPI_Test every
+ * overlap_poll_us microseconds of compute (if set).
+ *
+ * @param timer timer state
+ * @param request request of the nonblocking collective
+ */
+static inline void timer_wait(coll_timer_t *timer, MPI_Request *request)
+{
+    size_t units, chunk;
+    double start;
+    volatile double sink = 0.0;
+    int flag = 0;
+
+    if( timer->overlap && timer->iter >= timer->num_warmup ) {
+        units = (size_t)(timer->t_comm * overlap_units_per_sec);
+        chunk = units;
+        if( overlap_poll_us > 0 ) {
+            chunk = (size_t)(overlap_poll_us * 1.0e-6 * overlap_units_per_sec);
+            if( chunk < 1 ) {
+                chunk = 1;
+            }
+        }
+        start = MPI_Wtime();
+        while( units > 0 ) {
+            if( chunk > units ) {
+                chunk = units;
+            }
+            sink += overlap_compute(chunk);
+            units -= chunk;
+            if( overlap_poll_us > 0 && !flag ) {
+                MPI_Test(request, &flag, MPI_STATUS_IGNORE);
+            }
+        }
+        timer->t_compute = MPI_Wtime() - start;
+    }
+    (void)sink;
+    MPI_Wait(request, MPI_STATUS_IGNORE);
+}
+
+/*
+ * Mark the completion of one collective call (after the MPI_Wait for the
+ * nonblocking variants).
+ * In the overlap mode the overlap ratio of the iteration is the fraction of
+ * the shorter of the collective alone and the compute that was hidden:
+ *   (t_comm + t_compute - elapsed) / min(t_comm, t_compute)
+ * 1.0 is full overlap, 0.0 is no overlap (compute then communication).
+ *
+ * @param timer timer state
+ */
+static inline void timer_stop(coll_timer_t *timer)
+{
+    double elapsed = MPI_Wtime() - timer->t_start;
+    double shortest, ratio;
+
+    if( NULL != timer->skew_stamps ) {
+        timer->skew_stamps[2 * timer->iter + 1] = timer->t_start + elapsed;
+    }
+
+    if( timer->overlap ) {
+        if( timer->iter == timer->num_warmup - 1 ) {
+            timer->t_comm = elapsed;
+        } else if( timer->iter >= timer->num_warmup ) {
+            shortest = (timer->t_comm < timer->t_compute) ? timer->t_comm : timer->t_compute;
+            ratio = (shortest > 0.0) ? (timer->t_comm + timer->t_compute - elapsed) / shortest : 0.0;
+            if( ratio < 0.0 ) {
+                ratio = 0.0;
+            } else if( ratio > 1.0 ) {
+                ratio = 1.0;
+            }
+            timer->overlap_sum += ratio;
+            timer->t_compute_sum += timer->t_compute;
+        }
+    }
+
+    if( timer->iter >= timer->num_warmup ) {
+        if( timer->iter == timer->num_warmup || elapsed < timer->t_min ) {
+            timer->t_min = elapsed;
+        }
+        if( timer->iter == timer->num_warmup || elapsed > timer->t_max ) {
+            timer->t_max = elapsed;
+        }
+        timer->t_sum += elapsed;
+    }
+    ++timer->iter;
+}
+
+/*
+ * Average time of a timed iteration on this rank
+ *
+ * @param timer timer state
+ * @return average time in seconds
+ */
+static inline double timer_avg(coll_timer_t *timer)
+{
+    int num_timed = timer->num_iters - timer->num_warmup;
+    return (num_timed > 0) ? timer->t_sum / num_timed : 0.0;
+}
+
+/*
+ * Effective bandwidth of the slowest rank
+ *
+ * @param timer timer state (after timer_report)
+ * @param bytes payload size (in bytes)
+ * @return bandwidth in GB/s
+ */
+static inline double timer_bandwidth(coll_timer_t *timer, size_t bytes)
+{
+    return (timer->g_max > 0.0) ? (bytes / timer->g_max) / ((size_t)1024 * 1024 * 1024) : 0.0;
+}
+
+/*
+ * Bandwidth of the collective as a fraction of the memory roofline of a rank
+ * (its share of the copy bandwidth of the node, see BIGCOUNT_ROOFLINE)
+ *
+ * @param timer timer state (after timer_report)
+ * @param bytes payload size (in bytes)
+ * @return percentage of the roofline, 0 if BIGCOUNT_ROOFLINE is not set
+ */
+static inline double timer_roofline(coll_timer_t *timer, size_t bytes)
+{
+    double share = roofline_gbs / ((local_size > 0) ? local_size : 1);
+    return (share > 0.0) ? timer_bandwidth(timer, bytes) / share * 100.0 : 0.0;
+}
+
+/*
+ * Measure the temporary memory of the collective: the peak resident memory
+ * (VmHWM) since timer_init minus the resident memory (VmRSS) at timer_init.
+ * The buffers of the test are resident at timer_init (see safe_malloc), so
+ * this is the memory that the MPI library allocated during the collective.
+ * The inflation is the peak over the resident memory before, comparable to
+ * BIGCOUNT_ALG_INFLATION when the buffers dominate the memory of the process.
+ * With memtrack_smaps, the growth of Pss and Pss_Shmem is the memory still
+ * held after the collective (e.g., cached shared memory segments).
+ * Note: Must be called by all processes (uses MPI_Reduce)
+ *
+ * @param timer timer state
+ */
+static inline void memtrack_report(coll_timer_t *timer)
+{
+    mem_sample_t after;
+    struct {
+        double value;
+        int rank;
+    } local_temp, max_temp;
+    double local_inflation, sum_temp = 0.0, sum_inflation = 0.0;
+    double local_pss[2], max_pss[2];
+    int local_reset = timer->mem_peak_reset ? 1 : 0, all_reset = 0;
+
+    mem_sample(&after);
+    local_temp.value = (after.hwm > timer->mem_before.rss) ? (double)(after.hwm - timer->mem_before.rss) : 0.0;
+    local_temp.rank = world_rank;
+    local_inflation = (timer->mem_before.rss > 0) ? (double)after.hwm / timer->mem_before.rss : 0.0;
+    local_pss[0] = (double)after.pss - (double)timer->mem_before.pss;
+    local_pss[1] = (double)after.pss_shmem - (double)timer->mem_before.pss_shmem;
+
+    MPI_Reduce(&local_temp, &max_temp, 1, MPI_DOUBLE_INT, MPI_MAXLOC, 0, test_comm);
+    MPI_Reduce(&local_temp.value, &sum_temp, 1, MPI_DOUBLE, MPI_SUM, 0, test_comm);
+    MPI_Reduce(&local_inflation, &timer->g_mem_inflation, 1, MPI_DOUBLE, MPI_MAX, 0, test_comm);
+    MPI_Reduce(&local_inflation, &sum_inflation, 1, MPI_DOUBLE, MPI_SUM, 0, test_comm);
+    MPI_Reduce(&local_reset, &all_reset, 1, MPI_INT, MPI_MIN, 0, test_comm);
+    if( memtrack_smaps ) {
+        MPI_Reduce(local_pss, max_pss, 2, MPI_DOUBLE, MPI_MAX, 0, test_comm);
+    }
+    timer->g_mem_temp = max_temp.value;
+
+    if( 0 == world_rank ) {
+        printf("Memory: temp max %10s (rank %d) / avg %10s : inflation max %6.3f / avg %6.3f (BIGCOUNT_ALG_INFLATION %.2f)%s\n",
+               human_bytes((size_t)max_temp.value), max_temp.rank, human_bytes((size_t)(sum_temp / world_size)),
+               timer->g_mem_inflation, sum_inflation / world_size, alg_inflation,
+               all_reset ? "" : " (VmHWM not reset: peak since start)");
+        if( memtrack_smaps ) {
+            printf("Memory: held after max Pss %10s / Pss_Shmem %10s\n",
+                   human_bytes((max_pss[0] > 0.0) ? (size_t)max_pss[0] : 0),
+                   human_bytes((max_pss[1] > 0.0) ? (size_t)max_pss[1] : 0));
+        }
+    }
+}
+
+/*
+ * Estimate the offset of the clock (MPI_Wtime) of each rank from the clock of
+ * rank 0 (Cristian's algorithm): rank 0 sends SKEW_PINGS pings to each rank in
+ * turn, which replies with its clock. The ping with the shortest round trip
+ * gives the offset: remote clock - midpoint of the round trip, within half of
+ * the round trip.
+ * Note: Must be called by all processes
+ *
+ * @param offsets (OUT) offset of each rank (at rank 0, world_size entries)
+ * @return max across ranks of the error bound of the offset (at rank 0)
+ */
+#define SKEW_PINGS 8
+#define SKEW_TAG   4444  // Distinct from REF_TAG (reference.h), also used on test_comm
+
+static double skew_clock_offsets(double *offsets)
+{
+    double t_send, t_recv, remote, rtt, best_rtt, error = 0.0;
+    int r, i;
+
+    if( 0 != world_rank ) {
+        for(i = 0; i < SKEW_PINGS; ++i) {
+            MPI_Recv(NULL, 0, MPI_BYTE, 0, SKEW_TAG, test_comm, MPI_STATUS_IGNORE);
+            remote = MPI_Wtime();
+            MPI_Send(&remote, 1, MPI_DOUBLE, 0, SKEW_TAG, test_comm);
+        }
+        return 0.0;
+    }
+
+    offsets[0] = 0.0;
+    for(r = 1; r < world_size; ++r) {
+        best_rtt = -1.0;
+        for(i = 0; i < SKEW_PINGS; ++i) {
+            t_send = MPI_Wtime();
+            MPI_Send(NULL, 0, MPI_BYTE, r, SKEW_TAG, test_comm);
+            MPI_Recv(&remote, 1, MPI_DOUBLE, r, SKEW_TAG, test_comm, MPI_STATUS_IGNORE);
+            t_recv = MPI_Wtime();
+            rtt = t_recv - t_send;
+            if( best_rtt < 0.0 || rtt < best_rtt ) {
+                best_rtt = rtt;
+                offsets[r] = remote - (t_send + t_recv) / 2.0;
+            }
+        }
+        if( best_rtt / 2.0 > error ) {
+            error = best_rtt / 2.0;
+        }
+    }
+    return error;
+}
+
+/*
+ * Display the arrival and completion skew of the timed iterations, and the
+ * slowest ranks. Rank 0 gathers the entry and exit time stamps of every rank
+ * and corrects them by the clock offsets (estimated after the collective so
+ * the ping exchange does not skew the arrival). For each iteration the
+ * arrival skew is the last minus the first entry, and the completion skew the
+ * last minus the first exit. The lateness of a rank is its entry (exit) minus
+ * the first entry (exit), averaged across iterations. In the timing and
+ * overlap modes a barrier precedes each iteration, so the arrival skew is
+ * mostly that of the barrier.
+ * Note: Must be called by all processes (uses MPI_Gather)
+ *
+ * @param timer timer state
+ */
+static inline void skew_report(coll_timer_t *timer)
+{
+    int num_timed = timer->num_iters - timer->num_warmup;
+    double *offsets = NULL, *stamps = NULL, *late_in = NULL, *late_out = NULL;
+    double error, first_in, last_in, first_out, last_out, sum_arrival = 0.0, sum_completion = 0.0, t;
+    int r, i, k, slowest;
+    bool *listed = NULL;
+
+    if( 0 == world_rank ) {
+        offsets = (double*)malloc(world_size * sizeof(double));
+        stamps = (double*)malloc((size_t)world_size * 2 * num_timed * sizeof(double));
+        late_in = (double*)calloc(world_size, sizeof(double));
+        late_out = (double*)calloc(world_size, sizeof(double));
+        listed = (bool*)calloc(world_size, sizeof(bool));
+    }
+    error = skew_clock_offsets(offsets);
+    MPI_Gather(timer->skew_stamps + 2 * timer->num_warmup, 2 * num_timed, MPI_DOUBLE,
+               stamps, 2 * num_timed, MPI_DOUBLE, 0, test_comm);
+    free(timer->skew_stamps);
+    timer->skew_stamps = NULL;
+
+    if( 0 != world_rank ) {
+        return;
+    }
+
+    for(i = 0; i < num_timed; ++i) {
+        first_in = last_in = first_out = last_out = 0.0;
+        for(r = 0; r < world_size; ++r) {
+            stamps[(size_t)r * 2 * num_timed + 2 * i] -= offsets[r];
+            stamps[(size_t)r * 2 * num_timed + 2 * i + 1] -= offsets[r];
+            t = stamps[(size_t)r * 2 * num_timed + 2 * i];
+            first_in = (0 == r || t < first_in) ? t : first_in;
+            last_in = (0 == r || t > last_in) ? t : last_in;
+            t = stamps[(size_t)r * 2 * num_timed + 2 * i + 1];
+            first_out = (0 == r || t < first_out) ? t : first_out;
+            last_out = (0 == r || t > last_out) ? t : last_out;
+        }
+        for(r = 0; r < world_size; ++r) {
+            late_in[r] += (stamps[(size_t)r * 2 * num_timed + 2 * i] - first_in) / num_timed;
+            late_out[r] += (stamps[(size_t)r * 2 * num_timed + 2 * i + 1] - first_out) / num_timed;
+        }
+        sum_arrival += last_in - first_in;
+        sum_completion += last_out - first_out;
+        timer->g_skew_arrival = (last_in - first_in > timer->g_skew_arrival) ? last_in - first_in : timer->g_skew_arrival;
+        timer->g_skew_completion = (last_out - first_out > timer->g_skew_completion) ? last_out - first_out : timer->g_skew_completion;
+    }
+
+    printf("Skew: arrival max %12.6f s / avg %12.6f s : completion max %12.6f s / avg %12.6f s (clock error %.6f s)\n",
+           timer->g_skew_arrival, sum_arrival / num_timed,
+           timer->g_skew_completion, sum_completion / num_timed, error);
+    // Slowest ranks: latest to complete on average
+    printf("Skew: slowest ranks (late to complete / late to arrive):");
+    for(k = 0; k < skew_top && k < world_size; ++k) {
+        slowest = -1;
+        for(r = 0; r < world_size; ++r) {
+            if( !listed[r] && (slowest < 0 || late_out[r] > late_out[slowest]) ) {
+                slowest = r;
+            }
+        }
+        listed[slowest] = true;
+        printf("%s rank %d %.6f s / %.6f s", (0 == k) ? "" : ",", slowest, late_out[slowest], late_in[slowest]);
+    }
+    printf("\n");
+
+    free(offsets);
+    free(stamps);
+    free(late_in);
+    free(late_out);
+    free(listed);
+}
+
+/*
+ * Display the per-rank min/avg/max time and effective bandwidth.
+ * Note: Must be called by all processes (uses MPI_Reduce)
+ *
+ * @param timer timer state
+ * @param bytes payload size (in bytes) at rank 0 used to compute bandwidth
+ */
+static inline void timer_report(coll_timer_t *timer, size_t bytes)
+{
+    double local_avg = timer_avg(timer);
+    double sum_time = 0.0;
+
+    if( memtrack_enabled ) {
+        memtrack_report(timer);
+    }
+    if( NULL != timer->skew_stamps ) {
+        skew_report(timer);
+    }
+
+    if( !timing_enabled && NULL == results_filename && !sweep_enabled && 0 == num_strides &&
+        !timer->overlap && !allow_reference ) {
+        return;
+    }
+
+    // Min/Max of the per-rank average iteration time, and mean across ranks
+    MPI_Reduce(&local_avg, &timer->g_min, 1, MPI_DOUBLE, MPI_MIN, 0, test_comm);
+    MPI_Reduce(&local_avg, &timer->g_max, 1, MPI_DOUBLE, MPI_MAX, 0, test_comm);
+    MPI_Reduce(&local_avg, &sum_time, 1, MPI_DOUBLE, MPI_SUM, 0, test_comm);
+    timer->g_avg = sum_time / world_size;
+    if( COLL_PERSISTENT == timer->variant ) {
+        MPI_Reduce(&timer->t_setup, &timer->g_setup, 1, MPI_DOUBLE, MPI_MAX, 0, test_comm);
+    }
+    if( timer->overlap ) {
+        int num_timed = timer->num_iters - timer->num_warmup;
+        double local_compute = timer->t_compute_sum / num_timed;
+        double local_overlap = timer->overlap_sum / num_timed;
+        MPI_Reduce(&timer->t_comm, &timer->g_comm, 1, MPI_DOUBLE, MPI_MAX, 0, test_comm);
+        MPI_Reduce(&local_compute, &timer->g_compute, 1, MPI_DOUBLE, MPI_MAX, 0, test_comm);
+        MPI_Reduce(&local_overlap, &timer->g_overlap_min, 1, MPI_DOUBLE, MPI_MIN, 0, test_comm);
+        MPI_Reduce(&local_overlap, &sum_time, 1, MPI_DOUBLE, MPI_SUM, 0, test_comm);
+        timer->g_overlap = sum_time / world_size;
+        if( 0 == world_rank ) {
+            printf("Overlap: comm alone %12.6f s / compute %12.6f s / total %12.6f s : overlap min %5.1f %% / avg %5.1f %%\n",
+                   timer->g_comm, timer->g_compute, timer->g_max,
+                   timer->g_overlap_min * 100.0, timer->g_overlap * 100.0);
+        }
+    }
+
+    if( timing_enabled && 0 == world_rank ) {
+        printf("Timing: %3d iters (+%d warmup) : min %12.6f s / avg %12.6f s / max %12.6f s : %10.3f GB/s\n",
+               timer->num_iters - timer->num_warmup, timer->num_warmup,
+               timer->g_min, timer->g_avg, timer->g_max, timer_bandwidth(timer, bytes));
+        if( COLL_PERSISTENT == timer->variant ) {
+            printf("Timing: persistent request setup : max %12.6f s\n", timer->g_setup);
+        }
+        if( roofline_gbs > 0.0 ) {
+            printf("Roofline: %10.3f GB/s of %10.3f GB/s per rank (%d per node) : %5.1f %%\n",
+                   timer_bandwidth(timer, bytes), roofline_gbs / ((local_size > 0) ? local_size : 1),
+                   local_size, timer_roofline(timer, bytes));
+        }
+    }
+    if( allow_reference && 0 == world_rank ) {
+        native_time_t *entry = native_find(native_case);
+        if( COLL_BLOCKING == timer->variant ) {
+            // A rerun of the same case replaces its time
+            if( NULL == entry ) {
+                entry = &native_times[native_next];
+                native_next = (native_next + 1) % MAX_NATIVE_TIMES;
+                snprintf(entry->key, sizeof(entry->key), "%s", native_case);
+            }
+            entry->time = timer->g_max;
+        } else if( COLL_REFERENCE == timer->variant && NULL != entry ) {
+            // > 1.0 when the native collective is faster than the chunked one
+            printf("Reference: native %12.6f s / chunked %12.6f s : chunked/native ratio %8.3f\n",
+                   entry->time, timer->g_max, (entry->time > 0.0) ? timer->g_max / entry->time : 0.0);
+            entry->key[0] = '\0';
+        }
+    }
+    last_timer = *timer;
+}
+
+/*
+ * String representation of the 'v' collective mode
+ *
+ * @param mode MODE_PACKED, MODE_SKIP or 0 if not a 'v' collective
+ * @return static string
+ */
+static inline const char * mode_name(int mode)
+{
+    if( MODE_PACKED == mode ) {
+        return "PACKED";
+    } else if( MODE_SKIP == mode ) {
+        return "SKIP";
+    }
+    return "NONE";
+}
+
+/*
+ * String representation of the collective variant
+ *
+ * @param variant COLL_BLOCKING, COLL_NONBLOCKING, COLL_PERSISTENT or COLL_REFERENCE
+ * @return static string
+ */
+static inline const char * variant_name(int variant)
+{
+    if( COLL_BLOCKING == variant ) {
+        return "blocking";
+    } else if( COLL_NONBLOCKING == variant ) {
+        return "nonblocking";
+    } else if( COLL_PERSISTENT == variant ) {
+        return "persistent";
+    }
+    return "reference";
+}
+
+/*
+ * Check whether a collective variant is enabled
+ * (see BIGCOUNT_ENABLE_NONBLOCKING, BIGCOUNT_ENABLE_PERSISTENT and BIGCOUNT_REFERENCE)
+ *
+ * @param variant COLL_BLOCKING, COLL_NONBLOCKING, COLL_PERSISTENT or COLL_REFERENCE
+ * @return true if the tests should run this variant
+ */
+static inline bool variant_enabled(int variant)
+{
+    if( COLL_NONBLOCKING == variant ) {
+        return allow_nonblocked;
+    } else if( COLL_PERSISTENT == variant ) {
+        return allow_persistent;
+    } else if( COLL_REFERENCE == variant ) {
+        return allow_reference;
     }
+    return true;
+}
 
-    mem_percent = strtol(mem_percent_str, &endp, 10);
-    if ('\0' != *endp) {
-        fprintf(stderr, "BIGCOUNT_MEMORY_PERCENT is not numeric\n");
-        exit(1);
+/*
+ * Running test case in the progress journal (see journal_start)
+ *  - journal_case    : case of the running test ('\0' if none)
+ *  - journal_skipped : the last test case was skipped (completed by a previous run)
+ */
+char journal_case[512] = "";
+bool journal_skipped = false;
+
+/*
+ * Append a record of the running test case to the progress journal, and
+ * flush it to the disk so that it survives the process being killed
+ * Note: Called by rank 0 of test_comm
+ *
+ * @param record 'start' or 'done'
+ * @param result result of a 'done' record ('passed' or 'failed'), NULL otherwise
+ */
+static void journal_write(const char *record, const char *result)
+{
+    FILE *journal_file = fopen(journal_filename, "a");
+
+    if( NULL == journal_file ) {
+        fprintf(stderr, "Unable to open journal file %s: %s\n", journal_filename, strerror(errno));
+        return;
     }
+    fprintf(journal_file, "%s %s %s%s%s\n", record, journal_run, journal_case,
+            (NULL != result) ? " " : "", (NULL != result) ? result : "");
+    fflush(journal_file);
+    fsync(fileno(journal_file));
+    fclose(journal_file);
+}
 
-    meminfo_file = fopen("/proc/meminfo", "r");
-    if (NULL == meminfo_file) {
-        fprintf(stderr, "Unable to open /proc/meminfo file: %s\n", strerror(errno));
-        exit(1);
+/*
+ * Set the running test case of the native/reference comparison (native_case)
+ *
+ * @param dtype datatype used in the collective
+ * @param count total number of elements in the test case
+ * @param mode MODE_PACKED, MODE_SKIP or 0 if not a 'v' collective
+ * @param in_place true if MPI_IN_PLACE is used
+ */
+static inline void native_case_set(MPI_Datatype dtype, size_t count, int mode, bool in_place)
+{
+    snprintf(native_case, sizeof(native_case), "%s %s %s %s %s %s %d %d %zu",
+             test_name, comm_shape_name, (NULL != test_topo) ? test_topo->name : "-",
+             (NULL != test_op) ? test_op->key : "-", find_test_type(dtype)->key,
+             mode_name(mode), in_place ? 1 : 0, (MODE_SKIP == mode) ? disp_stride : 0, count);
+}
+
+/*
+ * Check the progress journal before a test case (BIGCOUNT_JOURNAL)
+ * A case completed by a previous run is skipped. The count of a case that
+ * previous runs started but did not complete (e.g., the OOM killer stopped
+ * them) is lowered by journal_shrink for each of these runs. Rank 0 records
+ * the start of the cases that run, which also set native_case.
+ * Note: Must be called by all processes, before allocating the buffers
+ *
+ * @param dtype datatype used in the collective
+ * @param count (IN/OUT) total number of elements in the test case (lowered
+ *              if it did not complete before)
+ * @param mode MODE_PACKED, MODE_SKIP or 0 if not a 'v' collective
+ * @param in_place true if MPI_IN_PLACE is used
+ * @param variant COLL_BLOCKING, COLL_NONBLOCKING, COLL_PERSISTENT or COLL_REFERENCE
+ * @param ret (OUT) result of a skipped case: 0 if it passed, 1 if it failed
+ * @return true if the test case is skipped
+ */
+static inline bool journal_start(MPI_Datatype dtype, size_t *count, int mode,
+                                 bool in_place, int variant, int *ret)
+{
+    const journal_entry_t *entry;
+    size_t lowered;
+    int i;
+
+    journal_case[0] = '\0';
+    journal_skipped = false;
+    if( NULL == journal_filename ) {
+        native_case_set(dtype, *count, mode, in_place);
+        return false;
     }
 
-    bufsize = 0;
-    proc_data = NULL;
-    mem_to_use = 0;
-    rc = getline(&proc_data, &bufsize, meminfo_file);
-    while (rc > 0) {
-        token = strtok(proc_data, " ");
-        if (NULL != token) {
-            if (!strcmp(token, "MemTotal:")) {
-                token = strtok(NULL, " ");
-                total_sys_mem_gb = strtol(token, NULL, 10);
-                total_sys_mem_gb = (int)(total_sys_mem_gb / 1048576.0);
-                /* /proc/meminfo specifies memory in KBytes, convert to GBytes */
-                mem_to_use = (int)(total_sys_mem_gb * (mem_percent / 100.0));
-                break;
-             }
+    snprintf(journal_case, sizeof(journal_case), "%s %s %s %s %s %s %s %d %d %zu",
+             test_name, comm_shape_name, (NULL != test_topo) ? test_topo->name : "-",
+             (NULL != test_op) ? test_op->key : "-", find_test_type(dtype)->key,
+             variant_name(variant), mode_name(mode), in_place ? 1 : 0,
+             (MODE_SKIP == mode) ? disp_stride : 0, *count);
+    entry = journal_find(journal_case, false);
+
+    if( NULL != entry && entry->done ) {
+        if( 0 == world_rank ) {
+            printf("---------------------\nJournal: Skipping completed case (%s): %s\n",
+                   entry->passed ? "passed" : "failed", journal_case);
         }
-        rc = getline(&proc_data, &bufsize, meminfo_file);
+        journal_case[0] = '\0';
+        journal_skipped = true;
+        *ret = entry->passed ? 0 : 1;
+        return true;
     }
 
-    if (0 == mem_to_use) {
-        fprintf(stderr, "Unable to determine memory to use\n");
-        exit(1);
+    if( NULL != entry && entry->starts > 0 ) {
+        lowered = *count;
+        for(i = 0; i < entry->starts; ++i) {
+            lowered = (size_t)(lowered * journal_shrink);
+        }
+        if( lowered < (size_t)world_size ) {
+            lowered = (*count < (size_t)world_size) ? *count : (size_t)world_size;
+        }
+        if( 0 == world_rank ) {
+            printf("---------------------\nJournal: Case did not complete in %d run%s, lowering the count from %zu to %zu: %s\n",
+                   entry->starts, (1 == entry->starts) ? "" : "s", *count, lowered, journal_case);
+        }
+        *count = lowered;
     }
 
-    free(proc_data);
-    fclose(meminfo_file);
-    return mem_to_use;
+    if( 0 == world_rank ) {
+        journal_write("start", NULL);
+    }
+    native_case_set(dtype, *count, mode, in_place);
+    return false;
 }
 
 /*
- * Display a diagnostic table
+ * Aggregate the result of one test case at rank 0 and append it to the
+ * results file (if BIGCOUNT_RESULTS_FILE is set), and record its completion
+ * in the progress journal (if BIGCOUNT_JOURNAL is set).
+ * Note: Must be called by all processes (uses MPI_Reduce)
+ *
+ * @param mpi_function name of the collective
+ * @param dtype datatype used in the collective
+ * @param count total number of elements in the test case
+ * @param bytes payload size (in bytes) at rank 0
+ * @param variant COLL_BLOCKING, COLL_NONBLOCKING, COLL_PERSISTENT or COLL_REFERENCE
+ * @param mode MODE_PACKED, MODE_SKIP or 0 if not a 'v' collective
+ * @param in_place true if MPI_IN_PLACE was used
+ * @param num_wrong number of incorrect elements on this rank
+ * @param timer timer state (after timer_report)
  */
-static inline void display_diagnostics(void) {
-    printf("----------------------:-----------------------------------------\n");
-    printf("Total Memory Avail.   : %4d GB\n", total_sys_mem_gb);
-    printf("Percent memory to use : %4d %%\n", mem_percent);
-    printf("Tolerate diff.        : %4d GB\n", mem_diff_tolerance);
-    printf("Max memory to use     : %4d GB\n", max_sys_mem_gb);
-    printf("----------------------:-----------------------------------------\n");
-    printf("INT_MAX               : %20zu\n", (size_t)INT_MAX);
-    printf("UINT_MAX              : %20zu\n", (size_t)UINT_MAX);
-    printf("SIZE_MAX              : %20zu\n", (size_t)SIZE_MAX);
-    printf("----------------------:-----------------------------------------\n");
-    printf("                      : Count x Datatype size      = Total Bytes\n");
-#ifndef TEST_UNIFORM_COUNT
-    printf("TEST_PAYLOAD_SIZE     : %20zu       = %10s\n", (size_t)TEST_PAYLOAD_SIZE, human_bytes((size_t)TEST_PAYLOAD_SIZE));
-#else
-    printf("TEST_UNIFORM_COUNT    : %20zu\n", (size_t)TEST_UNIFORM_COUNT);
-#endif
-    printf("V_SIZE_DOUBLE_COMPLEX : %20zu x %3zu = %10s\n", (size_t)V_SIZE_DOUBLE_COMPLEX, sizeof(double _Complex), human_bytes(V_SIZE_DOUBLE_COMPLEX * sizeof(double _Complex)));
-    printf("V_SIZE_DOUBLE         : %20zu x %3zu = %10s\n", (size_t)V_SIZE_DOUBLE, sizeof(double), human_bytes(V_SIZE_DOUBLE * sizeof(double)));
-    printf("V_SIZE_FLOAT_COMPLEX  : %20zu x %3zu = %10s\n", (size_t)V_SIZE_FLOAT_COMPLEX, sizeof(float _Complex), human_bytes(V_SIZE_FLOAT_COMPLEX * sizeof(float _Complex)));
-    printf("V_SIZE_FLOAT          : %20zu x %3zu = %10s\n", (size_t)V_SIZE_FLOAT, sizeof(float), human_bytes(V_SIZE_FLOAT * sizeof(float)));
-    printf("V_SIZE_INT            : %20zu x %3zu = %10s\n", (size_t)V_SIZE_INT, sizeof(int), human_bytes(V_SIZE_INT * sizeof(int)));
-    printf("----------------------:-----------------------------------------\n");
+static inline void record_result(const char *mpi_function, MPI_Datatype dtype,
+                                 size_t count, size_t bytes, int variant,
+                                 int mode, bool in_place, size_t num_wrong,
+                                 coll_timer_t *timer)
+{
+    unsigned long long local_wrong = num_wrong, total_wrong = 0;
+    int local_failed = (0 != num_wrong) ? 1 : 0, failed_ranks = 0;
+    char dtype_name[MPI_MAX_OBJECT_NAME];
+    FILE *results_file = NULL;
+    int len;
+
+    if( NULL == results_filename && '\0' == journal_case[0] ) {
+        return;
+    }
+
+    MPI_Reduce(&local_wrong, &total_wrong, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, test_comm);
+    MPI_Reduce(&local_failed, &failed_ranks, 1, MPI_INT, MPI_SUM, 0, test_comm);
+
+    if( 0 != world_rank ) {
+        return;
+    }
+
+    if( '\0' != journal_case[0] ) {
+        journal_write("done", (0 == failed_ranks) ? "passed" : "failed");
+    }
+    if( NULL == results_filename ) {
+        return;
+    }
+
+    MPI_Type_get_name(dtype, dtype_name, &len);
+
+    results_file = fopen(results_filename, "a");
+    if( NULL == results_file ) {
+        fprintf(stderr, "Unable to open results file %s: %s\n", results_filename, strerror(errno));
+        return;
+    }
+
+    if( results_csv ) {
+        if( 0 == ftell(results_file) ) {
+            fprintf(results_file, "test,collective,datatype,count,bytes,blocking,mode,in_place,"
+                    "np,passed,num_wrong,failed_ranks,count_adjust_perc,"
+                    "iterations,warmup,time_min,time_avg,time_max,bandwidth_gbs,variant,time_setup,"
+                    "overlap_ratio,comm,op,mem_temp_max,mem_inflation_max,topology,disp_stride,"
+                    "skew_arrival_max,skew_completion_max,roofline_perc\n");
+        }
+        fprintf(results_file, "%s,%s,%s,%zu,%zu,%d,%s,%d,%d,%d,%llu,%d,%.2f,%d,%d,%.9f,%.9f,%.9f,%.6f,%s,%.9f,%.4f,%s,%s,%.0f,%.4f,%s,%d,%.9f,%.9f,%.2f\n",
+                test_name, mpi_function, dtype_name, count, bytes, (COLL_BLOCKING == variant) ? 1 : 0,
+                mode_name(mode), in_place ? 1 : 0, world_size,
+                (0 == total_wrong) ? 1 : 0, total_wrong, failed_ranks, count_adjust_perc,
+                timer->num_iters - timer->num_warmup, timer->num_warmup,
+                timer->g_min, timer->g_avg, timer->g_max, timer_bandwidth(timer, bytes),
+                variant_name(variant), timer->g_setup, timer->g_overlap, comm_shape_name,
+                (NULL != test_op) ? test_op->key : "", timer->g_mem_temp, timer->g_mem_inflation,
+                (NULL != test_topo) ? test_topo->name : "", (MODE_SKIP == mode) ? disp_stride : 0,
+                timer->g_skew_arrival, timer->g_skew_completion, timer_roofline(timer, bytes));
+    } else {
+        fprintf(results_file, "{\"test\": \"%s\", \"collective\": \"%s\", \"datatype\": \"%s\", "
+                "\"count\": %zu, \"bytes\": %zu, \"blocking\": %s, \"mode\": \"%s\", \"in_place\": %s, "
+                "\"np\": %d, \"passed\": %s, \"num_wrong\": %llu, \"failed_ranks\": %d, "
+                "\"count_adjust_perc\": %.2f, \"iterations\": %d, \"warmup\": %d, "
+                "\"time_min\": %.9f, \"time_avg\": %.9f, \"time_max\": %.9f, \"bandwidth_gbs\": %.6f, "
+                "\"variant\": \"%s\", \"time_setup\": %.9f, \"overlap_ratio\": %.4f, \"comm\": \"%s\", \"op\": \"%s\", "
+                "\"mem_temp_max\": %.0f, \"mem_inflation_max\": %.4f, \"topology\": \"%s\", \"disp_stride\": %d, "
+                "\"skew_arrival_max\": %.9f, \"skew_completion_max\": %.9f, \"roofline_perc\": %.2f}\n",
+                test_name, mpi_function, dtype_name, count, bytes, (COLL_BLOCKING == variant) ? "true" : "false",
+                mode_name(mode), in_place ? "true" : "false", world_size,
+                (0 == total_wrong) ? "true" : "false", total_wrong, failed_ranks, count_adjust_perc,
+                timer->num_iters - timer->num_warmup, timer->num_warmup,
+                timer->g_min, timer->g_avg, timer->g_max, timer_bandwidth(timer, bytes),
+                variant_name(variant), timer->g_setup, timer->g_overlap, comm_shape_name,
+                (NULL != test_op) ? test_op->key : "", timer->g_mem_temp, timer->g_mem_inflation,
+                (NULL != test_topo) ? test_topo->name : "", (MODE_SKIP == mode) ? disp_stride : 0,
+                timer->g_skew_arrival, timer->g_skew_completion, timer_roofline(timer, bytes));
+    }
+
+    fclose(results_file);
 }
 
 /*
- * Initialize the unit testing environment
- * Note: Must be called after MPI_Init()
+ * Run one test case of the sweep
  *
- * @param argc Argument count
- * @param argv Array of string arguments
+ * @param dtype datatype to use in the collective
+ * @param total_num_elements count as passed to my_c_test_core (largest buffer)
+ * @param variant COLL_BLOCKING, COLL_NONBLOCKING, COLL_PERSISTENT or COLL_REFERENCE
  * @return 0 on success
  */
-int init_environment(int argc, char** argv) {
-    max_sys_mem_gb = get_max_memory();
+typedef int (*sweep_case_fn_t)(MPI_Datatype dtype, size_t total_num_elements, int variant);
 
-#ifdef MPI_VERSION
-    int i;
-    int *per_local_sizes = NULL;
-    int *local_max_mem = NULL;
-    char *mem_diff_tolerance_str = NULL;
-    char *env_str = NULL;
-    int min_mem = 0;
+#define MAX_SWEEP_POINTS 256
 
-    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
-    MPI_Get_processor_name(my_hostname, &i);
+enum {
+      SWEEP_PASSED       = 0,
+      SWEEP_FAILED       = 1,
+      SWEEP_SKIP_COUNT   = 2,
+      SWEEP_SKIP_MEM     = 3,
+      SWEEP_SKIP_JOURNAL = 4
+};
 
-    if( NULL != getenv("OMPI_COMM_WORLD_LOCAL_SIZE") ) {
-        local_size = (int)strtol(getenv("OMPI_COMM_WORLD_LOCAL_SIZE"), NULL, 10);
-    } else {
-        local_size = world_size;
-    }
+static int compare_size_t(const void *a, const void *b)
+{
+    size_t x = *(const size_t*)a, y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
 
-    if( NULL != (env_str = getenv("BIGCOUNT_ENABLE_NONBLOCKING")) ) {
-        if( 'y' == env_str[0] || 'Y' == env_str[0] || '1' == env_str[0] ) {
-            allow_nonblocked = true;
-        } else {
-            allow_nonblocked = false;
+/*
+ * Sweep mode: run the collective over the payload sizes of the sweep
+ * (see BIGCOUNT_SWEEP) and display a summary of the latency and bandwidth at
+ * each size. The payload is the size of the largest buffer (as reported in the
+ * 'Results from' line).
+ * Payloads whose count exceeds TEST_COUNT_MAX (INT_MAX unless built with
+ * TEST_BIGCOUNT_API), or that do not fit in memory, are skipped.
+ *
+ * @param coll name of the collective (memory model, see calc_coll_count)
+ * @param count_mult the count is rounded down to a multiple of this value
+ *                   (number of processes if the payload is split across processes)
+ * @param sweep_case function running one test case
+ * @return number of failed test cases
+ */
+int run_sweep(const char *coll, size_t count_mult, sweep_case_fn_t sweep_case)
+{
+    MPI_Datatype dtype = test_types[sweep_type].dtype;
+    size_t dt_size = test_types[sweep_type].size;
+    size_t boundaries[] = { (size_t)INT_MAX - 1, (size_t)INT_MAX, (size_t)INT_MAX + 1,
+                            (size_t)UINT_MAX - 1, (size_t)UINT_MAX, (size_t)UINT_MAX + 1,
+                            (size_t)1 << 33 };
+    size_t sizes[MAX_SWEEP_POINTS];
+    size_t counts[MAX_SWEEP_POINTS];
+    int status[MAX_SWEEP_POINTS][NUM_COLL_VARIANTS];
+    double times[MAX_SWEEP_POINTS][NUM_COLL_VARIANTS];
+    int num_sizes = 0, i, b;
+    size_t bytes, next, count, prev_count = 0, max_count;
+    int local_ret, global_ret, ret = 0;
+
+    for( bytes = sweep_min; bytes <= sweep_max && num_sizes < MAX_SWEEP_POINTS; bytes = next ) {
+        sizes[num_sizes++] = bytes;
+        next = (size_t)(bytes * sweep_factor);
+        if( next <= bytes ) {
+            next = bytes + 1;
         }
     }
-
-    if( NULL != (env_str = getenv("BIGCOUNT_ALG_INFLATION")) ) {
-        alg_inflation = strtod(env_str, NULL);
+    for( i = 0; i < (int)(sizeof(boundaries) / sizeof(size_t)) && num_sizes < MAX_SWEEP_POINTS; ++i ) {
+        if( boundaries[i] <= sweep_max ) {
+            sizes[num_sizes++] = boundaries[i];
+        }
     }
+    qsort(sizes, num_sizes, sizeof(size_t), compare_size_t);
 
-    // Make sure that the local size is uniform
-    if( 0 == world_rank ) {
-        per_local_sizes = (int*)safe_malloc(sizeof(int) * world_size);
-    }
+    max_count = coll_max_count(coll, dt_size) * count_mult;
 
-    MPI_Gather(&local_size, 1, MPI_INT, per_local_sizes, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    if( 0 == world_rank ) {
-        for(i = 0; i < world_size; ++i) {
-            if( local_size != per_local_sizes[i] ) {
-                printf("Error: Non-uniform local size at peer %d : actual %d vs expected %d\n",
-                       i, per_local_sizes[i], local_size);
-                assert(local_size == per_local_sizes[i]);
+    for( i = 0; i < num_sizes; ++i ) {
+        count = sizes[i] / dt_size;
+        count -= count % count_mult;
+        counts[i] = count;
+        for( b = 0; b < NUM_COLL_VARIANTS; ++b ) {
+            status[i][b] = -1;
+        }
+        if( 0 == count || count == prev_count ) {
+            continue;
+        }
+        prev_count = count;
+
+        if( count > TEST_COUNT_MAX ) {
+            status[i][0] = SWEEP_SKIP_COUNT;
+            continue;
+        } else if( count > max_count ) {
+            status[i][0] = SWEEP_SKIP_MEM;
+            continue;
+        }
+
+        for( b = 0; b < NUM_COLL_VARIANTS; ++b ) {
+            if( !variant_enabled(b) ) {
+                continue;
             }
+            local_ret = sweep_case(dtype, count, b);
+            MPI_Allreduce(&local_ret, &global_ret, 1, MPI_INT, MPI_MAX, test_comm);
+            status[i][b] = journal_skipped ? SWEEP_SKIP_JOURNAL :
+                           (0 == global_ret) ? SWEEP_PASSED : SWEEP_FAILED;
+            times[i][b] = last_timer.g_max;
+            ret += local_ret;
         }
-        free(per_local_sizes);
     }
-    // Make sure max memory usage is the same for all tasks
+
     if( 0 == world_rank ) {
-        local_max_mem = (int*)safe_malloc(sizeof(int) * world_size);
+        printf("---------------------\nSweep summary for %s (%s), %d processes:\n", coll,
+               test_types[sweep_type].name, world_size);
+        printf("%20s %14s %11s %14s %12s  %s\n",
+               "Payload (bytes)", "Count", "Variant", "Time (s)", "GB/s", "Result");
+        for( i = 0; i < num_sizes; ++i ) {
+            if( SWEEP_SKIP_COUNT == status[i][0] ) {
+                printf("%20zu %14zu %11s %14s %12s  %s\n", sizes[i], counts[i], "-", "-", "-",
+                       "SKIPPED (count too large, see TEST_BIGCOUNT_API)");
+                continue;
+            } else if( SWEEP_SKIP_MEM == status[i][0] ) {
+                printf("%20zu %14zu %11s %14s %12s  %s\n", sizes[i], counts[i], "-", "-", "-",
+                       "SKIPPED (exceeds memory limit)");
+                continue;
+            }
+            for( b = 0; b < NUM_COLL_VARIANTS; ++b ) {
+                if( status[i][b] < 0 ) {
+                    continue;
+                } else if( SWEEP_SKIP_JOURNAL == status[i][b] ) {
+                    printf("%20zu %14zu %11s %14s %12s  %s\n", sizes[i], counts[i], variant_name(b),
+                           "-", "-", "SKIPPED (completed, see BIGCOUNT_JOURNAL)");
+                    continue;
+                }
+                bytes = counts[i] * dt_size;
+                printf("%20zu %14zu %11s %14.6f %12.3f  %s\n", sizes[i], counts[i],
+                       variant_name(b), times[i][b],
+                       (times[i][b] > 0.0) ? (bytes / times[i][b]) / ((size_t)1024 * 1024 * 1024) : 0.0,
+                       (SWEEP_PASSED == status[i][b]) ? "PASSED" : "FAILED");
+            }
+        }
+        printf("---------------------\n");
     }
+    fflush(NULL);
 
-    mem_diff_tolerance_str = getenv("BIGCOUNT_MEMORY_DIFF");
-    if (NULL != mem_diff_tolerance_str) {
-        mem_diff_tolerance = strtol(mem_diff_tolerance_str, NULL, 10);
+    return ret;
+}
+
+/*
+ * Run one test case of the stride sweep
+ *
+ * @param dtype datatype to use in the collective
+ * @param total_num_elements count as passed to my_c_test_core (MODE_SKIP adds
+ *                           disp_stride elements per process)
+ * @param mode MODE_PACKED or MODE_SKIP
+ * @param in_place true to use MPI_IN_PLACE
+ * @param variant COLL_BLOCKING, COLL_NONBLOCKING, COLL_PERSISTENT or COLL_REFERENCE
+ * @return 0 on success
+ */
+typedef int (*stride_case_fn_t)(MPI_Datatype dtype, size_t total_num_elements, int mode,
+                                bool in_place, int variant);
+
+/*
+ * Stride sweep mode: run a 'v' collective with each displacement stride of
+ * BIGCOUNT_STRIDES, out of place and in place, and display a summary of the
+ * latency and bandwidth of each case. The count of each case is reduced by
+ * the gaps (stride x number of processes) so that the buffers keep the size
+ * of the packed case.
+ *
+ * @param coll name of the collective
+ * @param count packed count of the sweep datatype (as passed to my_c_test_core)
+ * @param stride_case function running one test case
+ * @return number of failed test cases
+ */
+int run_stride_sweep(const char *coll, size_t count, stride_case_fn_t stride_case)
+{
+    MPI_Datatype dtype = test_types[sweep_type].dtype;
+    size_t dt_size = test_types[sweep_type].size;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t elems[MAX_STRIDES];
+    int status[MAX_STRIDES][2][NUM_COLL_VARIANTS];
+    double times[MAX_STRIDES][2][NUM_COLL_VARIANTS];
+    int saved_stride = disp_stride;
+    int local_ret, global_ret, ret = 0, i, p, b;
+    size_t gaps, bytes;
+
+    for( i = 0; i < num_strides; ++i ) {
+        elems[i] = stride_in_pages[i] ? (strides[i] * page_size + dt_size - 1) / dt_size : strides[i];
+        gaps = elems[i] * (size_t)world_size;
+        for( p = 0; p < 2; ++p ) {
+            for( b = 0; b < NUM_COLL_VARIANTS; ++b ) {
+                status[i][p][b] = -1;
+            }
+        }
+        if( elems[i] > INT_MAX || gaps >= count ) {
+            status[i][0][0] = SWEEP_SKIP_COUNT;
+            continue;
+        }
+        disp_stride = (int)elems[i];
+        for( p = 0; p < 2; ++p ) {
+            for( b = 0; b < NUM_COLL_VARIANTS; ++b ) {
+                if( !variant_enabled(b) ) {
+                    continue;
+                }
+                local_ret = stride_case(dtype, count - gaps, (0 == elems[i]) ? MODE_PACKED : MODE_SKIP,
+                                        (1 == p), b);
+                MPI_Allreduce(&local_ret, &global_ret, 1, MPI_INT, MPI_MAX, test_comm);
+                status[i][p][b] = journal_skipped ? SWEEP_SKIP_JOURNAL :
+                                  (0 == global_ret) ? SWEEP_PASSED : SWEEP_FAILED;
+                times[i][p][b] = last_timer.g_max;
+                ret += local_ret;
+            }
+        }
     }
+    disp_stride = saved_stride;
 
-    MPI_Gather(&max_sys_mem_gb, 1, MPI_INT, local_max_mem, 1, MPI_INT, 0, MPI_COMM_WORLD);
     if( 0 == world_rank ) {
-        min_mem = max_sys_mem_gb;
-        for(i = 0; i < world_size; ++i) {
-            if( max_sys_mem_gb != local_max_mem[i] ) {
-                if( (max_sys_mem_gb < local_max_mem[i] && max_sys_mem_gb + mem_diff_tolerance < local_max_mem[i]) ||
-                    (max_sys_mem_gb > local_max_mem[i] && max_sys_mem_gb > mem_diff_tolerance + local_max_mem[i]) ) {
-                    printf("Error: Non-uniform max memory usage at peer %d : actual %d vs expected %d (+/- %d)\n",
-                           i, local_max_mem[i], max_sys_mem_gb, mem_diff_tolerance);
-                    assert(max_sys_mem_gb == local_max_mem[i]);
-                }
-                if( min_mem > local_max_mem[i] ) {
-                    min_mem = local_max_mem[i];
+        printf("---------------------\nStride sweep summary for %s (%s x %zu), %d processes:\n", coll,
+               test_types[sweep_type].name, count, world_size);
+        printf("%17s %14s %8s %11s %14s %12s  %s\n",
+               "Stride (elements)", "Stride (bytes)", "In place", "Variant", "Time (s)", "GB/s", "Result");
+        for( i = 0; i < num_strides; ++i ) {
+            if( SWEEP_SKIP_COUNT == status[i][0][0] ) {
+                printf("%17zu %14zu %8s %11s %14s %12s  %s\n", elems[i], elems[i] * dt_size,
+                       "-", "-", "-", "-", "SKIPPED (gaps exceed the payload)");
+                continue;
+            }
+            bytes = (count - elems[i] * (size_t)world_size) * dt_size;
+            for( p = 0; p < 2; ++p ) {
+                for( b = 0; b < NUM_COLL_VARIANTS; ++b ) {
+                    if( status[i][p][b] < 0 ) {
+                        continue;
+                    } else if( SWEEP_SKIP_JOURNAL == status[i][p][b] ) {
+                        printf("%17zu %14zu %8s %11s %14s %12s  %s\n", elems[i], elems[i] * dt_size,
+                               (1 == p) ? "yes" : "no", variant_name(b), "-", "-",
+                               "SKIPPED (completed, see BIGCOUNT_JOURNAL)");
+                        continue;
+                    }
+                    printf("%17zu %14zu %8s %11s %14.6f %12.3f  %s\n", elems[i], elems[i] * dt_size,
+                           (1 == p) ? "yes" : "no", variant_name(b), times[i][p][b],
+                           (times[i][p][b] > 0.0) ? (bytes / times[i][p][b]) / ((size_t)1024 * 1024 * 1024) : 0.0,
+                           (SWEEP_PASSED == status[i][p][b]) ? "PASSED" : "FAILED");
                 }
             }
         }
-        free(local_max_mem);
-        if( min_mem != max_sys_mem_gb ) {
-            printf("Warning: Detected difference between local and remote available memory. Adjusting to: %d GB\n",
-                   min_mem);
-            max_sys_mem_gb = min_mem;
-        }
+        printf("---------------------\n");
     }
+    fflush(NULL);
+
+    return ret;
+}
+
+/*
+ * Run the tests on one communicator shape. All the communicators of the shape
+ * run at the same time (e.g., one per node). Processes that are not part of
+ * the shape (MPI_COMM_NULL) wait for the others.
+ *
+ * @param name name of the shape (e.g., "split4")
+ * @param comm communicator of this process in the shape, or MPI_COMM_NULL
+ * @param run_tests function running all the test cases on test_comm
+ * @return 0 on success
+ */
+static int run_comm_shape(const char *name, MPI_Comm comm, int (*run_tests)(void))
+{
+    int all_size, all_rank, is_first = 0, num_comms = 0, ret = 0;
 
-    // Agree on the max memory usage value to use across all processes
-    MPI_Bcast(&max_sys_mem_gb, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Comm_size(MPI_COMM_WORLD, &all_size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &all_rank);
 
+    if( MPI_COMM_NULL != comm ) {
+        MPI_Comm_size(comm, &world_size);
+        MPI_Comm_rank(comm, &world_rank);
+        is_first = (0 == world_rank) ? 1 : 0;
+    }
+    MPI_Allreduce(&is_first, &num_comms, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if( 0 == all_rank && SHAPE_WORLD != comm_shapes ) {
+        printf("=====================\nCommunicator shape: %s (%d communicator%s)\n",
+               name, num_comms, (1 == num_comms) ? "" : "s");
+    }
+    fflush(NULL);
     MPI_Barrier(MPI_COMM_WORLD);
-#else
-    world_size = world_rank = local_size = -1;
-    snprintf(my_hostname, MPI_MAX_PROCESSOR_NAME, "localhost");
-#endif
 
-    if( 0 == world_rank || -1 == world_rank ) {
-        display_diagnostics();
+    if( MPI_COMM_NULL != comm ) {
+        snprintf(comm_shape_name, sizeof(comm_shape_name), "%s", name);
+        test_comm = comm;
+        if( 0 == world_rank && SHAPE_WORLD != comm_shapes ) {
+            printf("Communicator %s: %d processes starting at rank %d of MPI_COMM_WORLD\n",
+                   name, world_size, all_rank);
+        }
+        ret = run_tests();
     }
 
-    return 0;
+    test_comm = MPI_COMM_WORLD;
+    world_size = all_size;
+    world_rank = all_rank;
+    fflush(NULL);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    return ret;
 }
 
 /*
- * Calculate the uniform count for this collective given the datatype size,
- * number of processes (local and global), expected inflation in memory during
- * the collective, and the amount of memory we are limiting this test to consuming
- * on the system.
+ * Tag of MPI_Intercomm_create
+ */
+#define INTER_TAG 4343
+
+/*
+ * Run the tests on every communicator shape of BIGCOUNT_COMM_SHAPES (only
+ * MPI_COMM_WORLD by default). While a shape runs, the collectives use
+ * test_comm, and world_size/world_rank are relative to it.
  *
- * @param datateye_size size of the datatype
- * @param proposed_count the count that the caller wishes to use
- * @param mult_root memory multiplier at root (useful in gather-like operations where the root gathers N times the count)
- * @param mult_peer memory multiplier at non-roots (useful in allgather-like operations where the buffer is N times count)
- * @return proposed count to use in the collective
+ * @param run_tests function running all the test cases on test_comm
+ * @return 0 on success
  */
-size_t calc_uniform_count(size_t datatype_size, size_t proposed_count,
-                          size_t mult_root, size_t mult_peer)
+int run_comm_shapes(int (*run_tests)(void))
 {
-    size_t orig_proposed_count = proposed_count;
-    size_t orig_mult_root = mult_root;
-    size_t orig_mult_peer = mult_peer;
-    size_t payload_size_root;
-    size_t payload_size_peer;
-    size_t payload_size_all;
-    double perc = 1.0;
-    char *cpy_root = NULL, *cpy_peer = NULL;
+    MPI_Comm node_comm, comm;
+    int node_rank, group, ret = 0;
+    char name[32];
+
+    if( comm_shapes & SHAPE_WORLD ) {
+        ret += run_comm_shape("world", MPI_COMM_WORLD, run_tests);
+    }
 
-    mult_root = (size_t)(mult_root * alg_inflation);
-    mult_peer = (size_t)(mult_peer * alg_inflation);
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
 
-    payload_size_root = datatype_size * proposed_count * mult_root;
-    payload_size_peer = datatype_size * proposed_count * mult_peer;
-    payload_size_all  = payload_size_root + (payload_size_peer * (local_size-1));
+    if( comm_shapes & SHAPE_SHARED ) {
+        ret += run_comm_shape("shared", node_comm, run_tests);
+    }
 
-    while( (payload_size_all / ((size_t)1024 * 1024 * 1024)) > max_sys_mem_gb ) {
-        if( 2 == debug && 0 == world_rank ) {
-            fprintf(stderr, "----DEBUG---- Adjusting count. Try count of %10zu (payload_size %4zu GB) to fit in %4d GB limit (perc %6.2f)\n",
-                   proposed_count, payload_size_all/((size_t)1024 * 1024 * 1024), max_sys_mem_gb, perc);
+    if( comm_shapes & SHAPE_LEADERS ) {
+        MPI_Comm_split(MPI_COMM_WORLD, (0 == node_rank) ? 0 : MPI_UNDEFINED, world_rank, &comm);
+        ret += run_comm_shape("leaders", comm, run_tests);
+        if( MPI_COMM_NULL != comm ) {
+            MPI_Comm_free(&comm);
         }
+    }
 
-        perc -= 0.05;
-        // It is possible that we are working with extremely limited memory
-        // so the percentage dropped below 0. In this case just make the
-        // percentage equal to the max_sys_mem_gb.
-        if( perc <= 0.0 ) {
-            proposed_count = (max_sys_mem_gb * (size_t)1024 * 1024 * 1024) / (datatype_size * mult_root + datatype_size * mult_peer * (local_size-1));
-            perc = proposed_count / (double)orig_proposed_count;
-            if( 2 == debug && 0 == world_rank ) {
-                fprintf(stderr, "----DEBUG---- Adjusting count. Try count of %10zu (from %10zu) to fit in %4d GB limit (perc %6.9f) -- FINAL\n",
-                       proposed_count, orig_proposed_count, max_sys_mem_gb, perc);
-            }
-        } else {
-            proposed_count = orig_proposed_count * perc;
+    if( comm_shapes & SHAPE_SPLIT ) {
+        for( group = 2; group < world_size; group *= 2 ) {
+            MPI_Comm_split(MPI_COMM_WORLD, world_rank / group, world_rank, &comm);
+            snprintf(name, sizeof(name), "split%d", group);
+            ret += run_comm_shape(name, comm, run_tests);
+            MPI_Comm_free(&comm);
         }
-        assert(perc > 0.0);
-
-        payload_size_root = datatype_size * proposed_count * mult_root;
-        payload_size_peer = datatype_size * proposed_count * mult_peer;
-        payload_size_all  = payload_size_root + (payload_size_peer * (local_size-1));
     }
 
-    if(proposed_count != orig_proposed_count ) {
+    if( (comm_shapes & SHAPE_INTER) && !inter_supported ) {
         if( 0 == world_rank ) {
+            printf("=====================\nCommunicator shape: inter (not supported by this test)\n");
+        }
+    } else if( (comm_shapes & SHAPE_INTER) && world_size < 2 ) {
+        if( 0 == world_rank ) {
+            printf("=====================\nCommunicator shape: inter (requires at least 2 processes)\n");
+        }
+    } else if( comm_shapes & SHAPE_INTER ) {
+        // Low half: ranks [0, world_size / 2), high half: the rest
+        inter_low = (world_rank < world_size / 2);
+        MPI_Comm_split(MPI_COMM_WORLD, inter_low ? 0 : 1, world_rank, &comm);
+        MPI_Intercomm_create(comm, 0, MPI_COMM_WORLD, inter_low ? world_size / 2 : 0,
+                             INTER_TAG, &inter_comm);
+        MPI_Comm_free(&comm);
+        MPI_Comm_rank(inter_comm, &inter_rank);
+        MPI_Comm_size(inter_comm, &inter_size);
+        MPI_Comm_remote_size(inter_comm, &inter_remote_size);
+        MPI_Intercomm_merge(inter_comm, inter_low ? 0 : 1, &comm);
+        ret += run_comm_shape("inter", comm, run_tests);
+        MPI_Comm_free(&comm);
+        MPI_Comm_free(&inter_comm);
+    }
 
-            printf("--------------------- Adjust count to fit in memory: %10zu x %5.1f%% = %10zu\n",
-                   orig_proposed_count,
-                   (proposed_count / (double)orig_proposed_count)*100,
-                   proposed_count);
+    MPI_Comm_free(&node_comm);
+    snprintf(comm_shape_name, sizeof(comm_shape_name), "world");
 
-            cpy_root = strdup(human_bytes(payload_size_root));
-            printf("Root  : payload %14zu %8s = %3zu dt x %10zu count x %3zu peers x %5.1f inflation\n",
-                   payload_size_root, cpy_root,
-                   datatype_size, proposed_count, orig_mult_root, alg_inflation);
+    return ret;
+}
 
-            cpy_peer = strdup(human_bytes(payload_size_peer));
-            printf("Peer  : payload %14zu %8s = %3zu dt x %10zu count x %3zu peers x %5.1f inflation\n",
-                   payload_size_peer, cpy_peer,
-                   datatype_size, proposed_count, orig_mult_peer, alg_inflation);
+/*
+ * Same as run_comm_shapes, for the tests whose my_c_test_core also runs on
+ * inter_comm (the 'inter' shape of BIGCOUNT_COMM_SHAPES)
+ *
+ * @param run_tests function running all the test cases on test_comm (or inter_comm)
+ * @return 0 on success
+ */
+int run_comm_shapes_inter(int (*run_tests)(void))
+{
+    inter_supported = true;
+    return run_comm_shapes(run_tests);
+}
 
-            printf("Total : payload %14zu %8s = %8s root + %8s x %3d local peers\n",
-                   payload_size_all, human_bytes(payload_size_all),
-                   cpy_root, cpy_peer, local_size-1);
+/*
+ * Run the tests of a neighborhood collective on every virtual topology of
+ * BIGCOUNT_TOPOLOGIES, created on test_comm. While a topology runs, the
+ * collectives use test_topo->comm, and topo_blocks is its number of blocks.
+ *
+ * @param run_tests function running all the test cases on test_topo
+ * @return 0 on success
+ */
+int run_topologies(int (*run_tests)(void))
+{
+    static const int topos[] = { TOPO_CART2D, TOPO_CART3D, TOPO_GRAPH };
+    test_topo_t topo;
+    int i, ret = 0;
 
-            free(cpy_root);
-            free(cpy_peer);
+    for( i = 0; i < (int)(sizeof(topos) / sizeof(int)); ++i ) {
+        if( !(topologies & topos[i]) ) {
+            continue;
+        }
+        topo_create(topos[i], &topo);
+        if( 0 == world_rank ) {
+            if( topo.ndims > 0 ) {
+                printf("=====================\nTopology: %s (%d", topo.name, topo.dims[0]);
+                for( int d = 1; d < topo.ndims; ++d ) {
+                    printf(" x %d", topo.dims[d]);
+                }
+                printf(" processes, %d neighbors)\n", topo.blocks);
+            } else {
+                printf("=====================\nTopology: %s (%d processes, %d neighbors)\n",
+                       topo.name, world_size, topo.blocks);
+            }
         }
+        test_topo = &topo;
+        topo_blocks = topo.blocks;
+        ret += run_tests();
+        test_topo = NULL;
+        topo_blocks = 0;
+        MPI_Comm_free(&topo.comm);
     }
 
-    return proposed_count;
+    return ret;
 }
+#endif
@@ -8,10 +8,154 @@
 #include <unistd.h>
 #include <complex.h>
 #include <limits.h>
+#include <time.h>
 
 #include "common.h"
 
+/*
+ * Memory bandwidth calibration: STREAM style kernels on buffers from
+ * safe_malloc() (so BIGCOUNT_ALLOC applies), as the memory roofline of the
+ * collectives (see BIGCOUNT_ROOFLINE)
+ *  - stream_size       : BIGCOUNT_STREAM_SIZE bytes of each of the 3 arrays
+ *                        (0 to skip the calibration)
+ *  - stream_iterations : BIGCOUNT_STREAM_ITERATIONS (fastest one reported)
+ * The single thread kernels are the bandwidth of one rank, the kernels with
+ * BIGCOUNT_THREADS threads (0 for all cores) the bandwidth of the node.
+ */
+size_t stream_size = (size_t)256 * 1024 * 1024;
+int stream_iterations = 5;
+
+/*
+ * STREAM kernels
+ *  - STREAM_MEMCPY : c = a with memcpy (always a single thread)
+ *  - STREAM_COPY   : c[i] = a[i]
+ *  - STREAM_TRIAD  : a[i] = b[i] + scalar x c[i]
+ */
+enum {
+      STREAM_MEMCPY = 0,
+      STREAM_COPY   = 1,
+      STREAM_TRIAD  = 2
+};
+
+/*
+ * Wall clock time in seconds
+ */
+static inline double stream_wtime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+/*
+ * Run a STREAM kernel stream_iterations times
+ *
+ * @param kernel STREAM_MEMCPY, STREAM_COPY or STREAM_TRIAD
+ * @param a, b, c arrays of n elements
+ * @param n number of elements of each array
+ * @return bandwidth of the fastest iteration in GB/s (bytes read and written)
+ */
+static double stream_run(int kernel, double *a, double *b, double *c, size_t n)
+{
+    const double scalar = 3.0;
+    double start, elapsed, best = 0.0;
+    size_t i, bytes = ((STREAM_TRIAD == kernel) ? 3 : 2) * n * sizeof(double);
+    int iter;
+
+    for(iter = 0; iter < stream_iterations; ++iter) {
+        start = stream_wtime();
+        if( STREAM_MEMCPY == kernel ) {
+            memcpy(c, a, n * sizeof(double));
+        } else if( STREAM_COPY == kernel ) {
+            PARALLEL_FOR()
+            for(i = 0; i < n; ++i) {
+                c[i] = a[i];
+            }
+        } else {
+            PARALLEL_FOR()
+            for(i = 0; i < n; ++i) {
+                a[i] = b[i] + scalar * c[i];
+            }
+        }
+        elapsed = stream_wtime() - start;
+        if( 0 == iter || elapsed < best ) {
+            best = elapsed;
+        }
+    }
+    return (best > 0.0) ? (bytes / best) / ((size_t)1024 * 1024 * 1024) : 0.0;
+}
+
+/*
+ * Measure and display the memory bandwidth of one rank and of the node
+ */
+static void stream_calibrate(void)
+{
+    size_t n = stream_size / sizeof(double), i;
+    double *a, *b, *c;
+    double copy_1, triad_1, memcpy_1, copy_n = 0.0, triad_n = 0.0;
+    int threads = fill_threads;
+
+    a = (double*)safe_malloc(n * sizeof(double));
+    b = (double*)safe_malloc(n * sizeof(double));
+    c = (double*)safe_malloc(n * sizeof(double));
+    // First touch with the threads of the node kernels (page placement)
+    PARALLEL_FOR()
+    for(i = 0; i < n; ++i) {
+        a[i] = 1.0;
+        b[i] = 2.0;
+        c[i] = 0.0;
+    }
+
+    fill_threads = 1;
+    memcpy_1 = stream_run(STREAM_MEMCPY, a, b, c, n);
+    copy_1 = stream_run(STREAM_COPY, a, b, c, n);
+    triad_1 = stream_run(STREAM_TRIAD, a, b, c, n);
+    fill_threads = threads;
+    if( threads > 1 ) {
+        copy_n = stream_run(STREAM_COPY, a, b, c, n);
+        triad_n = stream_run(STREAM_TRIAD, a, b, c, n);
+    }
+
+    printf("Memory bandwidth      : 3 x %s arrays, best of %d (GB/s)\n",
+           human_bytes(n * sizeof(double)), stream_iterations);
+    printf("memcpy (1 thread)     : %10.3f\n", memcpy_1);
+    printf("copy   (1 thread)     : %10.3f\n", copy_1);
+    printf("triad  (1 thread)     : %10.3f\n", triad_1);
+    if( threads > 1 ) {
+        printf("copy   (%3d threads)  : %10.3f\n", threads, copy_n);
+        printf("triad  (%3d threads)  : %10.3f\n", threads, triad_n);
+    } else {
+        printf("Node bandwidth        : set BIGCOUNT_THREADS=0 to measure with all cores\n");
+    }
+    printf("BIGCOUNT_ROOFLINE     : %10.3f (copy of the node, the tests divide it by the ranks per node)\n",
+           (threads > 1 && copy_n > copy_1) ? copy_n : copy_1);
+#ifndef __OPTIMIZE__
+    printf("Warning               : built without optimization (-O0), copy and triad are pessimistic\n");
+#endif
+    printf("----------------------:-----------------------------------------\n");
+
+    safe_free(a);
+    safe_free(b);
+    safe_free(c);
+}
+
 int main(int argc, char** argv) {
+    char *env_str = NULL;
+
     init_environment(argc, argv);
+
+    if( NULL != (env_str = getenv("BIGCOUNT_STREAM_SIZE")) ) {
+        stream_size = parse_bytes(env_str);
+    }
+    if( NULL != (env_str = getenv("BIGCOUNT_STREAM_ITERATIONS")) ) {
+        stream_iterations = (int)strtol(env_str, NULL, 10);
+        if( stream_iterations < 1 ) {
+            stream_iterations = 1;
+        }
+    }
+    if( stream_size >= sizeof(double) ) {
+        stream_calibrate();
+    }
     return 0;
 }
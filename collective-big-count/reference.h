@@ -0,0 +1,726 @@
+/*
+ * Copyright (c) 2021-2022 IBM Corporation.  All rights reserved.
+ *
+ * $COPYRIGHT$
+ */
+
+/*
+ * Reference implementations of the collectives (BIGCOUNT_REFERENCE)
+ *
+ * Each ref_* function has the same arguments and semantics as the blocking
+ * MPI collective, but never passes a count larger than the chunk size
+ * (BIGCOUNT_REFERENCE_CHUNK bytes, at most INT_MAX elements) to MPI:
+ *  - Regular collectives: the payload is split into chunks and each chunk
+ *    is a nonblocking collective on the same communicator. Up to
+ *    BIGCOUNT_REFERENCE_DEPTH chunks are in flight at a time (pipelined).
+ *    For the rooted/all-to-all collectives a chunk covers the same range of
+ *    elements in every per-process block, using a resized datatype whose
+ *    extent is the block size.
+ *  - 'v' and 'w' collectives: point-to-point messages of at most one chunk
+ *    between each pair of processes. All the receives are posted before the
+ *    sends.
+ *  - Reduce_scatter(_block): one chunked reduction to each process.
+ *  - Neighborhood collectives: point-to-point messages of at most one chunk
+ *    with each neighbor of the virtual topology, as for the 'v' collectives.
+ *
+ * The timing of the native collective against these (see timer_report)
+ * gives a baseline of what the coll component should at least achieve.
+ *
+ * Note: Must be included after common.h
+ */
+
+#define REF_TAG 4242
+
+/*
+ * Pipeline of nonblocking collectives (at most ref_depth in flight)
+ */
+typedef struct {
+    MPI_Request reqs[REF_MAX_DEPTH];
+    int num;
+} ref_pipeline_t;
+
+/*
+ * Point-to-point requests of a 'v' collective
+ */
+typedef struct {
+    MPI_Request *reqs;
+    size_t num;
+    size_t max;
+} ref_p2p_t;
+
+/*
+ * Number of elements of a chunk for this datatype
+ *
+ * @param dtype datatype of the payload
+ * @return elements per chunk (between 1 and INT_MAX)
+ */
+static inline size_t ref_chunk_count(MPI_Datatype dtype)
+{
+    int type_size;
+    size_t count;
+
+    MPI_Type_size(dtype, &type_size);
+    count = ref_chunk_bytes / (size_t)type_size;
+    if( count < 1 ) {
+        count = 1;
+    } else if( count > INT_MAX ) {
+        count = INT_MAX;
+    }
+    return count;
+}
+
+/*
+ * Address of an element of a buffer
+ *
+ * @param buf start of the buffer (NULL and MPI_IN_PLACE are returned as is)
+ * @param index index of the element
+ * @param dtype datatype of the buffer
+ * @return address of the element
+ */
+static inline void * ref_offset(const void *buf, size_t index, MPI_Datatype dtype)
+{
+    MPI_Aint lb, extent;
+
+    if( NULL == buf || MPI_IN_PLACE == buf ) {
+        return (void*)buf;
+    }
+    MPI_Type_get_extent(dtype, &lb, &extent);
+    return (char*)buf + index * (size_t)extent;
+}
+
+/*
+ * Datatype of 'count' consecutive elements whose extent is a full block of
+ * 'block_count' elements (one chunk of every block of the buffer)
+ * Note: Free with MPI_Type_free (allowed while a collective is using it)
+ *
+ * @param count number of elements in the chunk
+ * @param block_count number of elements in the per-process block
+ * @param dtype datatype of the buffer
+ * @return committed datatype
+ */
+static inline MPI_Datatype ref_block_type(size_t count, size_t block_count, MPI_Datatype dtype)
+{
+    MPI_Datatype contig, block;
+    MPI_Aint lb, extent;
+
+    MPI_Type_get_extent(dtype, &lb, &extent);
+    MPI_Type_contiguous((int)count, dtype, &contig);
+    MPI_Type_create_resized(contig, 0, (MPI_Aint)(block_count * (size_t)extent), &block);
+    MPI_Type_commit(&block);
+    MPI_Type_free(&contig);
+    return block;
+}
+
+static inline void ref_pipeline_init(ref_pipeline_t *pipe)
+{
+    pipe->num = 0;
+}
+
+/*
+ * Request for the next chunk. Waits for one of the chunks in flight if the
+ * pipeline is full.
+ *
+ * @param pipe pipeline
+ * @return request to pass to the nonblocking collective
+ */
+static inline MPI_Request * ref_pipeline_next(ref_pipeline_t *pipe)
+{
+    int idx;
+
+    if( pipe->num < ref_depth ) {
+        return &pipe->reqs[pipe->num++];
+    }
+    MPI_Waitany(pipe->num, pipe->reqs, &idx, MPI_STATUS_IGNORE);
+    return &pipe->reqs[idx];
+}
+
+/*
+ * Wait for all the chunks in flight
+ *
+ * @param pipe pipeline
+ */
+static inline void ref_pipeline_wait(ref_pipeline_t *pipe)
+{
+    MPI_Waitall(pipe->num, pipe->reqs, MPI_STATUSES_IGNORE);
+    pipe->num = 0;
+}
+
+static inline void ref_p2p_init(ref_p2p_t *p2p)
+{
+    p2p->reqs = NULL;
+    p2p->num = 0;
+    p2p->max = 0;
+}
+
+/*
+ * Post the chunked point-to-point messages for one block
+ *
+ * @param p2p requests of the collective
+ * @param buf start of the block
+ * @param count number of elements in the block
+ * @param dtype datatype of the block
+ * @param peer rank of the other process
+ * @param is_send true to send the block, false to receive it
+ * @param comm communicator
+ */
+static inline void ref_p2p_post(ref_p2p_t *p2p, const void *buf, size_t count,
+                                MPI_Datatype dtype, int peer, bool is_send, MPI_Comm comm)
+{
+    size_t chunk = ref_chunk_count(dtype);
+    size_t off, n;
+
+    for(off = 0; off < count; off += n) {
+        n = (count - off < chunk) ? count - off : chunk;
+        if( p2p->num == p2p->max ) {
+            p2p->max = (0 == p2p->max) ? 64 : p2p->max * 2;
+            p2p->reqs = (MPI_Request*)realloc(p2p->reqs, p2p->max * sizeof(MPI_Request));
+            if( NULL == p2p->reqs ) {
+                fprintf(stderr, "Rank %d on %s) Error: Out of memory for the reference requests\n",
+                        world_rank, my_hostname);
+                MPI_Abort(MPI_COMM_WORLD, 3);
+            }
+        }
+        if( is_send ) {
+            MPI_Isend(ref_offset(buf, off, dtype), (int)n, dtype, peer, REF_TAG, comm,
+                      &p2p->reqs[p2p->num++]);
+        } else {
+            MPI_Irecv(ref_offset(buf, off, dtype), (int)n, dtype, peer, REF_TAG, comm,
+                      &p2p->reqs[p2p->num++]);
+        }
+    }
+}
+
+/*
+ * Wait for all the point-to-point messages
+ *
+ * @param p2p requests of the collective
+ */
+static inline void ref_p2p_wait(ref_p2p_t *p2p)
+{
+    if( p2p->num > 0 ) {
+        MPI_Waitall((int)p2p->num, p2p->reqs, MPI_STATUSES_IGNORE);
+    }
+    free(p2p->reqs);
+    ref_p2p_init(p2p);
+}
+
+/*
+ * Reduction collectives (Allreduce, Reduce, Scan, Exscan): chunks of the
+ * whole buffer
+ */
+enum {
+      REF_ALLREDUCE = 0,
+      REF_REDUCE    = 1,
+      REF_SCAN      = 2,
+      REF_EXSCAN    = 3
+};
+
+static inline int ref_reduction(int coll, const void *sendbuf, void *recvbuf, test_count_t count,
+                                MPI_Datatype dtype, MPI_Op op, int root, MPI_Comm comm)
+{
+    ref_pipeline_t pipe;
+    size_t chunk = ref_chunk_count(dtype);
+    size_t off, n;
+    const void *sbuf;
+    void *rbuf;
+
+    ref_pipeline_init(&pipe);
+    for(off = 0; off < (size_t)count; off += n) {
+        n = ((size_t)count - off < chunk) ? (size_t)count - off : chunk;
+        sbuf = ref_offset(sendbuf, off, dtype);
+        rbuf = ref_offset(recvbuf, off, dtype);
+        if( REF_ALLREDUCE == coll ) {
+            MPI_Iallreduce(sbuf, rbuf, (int)n, dtype, op, comm, ref_pipeline_next(&pipe));
+        } else if( REF_REDUCE == coll ) {
+            MPI_Ireduce(sbuf, rbuf, (int)n, dtype, op, root, comm, ref_pipeline_next(&pipe));
+        } else if( REF_SCAN == coll ) {
+            MPI_Iscan(sbuf, rbuf, (int)n, dtype, op, comm, ref_pipeline_next(&pipe));
+        } else {
+            MPI_Iexscan(sbuf, rbuf, (int)n, dtype, op, comm, ref_pipeline_next(&pipe));
+        }
+    }
+    ref_pipeline_wait(&pipe);
+    return MPI_SUCCESS;
+}
+
+static inline int ref_allreduce(const void *sendbuf, void *recvbuf, test_count_t count,
+                                MPI_Datatype dtype, MPI_Op op, MPI_Comm comm)
+{
+    return ref_reduction(REF_ALLREDUCE, sendbuf, recvbuf, count, dtype, op, 0, comm);
+}
+
+static inline int ref_reduce(const void *sendbuf, void *recvbuf, test_count_t count,
+                             MPI_Datatype dtype, MPI_Op op, int root, MPI_Comm comm)
+{
+    return ref_reduction(REF_REDUCE, sendbuf, recvbuf, count, dtype, op, root, comm);
+}
+
+static inline int ref_scan(const void *sendbuf, void *recvbuf, test_count_t count,
+                           MPI_Datatype dtype, MPI_Op op, MPI_Comm comm)
+{
+    return ref_reduction(REF_SCAN, sendbuf, recvbuf, count, dtype, op, 0, comm);
+}
+
+static inline int ref_exscan(const void *sendbuf, void *recvbuf, test_count_t count,
+                             MPI_Datatype dtype, MPI_Op op, MPI_Comm comm)
+{
+    return ref_reduction(REF_EXSCAN, sendbuf, recvbuf, count, dtype, op, 0, comm);
+}
+
+static inline int ref_bcast(void *buf, test_count_t count, MPI_Datatype dtype, int root,
+                            MPI_Comm comm)
+{
+    ref_pipeline_t pipe;
+    size_t chunk = ref_chunk_count(dtype);
+    size_t off, n;
+
+    ref_pipeline_init(&pipe);
+    for(off = 0; off < (size_t)count; off += n) {
+        n = ((size_t)count - off < chunk) ? (size_t)count - off : chunk;
+        MPI_Ibcast(ref_offset(buf, off, dtype), (int)n, dtype, root, comm,
+                   ref_pipeline_next(&pipe));
+    }
+    ref_pipeline_wait(&pipe);
+    return MPI_SUCCESS;
+}
+
+/*
+ * Block collectives (Allgather, Alltoall, Gather, Scatter): each chunk
+ * covers the same range of elements of every per-process block.
+ * Note: The send and receive datatypes must have the same size.
+ */
+enum {
+      REF_ALLGATHER = 0,
+      REF_ALLTOALL  = 1,
+      REF_GATHER    = 2,
+      REF_SCATTER   = 3
+};
+
+static inline int ref_blocks(int coll, const void *sendbuf, test_count_t sendcount,
+                             MPI_Datatype sendtype, void *recvbuf, test_count_t recvcount,
+                             MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+    ref_pipeline_t pipe;
+    MPI_Datatype stype, rtype;
+    size_t count, chunk, off, n;
+    int rank;
+
+    MPI_Comm_rank(comm, &rank);
+    // Number of elements per block (the same at all processes)
+    if( REF_GATHER == coll ) {
+        count = (rank == root && MPI_IN_PLACE == sendbuf) ? (size_t)recvcount : (size_t)sendcount;
+    } else if( REF_SCATTER == coll ) {
+        count = (rank == root && MPI_IN_PLACE == recvbuf) ? (size_t)sendcount : (size_t)recvcount;
+    } else {
+        count = (size_t)recvcount;
+    }
+    chunk = ref_chunk_count(recvtype);
+
+    ref_pipeline_init(&pipe);
+    for(off = 0; off < count; off += n) {
+        n = (count - off < chunk) ? count - off : chunk;
+        if( REF_ALLGATHER == coll ) {
+            rtype = ref_block_type(n, (size_t)recvcount, recvtype);
+            MPI_Iallgather(ref_offset(sendbuf, off, sendtype), (int)n, sendtype,
+                           ref_offset(recvbuf, off, recvtype), 1, rtype,
+                           comm, ref_pipeline_next(&pipe));
+            MPI_Type_free(&rtype);
+        } else if( REF_ALLTOALL == coll ) {
+            stype = ref_block_type(n, (size_t)sendcount, sendtype);
+            rtype = ref_block_type(n, (size_t)recvcount, recvtype);
+            MPI_Ialltoall(ref_offset(sendbuf, off, sendtype), 1, stype,
+                          ref_offset(recvbuf, off, recvtype), 1, rtype,
+                          comm, ref_pipeline_next(&pipe));
+            MPI_Type_free(&stype);
+            MPI_Type_free(&rtype);
+        } else if( REF_GATHER == coll ) {
+            rtype = ref_block_type(n, (size_t)recvcount, recvtype);
+            MPI_Igather(ref_offset(sendbuf, off, sendtype), (int)n, sendtype,
+                        ref_offset(recvbuf, off, recvtype), 1, rtype,
+                        root, comm, ref_pipeline_next(&pipe));
+            MPI_Type_free(&rtype);
+        } else {
+            stype = ref_block_type(n, (size_t)sendcount, sendtype);
+            MPI_Iscatter(ref_offset(sendbuf, off, sendtype), 1, stype,
+                         ref_offset(recvbuf, off, recvtype), (int)n, recvtype,
+                         root, comm, ref_pipeline_next(&pipe));
+            MPI_Type_free(&stype);
+        }
+    }
+    ref_pipeline_wait(&pipe);
+    return MPI_SUCCESS;
+}
+
+static inline int ref_allgather(const void *sendbuf, test_count_t sendcount, MPI_Datatype sendtype,
+                                void *recvbuf, test_count_t recvcount, MPI_Datatype recvtype,
+                                MPI_Comm comm)
+{
+    return ref_blocks(REF_ALLGATHER, sendbuf, sendcount, sendtype,
+                      recvbuf, recvcount, recvtype, 0, comm);
+}
+
+static inline int ref_alltoall(const void *sendbuf, test_count_t sendcount, MPI_Datatype sendtype,
+                               void *recvbuf, test_count_t recvcount, MPI_Datatype recvtype,
+                               MPI_Comm comm)
+{
+    return ref_blocks(REF_ALLTOALL, sendbuf, sendcount, sendtype,
+                      recvbuf, recvcount, recvtype, 0, comm);
+}
+
+static inline int ref_gather(const void *sendbuf, test_count_t sendcount, MPI_Datatype sendtype,
+                             void *recvbuf, test_count_t recvcount, MPI_Datatype recvtype,
+                             int root, MPI_Comm comm)
+{
+    return ref_blocks(REF_GATHER, sendbuf, sendcount, sendtype,
+                      recvbuf, recvcount, recvtype, root, comm);
+}
+
+static inline int ref_scatter(const void *sendbuf, test_count_t sendcount, MPI_Datatype sendtype,
+                              void *recvbuf, test_count_t recvcount, MPI_Datatype recvtype,
+                              int root, MPI_Comm comm)
+{
+    return ref_blocks(REF_SCATTER, sendbuf, sendcount, sendtype,
+                      recvbuf, recvcount, recvtype, root, comm);
+}
+
+static inline int ref_allgatherv(const void *sendbuf, test_count_t sendcount, MPI_Datatype sendtype,
+                                 void *recvbuf, const test_count_t recvcounts[],
+                                 const test_disp_t displs[], MPI_Datatype recvtype, MPI_Comm comm)
+{
+    ref_p2p_t p2p;
+    bool in_place = (MPI_IN_PLACE == sendbuf);
+    int rank, size, p;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    if( in_place ) {
+        sendbuf = ref_offset(recvbuf, (size_t)displs[rank], recvtype);
+        sendcount = recvcounts[rank];
+        sendtype = recvtype;
+    }
+
+    ref_p2p_init(&p2p);
+    for(p = 0; p < size; ++p) {
+        if( p != rank || !in_place ) {
+            ref_p2p_post(&p2p, ref_offset(recvbuf, (size_t)displs[p], recvtype),
+                         (size_t)recvcounts[p], recvtype, p, false, comm);
+        }
+    }
+    for(p = 0; p < size; ++p) {
+        if( p != rank || !in_place ) {
+            ref_p2p_post(&p2p, sendbuf, (size_t)sendcount, sendtype, p, true, comm);
+        }
+    }
+    ref_p2p_wait(&p2p);
+    return MPI_SUCCESS;
+}
+
+static inline int ref_alltoallv(const void *sendbuf, const test_count_t sendcounts[],
+                                const test_disp_t sdispls[], MPI_Datatype sendtype,
+                                void *recvbuf, const test_count_t recvcounts[],
+                                const test_disp_t rdispls[], MPI_Datatype recvtype, MPI_Comm comm)
+{
+    ref_p2p_t p2p;
+    size_t chunk = ref_chunk_count(recvtype);
+    size_t off, n;
+    int rank, size, p;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // MPI_IN_PLACE: the block of each peer is replaced in turn, in increasing
+    // order of the peers (deadlock free since the pairs are processed in the
+    // same order by all processes)
+    if( MPI_IN_PLACE == sendbuf ) {
+        for(p = 0; p < size; ++p) {
+            if( p == rank ) {
+                continue;
+            }
+            for(off = 0; off < (size_t)recvcounts[p]; off += n) {
+                n = ((size_t)recvcounts[p] - off < chunk) ? (size_t)recvcounts[p] - off : chunk;
+                MPI_Sendrecv_replace(ref_offset(recvbuf, (size_t)rdispls[p] + off, recvtype),
+                                     (int)n, recvtype, p, REF_TAG, p, REF_TAG, comm, MPI_STATUS_IGNORE);
+            }
+        }
+        return MPI_SUCCESS;
+    }
+
+    ref_p2p_init(&p2p);
+    for(p = 0; p < size; ++p) {
+        ref_p2p_post(&p2p, ref_offset(recvbuf, (size_t)rdispls[p], recvtype),
+                     (size_t)recvcounts[p], recvtype, p, false, comm);
+    }
+    for(p = 0; p < size; ++p) {
+        ref_p2p_post(&p2p, ref_offset(sendbuf, (size_t)sdispls[p], sendtype),
+                     (size_t)sendcounts[p], sendtype, p, true, comm);
+    }
+    ref_p2p_wait(&p2p);
+    return MPI_SUCCESS;
+}
+
+/*
+ * The chunks are counted in elements of the per-process datatypes, so the
+ * send and receive datatypes of each pair of processes must have the same
+ * size (not only the same type signature) for the chunks to match.
+ */
+static inline int ref_alltoallw(const void *sendbuf, const test_count_t sendcounts[],
+                                const test_disp_t sdispls[], const MPI_Datatype sendtypes[],
+                                void *recvbuf, const test_count_t recvcounts[],
+                                const test_disp_t rdispls[], const MPI_Datatype recvtypes[],
+                                MPI_Comm comm)
+{
+    ref_p2p_t p2p;
+    int size, p;
+
+    // MPI_IN_PLACE would need a copy of the send data
+    assert(MPI_IN_PLACE != sendbuf);
+    MPI_Comm_size(comm, &size);
+
+    ref_p2p_init(&p2p);
+    for(p = 0; p < size; ++p) {
+        ref_p2p_post(&p2p, (char*)recvbuf + rdispls[p], (size_t)recvcounts[p], recvtypes[p],
+                     p, false, comm);
+    }
+    for(p = 0; p < size; ++p) {
+        ref_p2p_post(&p2p, (const char*)sendbuf + sdispls[p], (size_t)sendcounts[p], sendtypes[p],
+                     p, true, comm);
+    }
+    ref_p2p_wait(&p2p);
+    return MPI_SUCCESS;
+}
+
+static inline int ref_gatherv(const void *sendbuf, test_count_t sendcount, MPI_Datatype sendtype,
+                              void *recvbuf, const test_count_t recvcounts[],
+                              const test_disp_t displs[], MPI_Datatype recvtype,
+                              int root, MPI_Comm comm)
+{
+    ref_p2p_t p2p;
+    int rank, size, p;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    ref_p2p_init(&p2p);
+    if( rank == root ) {
+        for(p = 0; p < size; ++p) {
+            if( p != root || MPI_IN_PLACE != sendbuf ) {
+                ref_p2p_post(&p2p, ref_offset(recvbuf, (size_t)displs[p], recvtype),
+                             (size_t)recvcounts[p], recvtype, p, false, comm);
+            }
+        }
+    }
+    if( MPI_IN_PLACE != sendbuf ) {
+        ref_p2p_post(&p2p, sendbuf, (size_t)sendcount, sendtype, root, true, comm);
+    }
+    ref_p2p_wait(&p2p);
+    return MPI_SUCCESS;
+}
+
+static inline int ref_scatterv(const void *sendbuf, const test_count_t sendcounts[],
+                               const test_disp_t displs[], MPI_Datatype sendtype,
+                               void *recvbuf, test_count_t recvcount, MPI_Datatype recvtype,
+                               int root, MPI_Comm comm)
+{
+    ref_p2p_t p2p;
+    int rank, size, p;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    ref_p2p_init(&p2p);
+    if( MPI_IN_PLACE != recvbuf ) {
+        ref_p2p_post(&p2p, recvbuf, (size_t)recvcount, recvtype, root, false, comm);
+    }
+    if( rank == root ) {
+        for(p = 0; p < size; ++p) {
+            if( p != root || MPI_IN_PLACE != recvbuf ) {
+                ref_p2p_post(&p2p, ref_offset(sendbuf, (size_t)displs[p], sendtype),
+                             (size_t)sendcounts[p], sendtype, p, true, comm);
+            }
+        }
+    }
+    ref_p2p_wait(&p2p);
+    return MPI_SUCCESS;
+}
+
+static inline int ref_reduce_scatter(const void *sendbuf, void *recvbuf, const test_count_t recvcounts[],
+                                     MPI_Datatype dtype, MPI_Op op, MPI_Comm comm)
+{
+    ref_pipeline_t pipe;
+    size_t chunk = ref_chunk_count(dtype);
+    size_t base = 0, off, n;
+    int rank, size, r;
+
+    // MPI_IN_PLACE would need the result moved to the start of recvbuf
+    assert(MPI_IN_PLACE != sendbuf);
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    ref_pipeline_init(&pipe);
+    for(r = 0; r < size; ++r) {
+        for(off = 0; off < (size_t)recvcounts[r]; off += n) {
+            n = ((size_t)recvcounts[r] - off < chunk) ? (size_t)recvcounts[r] - off : chunk;
+            MPI_Ireduce(ref_offset(sendbuf, base + off, dtype),
+                        (r == rank) ? ref_offset(recvbuf, off, dtype) : NULL,
+                        (int)n, dtype, op, r, comm, ref_pipeline_next(&pipe));
+        }
+        base += (size_t)recvcounts[r];
+    }
+    ref_pipeline_wait(&pipe);
+    return MPI_SUCCESS;
+}
+
+static inline int ref_reduce_scatter_block(const void *sendbuf, void *recvbuf, test_count_t recvcount,
+                                           MPI_Datatype dtype, MPI_Op op, MPI_Comm comm)
+{
+    int size, r;
+
+    MPI_Comm_size(comm, &size);
+    test_count_t recvcounts[size];
+    for(r = 0; r < size; ++r) {
+        recvcounts[r] = recvcount;
+    }
+    return ref_reduce_scatter(sendbuf, recvbuf, recvcounts, dtype, op, comm);
+}
+
+/*
+ * Neighbors of a Cartesian or distributed graph communicator, in the order of
+ * the neighborhood collectives
+ *
+ * @param comm communicator with a virtual topology
+ * @param indegree (OUT) number of sources
+ * @param sources (OUT) sources (at most TOPO_MAX_DEGREE)
+ * @param outdegree (OUT) number of destinations
+ * @param destinations (OUT) destinations (at most TOPO_MAX_DEGREE)
+ */
+static inline void ref_neighbors(MPI_Comm comm, int *indegree, int sources[],
+                                 int *outdegree, int destinations[])
+{
+    int status, ndims, weighted, d;
+    int sourceweights[TOPO_MAX_DEGREE], destweights[TOPO_MAX_DEGREE];
+
+    MPI_Topo_test(comm, &status);
+    if( MPI_CART == status ) {
+        MPI_Cartdim_get(comm, &ndims);
+        assert(2 * ndims <= TOPO_MAX_DEGREE);
+        for(d = 0; d < ndims; ++d) {
+            MPI_Cart_shift(comm, d, 1, &sources[2 * d], &sources[2 * d + 1]);
+            destinations[2 * d] = sources[2 * d];
+            destinations[2 * d + 1] = sources[2 * d + 1];
+        }
+        *indegree = *outdegree = 2 * ndims;
+    } else {
+        assert(MPI_DIST_GRAPH == status);
+        MPI_Dist_graph_neighbors_count(comm, indegree, outdegree, &weighted);
+        assert(*indegree <= TOPO_MAX_DEGREE && *outdegree <= TOPO_MAX_DEGREE);
+        MPI_Dist_graph_neighbors(comm, *indegree, sources, sourceweights,
+                                 *outdegree, destinations, destweights);
+    }
+}
+
+/*
+ * Neighborhood collectives: all of them are a Neighbor_alltoallw (byte
+ * displacements, one datatype per neighbor)
+ */
+static inline int ref_neighbor_alltoallw(const void *sendbuf, const test_count_t sendcounts[],
+                                         const MPI_Aint sdispls[], const MPI_Datatype sendtypes[],
+                                         void *recvbuf, const test_count_t recvcounts[],
+                                         const MPI_Aint rdispls[], const MPI_Datatype recvtypes[],
+                                         MPI_Comm comm)
+{
+    ref_p2p_t p2p;
+    int sources[TOPO_MAX_DEGREE], destinations[TOPO_MAX_DEGREE];
+    int indegree, outdegree, i;
+
+    ref_neighbors(comm, &indegree, sources, &outdegree, destinations);
+
+    ref_p2p_init(&p2p);
+    for(i = 0; i < indegree; ++i) {
+        ref_p2p_post(&p2p, (char*)recvbuf + rdispls[i], (size_t)recvcounts[i], recvtypes[i],
+                     sources[i], false, comm);
+    }
+    for(i = 0; i < outdegree; ++i) {
+        ref_p2p_post(&p2p, (const char*)sendbuf + sdispls[i], (size_t)sendcounts[i], sendtypes[i],
+                     destinations[i], true, comm);
+    }
+    ref_p2p_wait(&p2p);
+    return MPI_SUCCESS;
+}
+
+static inline int ref_neighbor_alltoallv(const void *sendbuf, const test_count_t sendcounts[],
+                                         const test_disp_t sdispls[], MPI_Datatype sendtype,
+                                         void *recvbuf, const test_count_t recvcounts[],
+                                         const test_disp_t rdispls[], MPI_Datatype recvtype,
+                                         MPI_Comm comm)
+{
+    MPI_Aint sbytes[TOPO_MAX_DEGREE], rbytes[TOPO_MAX_DEGREE], lb, sextent, rextent;
+    MPI_Datatype stypes[TOPO_MAX_DEGREE], rtypes[TOPO_MAX_DEGREE];
+    int sources[TOPO_MAX_DEGREE], destinations[TOPO_MAX_DEGREE];
+    int indegree, outdegree, i;
+
+    ref_neighbors(comm, &indegree, sources, &outdegree, destinations);
+    MPI_Type_get_extent(sendtype, &lb, &sextent);
+    MPI_Type_get_extent(recvtype, &lb, &rextent);
+    for(i = 0; i < outdegree; ++i) {
+        sbytes[i] = (MPI_Aint)sdispls[i] * sextent;
+        stypes[i] = sendtype;
+    }
+    for(i = 0; i < indegree; ++i) {
+        rbytes[i] = (MPI_Aint)rdispls[i] * rextent;
+        rtypes[i] = recvtype;
+    }
+    return ref_neighbor_alltoallw(sendbuf, sendcounts, sbytes, stypes,
+                                  recvbuf, recvcounts, rbytes, rtypes, comm);
+}
+
+static inline int ref_neighbor_alltoall(const void *sendbuf, test_count_t sendcount, MPI_Datatype sendtype,
+                                        void *recvbuf, test_count_t recvcount, MPI_Datatype recvtype,
+                                        MPI_Comm comm)
+{
+    test_count_t scounts[TOPO_MAX_DEGREE], rcounts[TOPO_MAX_DEGREE];
+    test_disp_t sdispls[TOPO_MAX_DEGREE], rdispls[TOPO_MAX_DEGREE];
+    int i;
+
+    for(i = 0; i < TOPO_MAX_DEGREE; ++i) {
+        scounts[i] = sendcount;
+        sdispls[i] = (test_disp_t)i * sendcount;
+        rcounts[i] = recvcount;
+        rdispls[i] = (test_disp_t)i * recvcount;
+    }
+    return ref_neighbor_alltoallv(sendbuf, scounts, sdispls, sendtype,
+                                  recvbuf, rcounts, rdispls, recvtype, comm);
+}
+
+static inline int ref_neighbor_allgatherv(const void *sendbuf, test_count_t sendcount, MPI_Datatype sendtype,
+                                          void *recvbuf, const test_count_t recvcounts[],
+                                          const test_disp_t displs[], MPI_Datatype recvtype,
+                                          MPI_Comm comm)
+{
+    test_count_t scounts[TOPO_MAX_DEGREE];
+    test_disp_t sdispls[TOPO_MAX_DEGREE];
+    int i;
+
+    // The same block to every destination
+    for(i = 0; i < TOPO_MAX_DEGREE; ++i) {
+        scounts[i] = sendcount;
+        sdispls[i] = 0;
+    }
+    return ref_neighbor_alltoallv(sendbuf, scounts, sdispls, sendtype,
+                                  recvbuf, recvcounts, displs, recvtype, comm);
+}
+
+static inline int ref_neighbor_allgather(const void *sendbuf, test_count_t sendcount, MPI_Datatype sendtype,
+                                         void *recvbuf, test_count_t recvcount, MPI_Datatype recvtype,
+                                         MPI_Comm comm)
+{
+    test_count_t rcounts[TOPO_MAX_DEGREE];
+    test_disp_t rdispls[TOPO_MAX_DEGREE];
+    int i;
+
+    for(i = 0; i < TOPO_MAX_DEGREE; ++i) {
+        rcounts[i] = recvcount;
+        rdispls[i] = (test_disp_t)i * recvcount;
+    }
+    return ref_neighbor_allgatherv(sendbuf, sendcount, sendtype,
+                                   recvbuf, rcounts, rdispls, recvtype, comm);
+}
@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2022 IBM Corporation.  All rights reserved.
+ *
+ * $COPYRIGHT$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <complex.h>
+#include <limits.h>
+#include <time.h>
+
+#include "common.h"
+
+/*
+ * Single process self-test of the fill and verify kernels of the tests.
+ * No MPI: the result of the collective at one of 'selftest_np' simulated
+ * processes is computed locally from the send buffer fill of every process,
+ * then checked with the verify logic of the tests. Each kernel is timed in
+ * isolation, to profile the host side cost of the big count runs.
+ *  - selftest_np         : BIGCOUNT_SELFTEST_NP number of simulated processes
+ *  - selftest_iterations : BIGCOUNT_SELFTEST_ITERATIONS (fastest one reported)
+ */
+int selftest_np = 4;
+int selftest_iterations = 1;
+
+/*
+ * Kind of self-test case (the pattern of each block of the buffers)
+ *  - ST_CONSTANT : fill_value and check_value
+ *  - ST_LINEAR   : fill_linear and check_linear
+ *  - ST_PRIME    : fill_prime_pattern and check_prime_pattern (vectorized)
+ *  - ST_REDUCE   : fill_op_input and check_op_result of each op (BIGCOUNT_OPS)
+ */
+enum {
+      ST_CONSTANT = 0,
+      ST_LINEAR   = 1,
+      ST_PRIME    = 2,
+      ST_REDUCE   = 3
+};
+
+/*
+ * The simulated processes send with the send_base of the high half of
+ * inter_comm, so the checks use a non zero recv_base (see coll_comm_t)
+ */
+#define SELFTEST_BASE INTER_HIGH_BASE
+
+/*
+ * Self-test case: the fill and verify logic of a family of tests. The buffers
+ * hold blocks of count / selftest_np elements:
+ *  - value(src, b, block, base) : constant, first value or base of the pattern
+ *                                 of block b of the send buffer of 'src', with
+ *                                 the value functions of the tests (common.h)
+ *  - route(p, rank, src, b)     : block p received by 'rank' is block b of the
+ *                                 send buffer of 'src'
+ */
+typedef struct {
+    const char *key;        // Name in BIGCOUNT_SELFTEST_CASES
+    const char *tests;      // Tests that use the fill and verify logic
+    int kind;               // ST_*
+    bool send_block;        // The send buffer holds one block (the full count otherwise)
+    bool recv_block;        // The receive buffer holds one block (the full count otherwise)
+    int64_t (*value)(int src, int b, size_t block, int base);
+    void (*route)(int p, int rank, int *src, int *b);
+    bool enabled;
+} selftest_case_t;
+
+static int64_t bcast_block(int src, int b, size_t block, int base)
+{
+    return BCAST_FIRST + (int64_t)((size_t)b * block);
+}
+
+static void bcast_route(int p, int rank, int *src, int *b)
+{
+    *src = 0;
+    *b = p;
+}
+
+static int64_t gather_block(int src, int b, size_t block, int base)
+{
+    return gather_value(src, base);
+}
+
+static void gather_route(int p, int rank, int *src, int *b)
+{
+    *src = p;
+    *b = 0;
+}
+
+static int64_t scatter_block(int src, int b, size_t block, int base)
+{
+    return scatter_first(b, base);
+}
+
+static void scatter_route(int p, int rank, int *src, int *b)
+{
+    *src = 0;
+    *b = rank;
+}
+
+static int64_t alltoall_block(int src, int b, size_t block, int base)
+{
+    return alltoall_first(src, b, base);
+}
+
+static void alltoall_route(int p, int rank, int *src, int *b)
+{
+    *src = p;
+    *b = rank;
+}
+
+static int64_t alltoallv_block(int src, int b, size_t block, int base)
+{
+    return alltoallv_base(src);
+}
+
+/*
+ * Table of the self-test cases, in the order in which they run
+ */
+selftest_case_t selftest_cases[] = {
+    {"bcast",     "test_bcast", ST_LINEAR, false, false,
+     bcast_block,     bcast_route,    true},
+    {"gather",    "test_gather, test_allgather, test_gatherv, test_allgatherv", ST_CONSTANT, true, false,
+     gather_block,    gather_route,   true},
+    {"scatter",   "test_scatter", ST_LINEAR, false, true,
+     scatter_block,   scatter_route,  true},
+    {"alltoall",  "test_alltoall", ST_LINEAR, false, false,
+     alltoall_block,  alltoall_route, true},
+    {"alltoallv", "test_alltoallv, test_alltoallw", ST_PRIME, false, false,
+     alltoallv_block, alltoall_route, true},
+    {"reduce",    "test_allreduce, test_reduce, test_reduce_scatter(_block), test_scan, test_exscan", ST_REDUCE, false, false,
+     NULL,            NULL,           true}
+};
+#define NUM_SELFTEST_CASES (int)(sizeof(selftest_cases) / sizeof(selftest_cases[0]))
+
+/*
+ * Wall clock time in seconds
+ */
+static inline double selftest_wtime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+}
+
+/*
+ * Reduce two contributions of an op, as the MPI library would
+ *
+ * @param op reduction op
+ * @param a accumulated contribution
+ * @param b next contribution
+ * @return reduction of a and b
+ */
+static inline int64_t selftest_combine(const test_op_t *op, int64_t a, int64_t b)
+{
+    switch( op - test_ops ) {
+    case TO_MAX:    return (a > b) ? a : b;
+    case TO_MIN:    return (a < b) ? a : b;
+    case TO_PROD:   return a * b;
+    case TO_BAND:   return a & b;
+    case TO_BXOR:   return a ^ b;
+    case TO_MAXLOC:
+        // (value, loc): the larger value, the lower location on a tie
+        if( a % TEST_PAIR_LOC != b % TEST_PAIR_LOC ) {
+            return (a % TEST_PAIR_LOC > b % TEST_PAIR_LOC) ? a : b;
+        }
+        return (a / TEST_PAIR_LOC < b / TEST_PAIR_LOC) ? a : b;
+    default:        return a + b;
+    }
+}
+
+/*
+ * Fill one block with the pattern of the case, as the tests do
+ *
+ * @param buf first element of the block
+ * @param value constant, first value or base of the pattern (see selftest_case_t)
+ */
+static void selftest_fill_block(const selftest_case_t *sc, const test_type_t *tt, void *buf,
+                                size_t block, int64_t value)
+{
+    if( ST_CONSTANT == sc->kind ) {
+        fill_value(tt, buf, block, value);
+    } else if( ST_LINEAR == sc->kind ) {
+        fill_linear(tt, buf, block, value);
+    } else {
+        fill_prime_pattern(tt, buf, block, 0, 1, (int)value);
+    }
+}
+
+/*
+ * Check one block against the pattern of the case, as the tests do
+ *
+ * @param offset index of the first element of the block in buf
+ * @param first_bad lowered to the index in buf of the first mismatch
+ * @return number of mismatched elements in the block
+ */
+static size_t selftest_check_block(const selftest_case_t *sc, const test_type_t *tt, const void *buf,
+                                   size_t offset, size_t block, int64_t value, size_t *first_bad)
+{
+    size_t num_wrong, first = SIZE_MAX;
+
+    if( ST_CONSTANT == sc->kind ) {
+        return check_value(tt, buf, offset, block, value, first_bad);
+    } else if( ST_LINEAR == sc->kind ) {
+        return check_linear(tt, buf, offset, block, value, first_bad);
+    }
+    num_wrong = check_prime_pattern(tt, (const char*)buf + offset * tt->size, block, 0, 1,
+                                    (int)value, &first);
+    if( SIZE_MAX != first && offset + first < *first_bad ) {
+        *first_bad = offset + first;
+    }
+    return num_wrong;
+}
+
+/*
+ * Fill the buffers of one simulated process: its send buffer, and its
+ * receive buffer with -1 (as the tests do before the collective)
+ */
+static void selftest_fill(const selftest_case_t *sc, const test_type_t *tt, const test_op_t *op,
+                          void *send, size_t send_count, void *recv, size_t recv_count,
+                          int rank, size_t block)
+{
+    int b;
+
+    if( ST_REDUCE == sc->kind ) {
+        fill_op_input(tt, op, send, send_count, 0, rank);
+    } else {
+        for(b = 0; (size_t)b < send_count / block; ++b) {
+            selftest_fill_block(sc, tt, (char*)send + (size_t)b * block * tt->size, block,
+                                sc->value(rank, b, block, SELFTEST_BASE));
+        }
+    }
+    fill_value(tt, recv, recv_count, -1);
+}
+
+/*
+ * Compute the result of the collective at 'rank' locally: each received block
+ * is the block that its source filled
+ */
+static void selftest_simulate(const selftest_case_t *sc, const test_type_t *tt, const test_op_t *op,
+                              void *recv, size_t recv_count, int rank, size_t block)
+{
+    size_t i;
+    int src, b, p, r;
+    int64_t acc;
+
+    if( ST_REDUCE == sc->kind ) {
+        PARALLEL_FOR(private(r, acc))
+        for(i = 0; i < recv_count; ++i) {
+            acc = op->value(i, 0);
+            for(r = 1; r < selftest_np; ++r) {
+                acc = selftest_combine(op, acc, op->value(i, r));
+            }
+            tt->set(recv, i, acc);
+        }
+    } else {
+        for(p = 0; (size_t)p < recv_count / block; ++p) {
+            sc->route(p, rank, &src, &b);
+            selftest_fill_block(sc, tt, (char*)recv + (size_t)p * block * tt->size, block,
+                                sc->value(src, b, block, SELFTEST_BASE));
+        }
+    }
+}
+
+/*
+ * Check the result of the collective at 'rank' with the verify logic of the tests
+ *
+ * @param first_bad (OUT) index of the first mismatch (SIZE_MAX if none)
+ * @return number of mismatched elements
+ */
+static size_t selftest_verify(const selftest_case_t *sc, const test_type_t *tt, const test_op_t *op,
+                              const void *recv, size_t recv_count, int rank, size_t block,
+                              size_t *first_bad)
+{
+    size_t num_wrong = 0;
+    int src, b, p;
+
+    *first_bad = SIZE_MAX;
+    if( ST_REDUCE == sc->kind ) {
+        return check_op_result(tt, op, recv, recv_count, 0, selftest_np, first_bad);
+    }
+
+    for(p = 0; (size_t)p < recv_count / block; ++p) {
+        sc->route(p, rank, &src, &b);
+        num_wrong += selftest_check_block(sc, tt, recv, (size_t)p * block, block,
+                                          sc->value(src, b, block, SELFTEST_BASE), first_bad);
+    }
+    return num_wrong;
+}
+
+/*
+ * Value of an element of a block of the case (see selftest_fill_block)
+ *
+ * @param value constant, first value or base of the pattern of the block
+ * @param k index of the element in the block
+ * @return value of the element
+ */
+static int64_t selftest_block_element(const selftest_case_t *sc, int64_t value, size_t k)
+{
+    if( ST_CONSTANT == sc->kind ) {
+        return value;
+    } else if( ST_LINEAR == sc->kind ) {
+        return value + (int64_t)k;
+    }
+    return (int64_t)(k % PRIME_MODULUS) + value;
+}
+
+/*
+ * Run one self-test case on a datatype (and op): time the fill and verify
+ * kernels, then make sure that the verify logic catches a single wrong
+ * element.
+ *
+ * @return 0 on success
+ */
+static int selftest_run(const selftest_case_t *sc, const test_type_t *tt, const test_op_t *op)
+{
+    int rank = selftest_np - 1, iter, ret = 0;
+    size_t count, block, send_count, recv_count, num_wrong, first_bad, bad_index;
+    size_t max_bytes = (size_t)max_sys_mem_gb << 30;
+    double start, t_fill = 0.0, t_verify = 0.0, elapsed;
+    int64_t bad_value;
+    int src, b;
+    void *send, *recv;
+
+    // All simulated processes contribute one block of the largest buffer
+    count = tt->v_size;
+    if( max_sys_mem_gb > 0 && 2 * count * tt->size > max_bytes ) {
+        count = max_bytes / (2 * tt->size);
+        printf("Adjust count to fit in memory: %zu (%s)\n", count, human_bytes(max_bytes));
+    }
+    block = count / selftest_np;
+    count = block * selftest_np;
+    send_count = sc->send_block ? block : count;
+    recv_count = sc->recv_block ? block : count;
+    if( 0 == block ) {
+        return 0;
+    }
+
+    send = safe_malloc(send_count * tt->size);
+    recv = safe_malloc(recv_count * tt->size);
+
+    for(iter = 0; iter < selftest_iterations; ++iter) {
+        start = selftest_wtime();
+        selftest_fill(sc, tt, op, send, send_count, recv, recv_count, rank, block);
+        elapsed = selftest_wtime() - start;
+        t_fill = (0 == iter || elapsed < t_fill) ? elapsed : t_fill;
+    }
+
+    selftest_simulate(sc, tt, op, recv, recv_count, rank, block);
+
+    num_wrong = 0;
+    for(iter = 0; iter < selftest_iterations; ++iter) {
+        start = selftest_wtime();
+        num_wrong = selftest_verify(sc, tt, op, recv, recv_count, rank, block, &first_bad);
+        elapsed = selftest_wtime() - start;
+        t_verify = (0 == iter || elapsed < t_verify) ? elapsed : t_verify;
+    }
+    if( 0 != num_wrong ) {
+        printf("ERROR: %s(%s): %zu wrong elements, first at index %zu\n",
+               sc->key, tt->name, num_wrong, first_bad);
+        ret = 1;
+    }
+
+    // Negative check: one wrong element in the last block must be found
+    bad_index = recv_count - block / 2 - 1;
+    if( ST_REDUCE == sc->kind ) {
+        bad_value = op->expect(bad_index, selftest_np) + 1;
+    } else {
+        sc->route((int)(bad_index / block), rank, &src, &b);
+        bad_value = selftest_block_element(sc, sc->value(src, b, block, SELFTEST_BASE),
+                                           bad_index % block) + 1;
+    }
+    tt->set(recv, bad_index, bad_value);
+    num_wrong = selftest_verify(sc, tt, op, recv, recv_count, rank, block, &first_bad);
+    if( 1 != num_wrong || bad_index != first_bad ) {
+        printf("ERROR: %s(%s): wrong element at index %zu not detected (%zu wrong, first at index %zu)\n",
+               sc->key, tt->name, bad_index, num_wrong, first_bad);
+        ret = 1;
+    }
+
+    printf("%-10s %-17s %-10s %13zu %10.6f %10.3f %10.6f %10.3f  %s\n",
+           sc->key, tt->name, (NULL != op) ? op->name : "-", count,
+           t_fill, (t_fill > 0.0) ? (send_count + recv_count) * tt->size / t_fill / 1.0e9 : 0.0,
+           t_verify, (t_verify > 0.0) ? recv_count * tt->size / t_verify / 1.0e9 : 0.0,
+           (0 == ret) ? "PASSED" : "FAILED");
+    fflush(NULL);
+
+    safe_free(send);
+    safe_free(recv);
+
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    int ret = 0, c, t, o;
+    char *env_str = NULL;
+
+    init_environment(argc, argv);
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SELFTEST_NP")) ) {
+        selftest_np = (int)strtol(env_str, NULL, 10);
+        if( selftest_np < 1 ) {
+            selftest_np = 1;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SELFTEST_ITERATIONS")) ) {
+        selftest_iterations = (int)strtol(env_str, NULL, 10);
+        if( selftest_iterations < 1 ) {
+            selftest_iterations = 1;
+        }
+    }
+
+    if( NULL != (env_str = getenv("BIGCOUNT_SELFTEST_CASES")) && 0 != strcasecmp(env_str, "all") ) {
+        char *cases = strdup(env_str), *saveptr = NULL, *tok;
+        bool found;
+        for(c = 0; c < NUM_SELFTEST_CASES; ++c) {
+            selftest_cases[c].enabled = false;
+        }
+        for( tok = strtok_r(cases, ",", &saveptr); NULL != tok; tok = strtok_r(NULL, ",", &saveptr) ) {
+            found = false;
+            for(c = 0; c < NUM_SELFTEST_CASES; ++c) {
+                if( 0 == strcasecmp(tok, selftest_cases[c].key) ) {
+                    selftest_cases[c].enabled = found = true;
+                }
+            }
+            if( !found ) {
+                printf("Warning: Unknown BIGCOUNT_SELFTEST_CASES case '%s'\n", tok);
+            }
+        }
+        free(cases);
+    }
+
+    printf("Self-test of the fill/verify kernels: %d simulated processes, %d thread%s, %d iteration%s\n",
+           selftest_np, fill_threads, (1 == fill_threads) ? "" : "s",
+           selftest_iterations, (1 == selftest_iterations) ? "" : "s");
+    printf("%-10s %-17s %-10s %13s %10s %10s %10s %10s  %s\n",
+           "Case", "Datatype", "Op", "Count", "Fill (s)", "Fill GB/s", "Verify (s)", "Verify GB/s", "Result");
+
+    for(c = 0; c < NUM_SELFTEST_CASES; ++c) {
+        if( !selftest_cases[c].enabled ) {
+            continue;
+        }
+        if( ST_REDUCE != selftest_cases[c].kind ) {
+            for(t = 0; t < NUM_TEST_TYPES; ++t) {
+                if( test_types[t].enabled ) {
+                    ret += selftest_run(&selftest_cases[c], &test_types[t], NULL);
+                }
+            }
+            continue;
+        }
+        // Each enabled op (BIGCOUNT_OPS) on the datatypes it applies to
+        for(o = 0; o < NUM_TEST_OPS; ++o) {
+            if( !test_ops[o].enabled ) {
+                continue;
+            }
+            for(t = 0; t < NUM_TEST_TYPES; ++t) {
+                if( op_runs_on(&test_ops[o], &test_types[t]) ) {
+                    ret += selftest_run(&selftest_cases[c], &test_types[t], &test_ops[o]);
+                }
+            }
+        }
+    }
+
+    printf("---------------------\n");
+    printf("Self-test: %s (%d failed case%s)\n", (0 == ret) ? "PASSED" : "FAILED",
+           ret, (1 == ret) ? "" : "s");
+
+    return (0 == ret) ? 0 : 1;
+}
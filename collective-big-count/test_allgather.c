@@ -9,9 +9,12 @@
 
 #include <mpi.h>
 #include "common.h"
+#include "reference.h"
 
 int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool in_place,
-                   bool blocking);
+                   int variant);
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
 
 int main(int argc, char** argv) {
     /*
@@ -22,37 +25,8 @@ int main(int argc, char** argv) {
     MPI_Init(NULL, NULL);
     init_environment(argc, argv);
 
-    // Run the tests
-#ifndef TEST_UNIFORM_COUNT
-    // Each rank contribues: V_SIZE_INT / world_size elements
-    // Largest buffer is   : V_SIZE_INT elements
-    ret += my_c_test_core(MPI_INT, V_SIZE_INT, false, true);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, false, true);
-    if (allow_nonblocked) {
-        ret += my_c_test_core(MPI_INT, V_SIZE_INT, false, false);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, false, false);
-    }
-#else
-    size_t proposed_count;
-
-    // Each rank contribues: TEST_UNIFORM_COUNT elements
-    // Largest buffer is   : TEST_UNIFORM_COUNT x world_size
-    proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                        (size_t)world_size, (size_t)world_size);
-    ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, true, true);
-    proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                        (size_t)world_size, (size_t)world_size);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, true, true);
-    if (allow_nonblocked) {
-        proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                            (size_t)world_size, (size_t)world_size);
-        ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, true, false);
-        proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                            (size_t)world_size, (size_t)world_size);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, true,
-                              false);
-    }
-#endif
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes_inter(run_tests);
 
     /*
      * All done
@@ -61,10 +35,49 @@ int main(int argc, char** argv) {
     return ret;
 }
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool in_place, bool blocking)
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count;
+    bool in_place;
+
+    if( sweep_enabled ) {
+        return run_sweep("allgather", (size_t)world_size, sweep_case);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+#ifndef TEST_UNIFORM_COUNT
+            // Each rank contribues: V_SIZE / world_size elements
+            // Largest buffer is   : V_SIZE elements
+            count = test_types[t].v_size;
+            in_place = false;
+#else
+            // Each rank contribues: TEST_UNIFORM_COUNT elements
+            // Largest buffer is   : TEST_UNIFORM_COUNT x world_size
+            count = calc_coll_count("allgather", test_types[t].size, TEST_UNIFORM_COUNT) * (size_t)world_size;
+            in_place = true;
+#endif
+            ret += my_c_test_core(test_types[t].dtype, count, in_place, v);
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool in_place, int variant)
 {
     int ret = 0;
-    size_t i;
 
     // Actual payload size as divisible by the sizeof(dt)
     size_t payload_size_actual;
@@ -72,145 +85,146 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool in_place,
     /*
      * Initialize vector
      */
-    int *my_int_send_vector = NULL;
-    int *my_int_recv_vector = NULL;
-    double _Complex *my_dc_send_vector = NULL;
-    double _Complex *my_dc_recv_vector = NULL;
+    void *my_send_vector = NULL;
+    void *my_recv_vector = NULL;
     size_t recv_count = 0;
     size_t send_count = 0;
-    int exp;
+    int p;
     size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
     MPI_Request request;
-    char *mpi_function = blocking ? "MPI_Allgather" : "MPI_Iallgather";
-
-    assert(MPI_INT == dtype || MPI_C_DOUBLE_COMPLEX == dtype);
-
-    send_count = recv_count = total_num_elements / (size_t)world_size;
-    // total_num_elements must be a multiple of world_size. Drop any remainder
-    total_num_elements = send_count * (size_t)world_size;
+    coll_timer_t timer;
+    coll_comm_t cc;
+    const test_type_t *tt = find_test_type(dtype);
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Allgather" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Iallgather" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Allgather_init" : "ref_allgather";
+
+    if( journal_start(dtype, &total_num_elements, 0, in_place, variant, &ret) ) {
+        return ret;
+    }
 
-    if( MPI_INT == dtype ) {
-        payload_size_actual = total_num_elements * sizeof(int);
-        my_int_recv_vector = (int*)safe_malloc(payload_size_actual);
-        if( !in_place ) {
-            my_int_send_vector = (int*)safe_malloc(send_count * sizeof(int));
-        }
-    } else {
-        payload_size_actual = total_num_elements * sizeof(double _Complex);
-        my_dc_recv_vector = (double _Complex*)safe_malloc(payload_size_actual);
-        if( !in_place ) {
-            my_dc_send_vector = (double _Complex*)safe_malloc(send_count * sizeof(double _Complex));
-        }
+    coll_comm_init(&cc);
+    // MPI_IN_PLACE is not valid on an intercommunicator
+    if( cc.inter ) {
+        in_place = false;
+    }
+    send_count = recv_count = total_num_elements / (size_t)cc.blocks;
+    // total_num_elements must be a multiple of cc.blocks. Drop any remainder,
+    // one block is received from each peer
+    total_num_elements = send_count * (size_t)cc.peers;
+
+    payload_size_actual = total_num_elements * tt->size;
+    my_recv_vector = safe_malloc(payload_size_actual);
+    if( !in_place ) {
+        my_send_vector = safe_malloc(send_count * tt->size);
     }
 
     if( in_place ) {
-        for(i = 0; i < total_num_elements; ++i) {
-            exp = 1 + world_rank;
-            if( MPI_INT == dtype ) {
-                if( (i / (size_t)send_count) == world_rank ) {
-                    my_int_recv_vector[i] = exp;
-                } else {
-                    my_int_recv_vector[i] = -1;
-                }
-            } else {
-                if( (i / (size_t)send_count) == world_rank ) {
-                    my_dc_recv_vector[i] = 1.0*exp - 1.0*exp*I;
-                } else {
-                    my_dc_recv_vector[i] = 1.0 + 1.0*I;
-                }
-            }
-        }
+        fill_value(tt, my_recv_vector, total_num_elements, -1);
+        fill_value(tt, (char*)my_recv_vector + (size_t)world_rank * send_count * tt->size, send_count,
+                   gather_value(world_rank, 0));
     } else {
-        for(i = 0; i < send_count; ++i) {
-            exp = 1 + world_rank;
-            if( MPI_INT == dtype ) {
-                my_int_send_vector[i] = exp;
-            } else {
-                my_dc_send_vector[i] = 1.0*exp - 1.0*exp*I;
-            }
-        }
-        for(i = 0; i < total_num_elements; ++i) {
-            if( MPI_INT == dtype ) {
-                my_int_recv_vector[i] = -1;
-            } else {
-                my_dc_recv_vector[i] = 1.0 + 1.0*I;
-            }
-        }
+        fill_value(tt, my_send_vector, send_count, gather_value(cc.rank, cc.send_base));
+        fill_value(tt, my_recv_vector, total_num_elements, -1);
     }
 
     if (world_rank == 0) {
         printf("---------------------\nResults from %s(%s x %zu = %zu or %s): %s\n",
-               mpi_function, (MPI_INT == dtype ? "int" : "double _Complex"),
+               mpi_function, tt->name,
                total_num_elements, payload_size_actual, human_bytes(payload_size_actual),
                ((in_place) ? " MPI_IN_PLACE" : ""));
     }
     if(!in_place) {
-        assert(send_count <= INT_MAX);
+        assert(send_count <= TEST_COUNT_MAX);
     }
-    assert(recv_count <= INT_MAX);
-    if (blocking) {
-        if( MPI_INT == dtype ) {
-            MPI_Allgather(in_place ? MPI_IN_PLACE : my_int_send_vector, (int)send_count, dtype,
-                          my_int_recv_vector, (int)recv_count, dtype,
-                          MPI_COMM_WORLD);
-        } else {
-            MPI_Allgather(in_place ? MPI_IN_PLACE : my_dc_send_vector, (int)send_count, dtype,
-                          my_dc_recv_vector, (int)recv_count, dtype,
-                          MPI_COMM_WORLD);
-        }
-    }
-    else {
-        if( MPI_INT == dtype ) {
-            MPI_Iallgather(in_place ? MPI_IN_PLACE : my_int_send_vector, (int)send_count, dtype,
-                          my_int_recv_vector, (int)recv_count, dtype,
-                          MPI_COMM_WORLD, &request);
-        } else {
-            MPI_Iallgather(in_place ? MPI_IN_PLACE : my_dc_send_vector, (int)send_count, dtype,
-                          my_dc_recv_vector, (int)recv_count, dtype,
-                          MPI_COMM_WORLD, &request);
-        }
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
+    assert(recv_count <= TEST_COUNT_MAX);
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Allgather)(in_place ? MPI_IN_PLACE : my_send_vector, (test_count_t)send_count, dtype,
+                             my_recv_vector, (test_count_t)recv_count, dtype,
+                             cc.comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
     }
-
-    /*
-     * Check results.
-     */
-    exp = 0;
-    for(i = 0; i < total_num_elements; ++i) {
-        exp = (int)(1 + (i / (size_t)recv_count));
-        if( MPI_INT == dtype ) {
-            if(my_int_recv_vector[i] != exp) {
-                ++num_wrong;
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) ) {
+            if( in_place ) {
+                fill_value(tt, my_recv_vector, (size_t)world_rank * send_count, -1);
+                fill_value(tt, (char*)my_recv_vector + ((size_t)world_rank + 1) * send_count * tt->size,
+                           total_num_elements - ((size_t)world_rank + 1) * send_count, -1);
+            } else {
+                fill_value(tt, my_recv_vector, total_num_elements, -1);
             }
-        } else {
-            if(my_dc_recv_vector[i] != 1.0*exp - 1.0*exp*I) {
-                ++num_wrong;
+        }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Allgather)(in_place ? MPI_IN_PLACE : my_send_vector, (test_count_t)send_count, dtype,
+                                    my_recv_vector, (test_count_t)recv_count, dtype,
+                                    cc.comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Iallgather)(in_place ? MPI_IN_PLACE : my_send_vector, (test_count_t)send_count, dtype,
+                                    my_recv_vector, (test_count_t)recv_count, dtype,
+                                    cc.comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_allgather(in_place ? MPI_IN_PLACE : my_send_vector, (test_count_t)send_count, dtype,
+                          my_recv_vector, (test_count_t)recv_count, dtype,
+                          cc.comm);
+        }
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         */
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            // Block p holds the constant value of peer p
+            for(p = 0; p < cc.peers; ++p) {
+                num_wrong += check_value(tt, my_recv_vector, (size_t)p * recv_count, recv_count,
+                                         gather_value(p, cc.recv_base), &first_bad);
             }
         }
     }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, payload_size_actual);
 
     if( 0 == num_wrong) {
         printf("Rank %2d: PASSED\n", world_rank);
     } else {
         printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
                num_wrong, total_num_elements, ((num_wrong * 1.0)/total_num_elements)*100.0);
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
         ret = 1;
     }
 
-    if( NULL != my_int_send_vector ) {
-        free(my_int_send_vector);
-    }
-    if( NULL != my_int_recv_vector ){
-        free(my_int_recv_vector);
-    }
-    if( NULL != my_dc_send_vector ) {
-        free(my_dc_send_vector);
+    record_result(mpi_function, dtype, total_num_elements, payload_size_actual,
+                  variant, 0, in_place, num_wrong, &timer);
+
+    if( NULL != my_send_vector ) {
+        safe_free(my_send_vector);
     }
-    if( NULL != my_dc_recv_vector ){
-        free(my_dc_recv_vector);
+    if( NULL != my_recv_vector ){
+        safe_free(my_recv_vector);
     }
     fflush(NULL);
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(test_comm);
 
     return ret;
 }
+
+/*
+ * Run one payload size of the sweep (see run_sweep)
+ */
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant)
+{
+    return my_c_test_core(dtype, total_num_elements, false, variant);
+}
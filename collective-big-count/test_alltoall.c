@@ -9,8 +9,10 @@
 
 #include <mpi.h>
 #include "common.h"
+#include "reference.h"
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking);
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
 
 int main(int argc, char** argv) {
     /*
@@ -21,41 +23,8 @@ int main(int argc, char** argv) {
     MPI_Init(NULL, NULL);
     init_environment(argc, argv);
 
-#ifndef TEST_UNIFORM_COUNT
-    // Buffer size: 2 GB
-    // V_SIZE_INT tells us how many elements are needed to reach 2GB payload
-    // Each rank will send/recv a count of V_SIZE_INT / world_size
-    // The function will try to get as close to that as possible.
-    //
-    // Each rank contribues: V_SIZE_INT / world_size elements
-    // Largest buffer is   : V_SIZE_INT elements
-    ret += my_c_test_core(MPI_INT, V_SIZE_INT, true);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, true);
-    if (allow_nonblocked) {
-        ret += my_c_test_core(MPI_INT, V_SIZE_INT, false);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, false);
-    }
-#else
-    size_t proposed_count;
-
-    // Each rank contribues: TEST_UNIFORM_COUNT elements
-    // Largest buffer is   : TEST_UNIFORM_COUNT x world_size
-    proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                        (size_t)world_size, (size_t)world_size);
-    ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, true);
-
-    proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                        (size_t)world_size, (size_t)world_size);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, true);
-    if (allow_nonblocked) {
-        proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                            (size_t)world_size, (size_t)world_size);
-        ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, false);
-        proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                            (size_t)world_size, (size_t)world_size);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, false);
-    }
-#endif
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes_inter(run_tests);
 
     /*
      * All done
@@ -64,10 +33,46 @@ int main(int argc, char** argv) {
     return ret;
 }
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count;
+
+    if( sweep_enabled ) {
+        return run_sweep("alltoall", (size_t)world_size, my_c_test_core);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+#ifndef TEST_UNIFORM_COUNT
+            // Each rank contribues: V_SIZE / world_size elements
+            // Largest buffer is   : V_SIZE elements
+            count = test_types[t].v_size;
+#else
+            // Each rank contribues: TEST_UNIFORM_COUNT elements
+            // Largest buffer is   : TEST_UNIFORM_COUNT x world_size
+            count = calc_coll_count("alltoall", test_types[t].size, TEST_UNIFORM_COUNT) * (size_t)world_size;
+#endif
+            ret += my_c_test_core(test_types[t].dtype, count, v);
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant)
 {
     int ret = 0;
-    size_t i;
 
     // Actual payload size as divisible by the sizeof(dt)
     size_t payload_size_actual;
@@ -75,114 +80,128 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
     /*
      * Initialize vector
      */
-    int *my_int_recv_vector = NULL;
-    int *my_int_send_vector = NULL;
-    double _Complex *my_dc_recv_vector = NULL;
-    double _Complex *my_dc_send_vector = NULL;
+    void *my_recv_vector = NULL;
+    void *my_send_vector = NULL;
+    void *send_arg = MPI_IN_PLACE;
+    void *input;
     size_t recv_count = 0;
     size_t send_count = 0;
-    int exp;
+    int p;
     size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
     MPI_Request request;
-    char *mpi_function = blocking ? "MPI_Alltoall" : "MPI_Ialltoall";
-
-    assert(MPI_INT == dtype || MPI_C_DOUBLE_COMPLEX == dtype);
-
-    send_count = recv_count = total_num_elements / (size_t)world_size;
-    // total_num_elements must be a multiple of world_size. Drop any remainder
-    total_num_elements = send_count * (size_t)world_size;
-
-    if( MPI_INT == dtype ) {
-        payload_size_actual = total_num_elements * sizeof(int);
-        my_int_recv_vector = (int*)safe_malloc(payload_size_actual);
-        //my_int_send_vector = (int*)safe_malloc(payload_size_actual);
-    } else {
-        payload_size_actual = total_num_elements * sizeof(double _Complex);
-        my_dc_recv_vector = (double _Complex*)safe_malloc(payload_size_actual);
-        //my_dc_send_vector = (double _Complex*)safe_malloc(payload_size_actual);
+    coll_timer_t timer;
+    coll_comm_t cc;
+    const test_type_t *tt = find_test_type(dtype);
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Alltoall" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ialltoall" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Alltoall_init" : "ref_alltoall";
+
+    if( journal_start(dtype, &total_num_elements, 0, false, variant, &ret) ) {
+        return ret;
     }
 
-    for(i = 0; i < total_num_elements; ++i) {
-        exp = (int)((i / (size_t)recv_count) + ((world_rank+1)*2) + (i % (size_t)recv_count));
-        if( MPI_INT == dtype ) {
-            my_int_recv_vector[i] = exp;
-        } else {
-            my_dc_recv_vector[i] = 1.0*exp - 1.0*exp*I;
-        }
+    coll_comm_init(&cc);
+    send_count = recv_count = total_num_elements / (size_t)cc.blocks;
+    // total_num_elements must be a multiple of cc.blocks. Drop any remainder,
+    // one block is exchanged with each peer
+    total_num_elements = send_count * (size_t)cc.peers;
+
+    payload_size_actual = total_num_elements * tt->size;
+    my_recv_vector = safe_malloc(payload_size_actual);
+    input = my_recv_vector;
+    // MPI_IN_PLACE is not valid on an intercommunicator
+    if( cc.inter ) {
+        my_send_vector = safe_malloc(payload_size_actual);
+        input = send_arg = my_send_vector;
     }
 
     if (world_rank == 0) {
-        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): MPI_IN_PLACE\n",
-               mpi_function, (MPI_INT == dtype ? "int" : "double _Complex"),
-               total_num_elements, payload_size_actual, human_bytes(payload_size_actual));
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): %s\n",
+               mpi_function, tt->name,
+               total_num_elements, payload_size_actual, human_bytes(payload_size_actual),
+               cc.inter ? "" : "MPI_IN_PLACE");
     }
-    assert(send_count <= INT_MAX);
-    assert(recv_count <= INT_MAX);
-    if (blocking) {
-        if( MPI_INT == dtype ) {
-            MPI_Alltoall(MPI_IN_PLACE,       (int)send_count, dtype,
-                         my_int_recv_vector, (int)recv_count, dtype,
-                         MPI_COMM_WORLD);
-        } else {
-            MPI_Alltoall(MPI_IN_PLACE,       (int)send_count, dtype,
-                         my_dc_recv_vector,  (int)recv_count, dtype,
-                         MPI_COMM_WORLD);
-        }
+    assert(send_count <= TEST_COUNT_MAX);
+    assert(recv_count <= TEST_COUNT_MAX);
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Alltoall)(send_arg,       (test_count_t)send_count, dtype,
+                            my_recv_vector, (test_count_t)recv_count, dtype,
+                            cc.comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
     }
-    else {
-        if( MPI_INT == dtype ) {
-            MPI_Ialltoall(MPI_IN_PLACE,       (int)send_count, dtype,
-                          my_int_recv_vector, (int)recv_count, dtype,
-                          MPI_COMM_WORLD, &request);
-        } else {
-            MPI_Ialltoall(MPI_IN_PLACE,       (int)send_count, dtype,
-                          my_dc_recv_vector,  (int)recv_count, dtype,
-                          MPI_COMM_WORLD, &request);
+    while( timer_more(&timer) ) {
+        // MPI_IN_PLACE overwrites the input so reset it for every iteration
+        for(p = 0; p < cc.peers; ++p) {
+            fill_linear(tt, (char*)input + (size_t)p * send_count * tt->size, send_count,
+                        alltoall_first(cc.rank, p, cc.send_base));
         }
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
-    }
-
-    /*
-     * Check results.
-     */
-    exp = 0;
-    for(i = 0; i < total_num_elements; ++i) {
-        // Dest_Rank + Src_Rank + counter
-        exp = (int)( (((i / (size_t)recv_count)+1)*2) + world_rank + (i % (size_t)recv_count));
-        if( MPI_INT == dtype ) {
-            if(my_int_recv_vector[i] != exp) {
-                ++num_wrong;
-            }
-        } else {
-            if(my_dc_recv_vector[i] != 1.0*exp - 1.0*exp*I) {
-                ++num_wrong;
+        // Without MPI_IN_PLACE poison the output of the previous iteration
+        if( cc.inter ) {
+            fill_value(tt, my_recv_vector, total_num_elements, -1);
+        }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Alltoall)(send_arg,       (test_count_t)send_count, dtype,
+                                   my_recv_vector, (test_count_t)recv_count, dtype,
+                                   cc.comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ialltoall)(send_arg,       (test_count_t)send_count, dtype,
+                                    my_recv_vector, (test_count_t)recv_count, dtype,
+                                    cc.comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_alltoall(send_arg,       (test_count_t)send_count, dtype,
+                         my_recv_vector, (test_count_t)recv_count, dtype,
+                         cc.comm);
+        }
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         */
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            for(p = 0; p < cc.peers; ++p) {
+                // Dest_Rank + Src_Rank + counter
+                num_wrong += check_linear(tt, my_recv_vector, (size_t)p * recv_count, recv_count,
+                                          alltoall_first(p, cc.rank, cc.recv_base), &first_bad);
             }
         }
     }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, payload_size_actual);
 
     if( 0 == num_wrong) {
         printf("Rank %2d: PASSED\n", world_rank);
     } else {
         printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
                num_wrong, recv_count, ((num_wrong * 1.0)/recv_count)*100.0);
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
         ret = 1;
     }
 
-    if( NULL != my_int_send_vector ) {
-        free(my_int_send_vector);
-    }
-    if( NULL != my_int_recv_vector ){
-        free(my_int_recv_vector);
-    }
-    if( NULL != my_dc_send_vector ) {
-        free(my_dc_send_vector);
+    record_result(mpi_function, dtype, total_num_elements, payload_size_actual,
+                  variant, 0, !cc.inter, num_wrong, &timer);
+
+    if( NULL != my_send_vector ) {
+        safe_free(my_send_vector);
     }
-    if( NULL != my_dc_recv_vector ){
-        free(my_dc_recv_vector);
+    if( NULL != my_recv_vector ){
+        safe_free(my_recv_vector);
     }
 
     fflush(NULL);
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(test_comm);
 
     return ret;
 }
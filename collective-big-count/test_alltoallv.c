@@ -9,8 +9,11 @@
 
 #include <mpi.h>
 #include "common.h"
+#include "reference.h"
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking);
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool in_place, int variant);
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
 
 int main(int argc, char** argv) {
     // Initialize the MPI environment
@@ -19,78 +22,118 @@ int main(int argc, char** argv) {
     MPI_Init(NULL, NULL);
     init_environment(argc, argv);
 
-    // Run the tests
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes(run_tests);
+
+    /*
+     * All done
+     */
+    MPI_Finalize();
+    return ret;
+}
+
+/*
+ * Packed count of a datatype (as passed to my_c_test_core)
+ */
+static size_t packed_count(const test_type_t *tt)
+{
 #ifndef TEST_UNIFORM_COUNT
-    // Buffer size: 2 GB
-    // V_SIZE_INT tells us how many elements are needed to reach 2GB payload
-    // Each rank will send/recv a count of V_SIZE_INT / world_size
-    // The function will try to get as close to that as possible.
-    //
-    // Each rank contribues: V_SIZE_INT / world_size elements
-    // Largest buffer is   : V_SIZE_INT elements
-    ret += my_c_test_core(MPI_INT, V_SIZE_INT, true);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, true);
-    if (allow_nonblocked) {
-        ret += my_c_test_core(MPI_INT, V_SIZE_INT, false);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, false);
-    }
+    // Each rank contribues: V_SIZE / world_size elements
+    // Largest buffer is   : V_SIZE elements
+    return tt->v_size;
 #else
-    size_t proposed_count;
-
     // Each rank contribues: TEST_UNIFORM_COUNT elements
     // Largest buffer is   : TEST_UNIFORM_COUNT x world_size
-    proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                        (size_t)world_size, (size_t)world_size);
-    ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, true);
+    return calc_coll_count("alltoallv", tt->size, TEST_UNIFORM_COUNT) * (size_t)world_size;
+#endif
+}
+
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count, skip_count;
 
-    proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                        (size_t)world_size, (size_t)world_size);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, true);
-    if (allow_nonblocked) {
-        proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                            (size_t)world_size, (size_t)world_size);
-        ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, false);
-        proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                            (size_t)world_size, (size_t)world_size);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, false);
+    if( sweep_enabled ) {
+        return run_sweep("alltoallv", (size_t)world_size, sweep_case);
+    }
+    if( num_strides > 0 ) {
+        return run_stride_sweep("alltoallv", packed_count(&test_types[sweep_type]), my_c_test_core);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+            count = packed_count(&test_types[t]);
+            // Adjust these to be V_SIZE - displacement strides so it will pass
+            skip_count = count - disp_stride*world_size;
+            ret += my_c_test_core(test_types[t].dtype, count, MODE_PACKED, false, v);
+            ret += my_c_test_core(test_types[t].dtype, skip_count, MODE_SKIP, false, v);
+        }
     }
-#endif
 
-    /*
-     * All done
-     */
-    MPI_Finalize();
     return ret;
 }
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
+/*
+ * Poison the receive buffer, then initialize the blocks of data to be sent to
+ * each rank to a unique range of values using array index modulo prime and
+ * offset by prime * rank
+ */
+static void fill_buffers(const test_type_t *tt, void *recv_vector, size_t recv_total,
+                         void *send_vector, const test_count_t *send_counts,
+                         const test_disp_t *send_offsets)
+{
+    size_t i;
+
+    fill_value(tt, recv_vector, recv_total, -1);
+    for (i = 0; i < world_size; ++i) {
+        fill_prime_pattern(tt, (char*)send_vector + (size_t)send_offsets[i] * tt->size,
+                           (size_t)send_counts[i], 0, 1, alltoallv_base(world_rank));
+    }
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool in_place, int variant)
 {
     int ret = 0;
     size_t i;
-    size_t j;
 
     // Actual payload size as divisible by the sizeof(dt)
     size_t payload_size_actual;
-    size_t excess_size_actual;
 
-    int *my_int_recv_vector = NULL;
-    int *my_int_send_vector = NULL;
-    double _Complex *my_dc_recv_vector = NULL;
-    double _Complex *my_dc_send_vector = NULL;
+    void *my_recv_vector = NULL;
+    void *my_send_vector = NULL;
+    void *send_vector = NULL;
+    void *send_arg = NULL;
     MPI_Request request;
-    int exp;
-    size_t num_wrong;
+    coll_timer_t timer;
+    const test_type_t *tt = find_test_type(dtype);
+    size_t num_wrong = 0;
+    size_t seg_wrong, seg_first_bad, first_bad = SIZE_MAX;
     int excess_count;
-    size_t current_base;
-    int receive_counts[world_size];
-    int receive_offsets[world_size];
-    int send_counts[world_size];
-    int send_offsets[world_size];
-    char *mpi_function = blocking ? "MPI_Alltoallv" : "MPI_Ialltoallv";
+    size_t current_base, send_total, recv_total;
+    test_count_t receive_counts[world_size];
+    test_disp_t receive_offsets[world_size];
+    test_count_t send_counts[world_size];
+    test_disp_t send_offsets[world_size];
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Alltoallv" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ialltoallv" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Alltoallv_init" : "ref_alltoallv";
+
+    if( journal_start(dtype, &total_num_elements, mode, in_place, variant, &ret) ) {
+        return ret;
+    }
 
-    assert(MPI_INT == dtype || MPI_C_DOUBLE_COMPLEX == dtype);
-    if (total_num_elements > INT_MAX) {
-        total_num_elements = INT_MAX;
+    if (total_num_elements > TEST_COUNT_MAX) {
+        total_num_elements = TEST_COUNT_MAX;
     }
 
     // Force unequal distribution of data across ranks
@@ -100,10 +143,10 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
     excess_count = total_num_elements % world_size;
 
     // The value of total_num_elements passed to this function should not exceed
-    // INT_MAX. By adding an extra element to force unequal distribution,
-    // total_num_elements may exceed INT_MAX so the value must be adjusted
+    // TEST_COUNT_MAX. By adding an extra element to force unequal distribution,
+    // total_num_elements may exceed TEST_COUNT_MAX so the value must be adjusted
     // downward.
-    if ((total_num_elements + excess_count) > INT_MAX) {
+    if ((total_num_elements + excess_count) > TEST_COUNT_MAX) {
         total_num_elements = total_num_elements - world_size;
     }
 
@@ -112,142 +155,135 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
     // data plus the excess (total_num_elements % world_size) to the
     // highest rank. All ranks must receive exactly the number of elements
     // they were sent.
-    current_base = 0;
+    // With MPI_IN_PLACE the data sent to a rank has the layout of the data
+    // received from it, so the counts must be symmetric: the highest rank
+    // also sends the excess to all ranks.
+    // Packed: the segments are tightly packed
+    // Skip  : 'disp_stride' elements are skipped before each segment
+    //         making a small gap (left untouched)
+    send_total = 0;
+    recv_total = 0;
     for (i = 0; i < world_size; i++) {
+        if( MODE_SKIP == mode ) {
+            send_total += disp_stride;
+            recv_total += disp_stride;
+        }
         send_counts[i] = total_num_elements / world_size;
+        if (i == (world_size - 1) || (in_place && world_rank == (world_size - 1))) {
+            send_counts[i] += excess_count;
+        }
         receive_counts[i] = total_num_elements / world_size;
-        send_offsets[i] = current_base;
-        receive_offsets[i] = current_base;
-        current_base = current_base + send_counts[i];
-    }
-    send_counts[world_size - 1] += excess_count;
-
-    // Since the highest rank receives excess elements due to unequal distribution,
-    // the receive counts and receive offsets need to be adjusted by that count.
-    if (world_rank == (world_size - 1)) {
-        current_base = 0;
-        for (i = 0; i < world_size; i++) {
-            receive_offsets[i] = current_base;
-            receive_counts[i] = (total_num_elements / world_size) + excess_count;
-            current_base = current_base + receive_counts[i];
+        if (world_rank == (world_size - 1) || (in_place && i == (world_size - 1))) {
+            receive_counts[i] += excess_count;
         }
+        send_offsets[i] = send_total;
+        receive_offsets[i] = recv_total;
+        send_total += send_counts[i];
+        recv_total += receive_counts[i];
     }
-
-    // Allocate send and receive buffers. The send buffer for each rank is
-    // allocated to hold the total_num_elements sent to all ranks. Since
-    // total_num_elements is forced to a value not evenly divisible by the
-    // world_size, and the excess elements are sent by each rank to the last
-    // rank, the receive buffer for the last rank must be larger than the
-    // send buffer by excess_count * world_size. For the other ranks, allocating
-    // send and receive buffers identically is sufficient.
-    if( MPI_INT == dtype ) {
-        payload_size_actual = total_num_elements * sizeof(int);
-        if (world_rank == (world_size - 1)) {
-            excess_size_actual = world_size * excess_count * sizeof(int);
-            my_int_recv_vector = (int*)safe_malloc(payload_size_actual +
-                                                   excess_size_actual);
-        }
-        else {
-            my_int_recv_vector = (int*)safe_malloc(payload_size_actual);
-        }
-        my_int_send_vector = (int*)safe_malloc(payload_size_actual);
-    } else {
-        payload_size_actual = total_num_elements * sizeof(double _Complex);
-        if (world_rank == (world_size - 1)) {
-            excess_size_actual = world_size * excess_count * sizeof(double _Complex);
-            my_dc_recv_vector = (double _Complex*)safe_malloc(payload_size_actual +
-                                                  excess_size_actual);
-        }
-        else {
-            my_dc_recv_vector = (double _Complex*)safe_malloc(payload_size_actual);
-        }
-        my_dc_send_vector = (double _Complex*)safe_malloc(payload_size_actual);
+    if( MODE_SKIP == mode ) {
+        total_num_elements += disp_stride * (size_t)world_size;
     }
+    assert(send_total <= TEST_COUNT_MAX && recv_total <= TEST_COUNT_MAX);
 
-    // Initialize blocks of data to be sent to each rank to a unique range of values
-    // using array index modulo prime and offset by prime * rank
-    if (MPI_INT == dtype) {
-        for (i = 0; i < world_size; ++i) {
-            for (j = 0; j < send_counts[i]; j++) {
-                exp = (j % PRIME_MODULUS) + (PRIME_MODULUS * world_rank);
-                my_int_send_vector[j + send_offsets[i]] = exp;
-            }
-        }
+    // Allocate send and receive buffers. Since total_num_elements is forced
+    // to a value not evenly divisible by the world_size, and the excess
+    // elements are sent by each rank to the last rank, the receive buffer
+    // for the last rank is larger than the send buffer by excess_count *
+    // world_size. With MPI_IN_PLACE the data to send is taken from the
+    // receive buffer.
+    payload_size_actual = total_num_elements * tt->size;
+    my_recv_vector = safe_malloc(recv_total * tt->size);
+    if( !in_place ) {
+        my_send_vector = safe_malloc(send_total * tt->size);
     }
-    else {
-        for (i = 0; i < world_size; ++i) {
-            for (j = 0; j < send_counts[i]; j++) {
-                exp = (j % PRIME_MODULUS) + (PRIME_MODULUS * world_rank);
-                my_dc_send_vector[j + send_offsets[i]] = (1.0 * exp - 1.0 * exp * I);
-            }
-        }
+    send_vector = in_place ? my_recv_vector : my_send_vector;
+    send_arg = in_place ? MPI_IN_PLACE : my_send_vector;
+    if( !in_place ) {
+        fill_buffers(tt, my_recv_vector, recv_total, send_vector, send_counts, send_offsets);
     }
 
     if (world_rank == 0) {
-        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): MPI_IN_PLACE\n",
-               mpi_function, (MPI_INT == dtype ? "int" : "double _Complex"),
-               total_num_elements, payload_size_actual, human_bytes(payload_size_actual));
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): Mode: %s%s\n",
+               mpi_function, tt->name,
+               total_num_elements, payload_size_actual, human_bytes(payload_size_actual),
+               ((MODE_PACKED == mode) ? "PACKED" : "SKIPPY"),
+               ((in_place) ? " MPI_IN_PLACE" : ""));
     }
 
     // Perform the MPI_Alltoallv operation
-    if (blocking) {
-        if( MPI_INT == dtype ) {
-            MPI_Alltoallv(my_int_send_vector, send_counts, 
-                          send_offsets,       dtype,
-                          my_int_recv_vector, receive_counts,
-                          receive_offsets,    dtype,
-                          MPI_COMM_WORLD);
-        } else {
-            MPI_Alltoallv(my_dc_send_vector,  send_counts,
-                          send_offsets,       dtype,
-                          my_dc_recv_vector,  receive_counts,
-                          receive_offsets,    dtype,
-                          MPI_COMM_WORLD);
-        }
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Alltoallv)(send_arg,        send_counts,
+                             send_offsets,    dtype,
+                             my_recv_vector,  receive_counts,
+                             receive_offsets, dtype,
+                             test_comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
     }
-    else {
-        if( MPI_INT == dtype ) {
-            MPI_Ialltoallv(my_int_send_vector, send_counts,
-                           send_offsets,       dtype,
-                           my_int_recv_vector, receive_counts,
-                           receive_offsets,    dtype,
-                           MPI_COMM_WORLD,     &request);
-        } else {
-            MPI_Ialltoallv(my_dc_send_vector,  send_counts,
-                           send_offsets,       dtype,
-                           my_dc_recv_vector,  receive_counts,
-                           receive_offsets,    dtype,
-                           MPI_COMM_WORLD,     &request);
+    while( timer_more(&timer) ) {
+        // MPI_IN_PLACE overwrites the input so reset it for every iteration, and
+        // poison the result of the previous start of the persistent request
+        if( in_place ) {
+            fill_buffers(tt, my_recv_vector, recv_total, send_vector, send_counts, receive_offsets);
+        } else if( timer_poison_due(&timer) ) {
+            fill_value(tt, my_recv_vector, recv_total, -1);
         }
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
-    }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Alltoallv)(send_arg,        send_counts,
+                                    send_offsets,    dtype,
+                                    my_recv_vector,  receive_counts,
+                                    receive_offsets, dtype,
+                                    test_comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ialltoallv)(send_arg,        send_counts,
+                                     send_offsets,    dtype,
+                                     my_recv_vector,  receive_counts,
+                                     receive_offsets, dtype,
+                                     test_comm,       &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_alltoallv(send_arg,        send_counts,
+                          send_offsets,    dtype,
+                          my_recv_vector,  receive_counts,
+                          receive_offsets, dtype,
+                          test_comm);
+        }
+        timer_stop(&timer);
 
-    // Check results. Each receive buffer segment must match the 
-    // values in the send buffer segment it was sent.
-    num_wrong = 0;
-    current_base = 0;
-    if (MPI_INT == dtype) {
-        for (i = 0; i < world_size; i++) {
-            for (j = 0; j < receive_counts[i]; j++) {
-                exp = (j % PRIME_MODULUS) + (PRIME_MODULUS * i);
-                if (my_int_recv_vector[current_base + j] != exp) {
-                    num_wrong = num_wrong + 1;
+        // Check results (after every start of the persistent request). The gap
+        // before each segment must not be modified, and each receive buffer
+        // segment must match the values in the send buffer segment it was sent.
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            current_base = 0;
+            for (i = 0; i < world_size; i++) {
+                num_wrong += check_value(tt, my_recv_vector, current_base,
+                                         (size_t)receive_offsets[i] - current_base, -1, &first_bad);
+                current_base = (size_t)receive_offsets[i];
+                seg_first_bad = SIZE_MAX;
+                seg_wrong = check_prime_pattern(tt, (char*)my_recv_vector + current_base * tt->size,
+                                                receive_counts[i], 0, 1,
+                                                alltoallv_base(i), &seg_first_bad);
+                if (0 != seg_wrong && current_base + seg_first_bad < first_bad) {
+                    first_bad = current_base + seg_first_bad;
                 }
+                num_wrong = num_wrong + seg_wrong;
+                current_base = current_base + receive_counts[i];
             }
-            current_base = current_base + receive_counts[i];
         }
     }
-    else {
-        for (i = 0; i < world_size; i++) {
-            for (j = 0; j < receive_counts[i]; j++) {
-                exp = (j % PRIME_MODULUS) + (PRIME_MODULUS * i);
-                if (my_dc_recv_vector[current_base + j] != (1.0 * exp - 1.0 * exp * I)) {
-                    num_wrong = num_wrong + 1;
-                }
-            }
-            current_base = current_base + receive_counts[i];
-        }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
     }
+    timer_report(&timer, payload_size_actual);
 
     if (0 == num_wrong) {
         printf("Rank %2d: PASSED\n", world_rank);
@@ -255,24 +291,30 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
         printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
                num_wrong, total_num_elements,
                ((num_wrong * 1.0) / total_num_elements * 100.0));
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
         ret = 1;
     }
 
-    if (NULL != my_int_send_vector) {
-        free(my_int_send_vector);
-    }
-    if (NULL != my_int_recv_vector){
-        free(my_int_recv_vector);
-    }
-    if (NULL != my_dc_send_vector) {
-        free(my_dc_send_vector);
+    record_result(mpi_function, dtype, total_num_elements, payload_size_actual,
+                  variant, mode, in_place, num_wrong, &timer);
+
+    if (NULL != my_send_vector) {
+        safe_free(my_send_vector);
     }
-    if (NULL != my_dc_recv_vector){
-        free(my_dc_recv_vector);
+    if (NULL != my_recv_vector){
+        safe_free(my_recv_vector);
     }
 
     fflush(NULL);
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(test_comm);
 
     return ret;
 }
+
+/*
+ * Run one payload size of the sweep (see run_sweep)
+ */
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant)
+{
+    return my_c_test_core(dtype, total_num_elements, MODE_PACKED, false, variant);
+}
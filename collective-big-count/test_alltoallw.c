@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2022 IBM Corporation.  All rights reserved.
+ *
+ * $COPYRIGHT$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <mpi.h>
+#include "common.h"
+#include "reference.h"
+
+/*
+ * Number of matrix columns sent to each peer (width of the column block).
+ * With TEST_UNIFORM_COUNT a single column, so that the count of rows passed
+ * to MPI is the uniform count.
+ */
+#ifndef TEST_UNIFORM_COUNT
+#define COLS_PER_PEER 64
+#else
+#define COLS_PER_PEER 1
+#endif
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, int variant);
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
+
+int main(int argc, char** argv) {
+    // Initialize the MPI environment
+    int ret = 0;
+
+    MPI_Init(NULL, NULL);
+    init_environment(argc, argv);
+
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes(run_tests);
+
+    /*
+     * All done
+     */
+    MPI_Finalize();
+    return ret;
+}
+
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count, skip_count;
+
+    if( sweep_enabled ) {
+        return run_sweep("alltoallw", (size_t)world_size, sweep_case);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+#ifndef TEST_UNIFORM_COUNT
+            // Each rank sends    : V_SIZE / world_size elements to each rank
+            // Largest buffer is  : V_SIZE elements
+            count = test_types[t].v_size;
+#else
+            // Each rank sends    : TEST_UNIFORM_COUNT rows (one column) to each rank
+            // Largest buffer is  : TEST_UNIFORM_COUNT x world_size
+
+            // Note: The location of each block is in its datatype, so the buffers
+            // are not limited by the int displacements as for the other 'v' collectives
+            count = calc_coll_count("alltoallw", test_types[t].size, TEST_UNIFORM_COUNT) * (size_t)world_size * COLS_PER_PEER;
+#endif
+            // Adjust these to be V_SIZE - displacement strides so it will pass
+            skip_count = count - disp_stride * (size_t)world_size;
+            ret += my_c_test_core(test_types[t].dtype, count, MODE_PACKED, v);
+            // With a single process, the coll/self component of Open MPI 4.1
+            // scales the byte displacements by the datatype extent, so the
+            // skip mode writes past the receive buffer and corrupts the heap
+            if( 1 == world_size ) {
+                if( 0 == world_rank ) {
+                    printf("---------------------\nSkipping the SKIPPY mode of MPI_Alltoallw(%s) on a single process\n",
+                           test_types[t].name);
+                }
+                continue;
+            }
+            ret += my_c_test_core(test_types[t].dtype, skip_count, MODE_SKIP, v);
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, int variant)
+{
+    int ret = 0;
+    size_t i;
+    int j;
+
+    // Actual payload size as divisible by the sizeof(dt)
+    size_t payload_size_actual;
+
+    void *my_recv_vector = NULL;
+    void *my_send_vector = NULL;
+    MPI_Request request;
+    coll_timer_t timer;
+    const test_type_t *tt = find_test_type(dtype);
+    MPI_Datatype block_type;
+    MPI_Aint block_disp;
+    size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
+    size_t seg_wrong, seg_first_bad;
+    size_t cols, rows, seg_count, last_disp, recv_total;
+    size_t seg_begin[world_size];
+    test_count_t receive_counts[world_size];
+    test_disp_t receive_offsets[world_size];
+    MPI_Datatype receive_types[world_size];
+    test_count_t send_counts[world_size];
+    test_disp_t send_offsets[world_size];
+    MPI_Datatype send_types[world_size];
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Alltoallw" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ialltoallw" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Alltoallw_init" : "ref_alltoallw";
+
+    if( journal_start(dtype, &total_num_elements, mode, false, variant, &ret) ) {
+        return ret;
+    }
+
+    /* Strategy for testing (the transpose of a distributed matrix, as in an FFT):
+     *  - The send buffer is a row-major matrix of 'rows' x 'cols' elements,
+     *    with a block of COLS_PER_PEER columns for each rank
+     *  - Send type of rank j: one row of the column block j, resized to the
+     *    extent of a full matrix row, so rank j is sent 'rows' strided row pieces
+     *  - Recv type of rank j: one contiguous row piece located in the segment
+     *    of rank j, so each column block is received transposed into a
+     *    contiguous segment
+     * The location of each block is in its datatype, so the byte displacements
+     * (int in MPI-3) do not limit the size of the buffers. The displacements
+     * are:
+     *  - Packed: 0, the segments are tightly packed
+     *  - Skip  : 'disp_stride' elements are skipped before each segment
+     *            making a small gap (left untouched)
+     *
+     * NP = 2, COLS_PER_PEER = 2 and rows = 2 (packed), rank r sends:
+     * [r0, r1, R0, R1, r2, r3, R2, R3]  (lower case to rank 0, upper case to rank 1)
+     * and rank 0 receives: [00, 01, 02, 03, 10, 11, 12, 13]
+     */
+    cols = (size_t)world_size * COLS_PER_PEER;
+    rows = total_num_elements / cols;
+    // total_num_elements must be a multiple of the number of columns. Drop any remainder
+    total_num_elements = rows * cols;
+    seg_count = rows * COLS_PER_PEER;
+    assert(rows <= TEST_COUNT_MAX);
+
+    last_disp = 0;
+    for (j = 0; j < world_size; j++) {
+        if( MODE_SKIP == mode ) {
+            last_disp += disp_stride;
+        }
+        block_disp = (MPI_Aint)((size_t)j * COLS_PER_PEER * tt->size);
+        MPI_Type_create_hindexed_block(1, COLS_PER_PEER, &block_disp, dtype, &block_type);
+        MPI_Type_create_resized(block_type, 0, (MPI_Aint)(cols * tt->size), &send_types[j]);
+        MPI_Type_commit(&send_types[j]);
+        MPI_Type_free(&block_type);
+        send_counts[j] = (test_count_t)rows;
+        send_offsets[j] = 0;
+
+        block_disp = (MPI_Aint)((size_t)j * seg_count * tt->size);
+        MPI_Type_create_hindexed_block(1, COLS_PER_PEER, &block_disp, dtype, &receive_types[j]);
+        MPI_Type_commit(&receive_types[j]);
+        receive_counts[j] = (test_count_t)rows;
+        receive_offsets[j] = (test_disp_t)((last_disp - (size_t)j * seg_count) * tt->size);
+        seg_begin[j] = last_disp;
+        last_disp += seg_count;
+    }
+    recv_total = last_disp;
+
+    payload_size_actual = recv_total * tt->size;
+    my_recv_vector = safe_malloc(payload_size_actual);
+    my_send_vector = safe_malloc(total_num_elements * tt->size);
+
+    // Element k of row i of the column block of rank j is the element
+    // (i * COLS_PER_PEER + k) of the segment received by rank j. Initialize it
+    // to that index modulo prime, offset by prime * rank
+    PARALLEL_FOR(private(j))
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < world_size; j++) {
+            fill_prime_pattern(tt, (char*)my_send_vector + (i * cols + (size_t)j * COLS_PER_PEER) * tt->size,
+                               COLS_PER_PEER, i * COLS_PER_PEER, 1, alltoallv_base(world_rank));
+        }
+    }
+    fill_value(tt, my_recv_vector, recv_total, -1);
+
+    if (world_rank == 0) {
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): Mode: %s\n",
+               mpi_function, tt->name,
+               recv_total, payload_size_actual, human_bytes(payload_size_actual),
+               (MODE_PACKED == mode) ? "PACKED" : "SKIPPY");
+    }
+
+    // Perform the MPI_Alltoallw operation
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Alltoallw)(my_send_vector,  send_counts,
+                             send_offsets,    send_types,
+                             my_recv_vector,  receive_counts,
+                             receive_offsets, receive_types,
+                             test_comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
+    }
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) ) {
+            fill_value(tt, my_recv_vector, recv_total, -1);
+        }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Alltoallw)(my_send_vector,  send_counts,
+                                    send_offsets,    send_types,
+                                    my_recv_vector,  receive_counts,
+                                    receive_offsets, receive_types,
+                                    test_comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ialltoallw)(my_send_vector,  send_counts,
+                                     send_offsets,    send_types,
+                                     my_recv_vector,  receive_counts,
+                                     receive_offsets, receive_types,
+                                     test_comm,       &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_alltoallw(my_send_vector,  send_counts,
+                          send_offsets,    send_types,
+                          my_recv_vector,  receive_counts,
+                          receive_offsets, receive_types,
+                          test_comm);
+        }
+        timer_stop(&timer);
+
+        // Check results (after every start of the persistent request). The gap
+        // before each segment must not be modified, and each segment must match
+        // the column block its source sent to this rank.
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            last_disp = 0;
+            for (j = 0; j < world_size; j++) {
+                num_wrong += check_value(tt, my_recv_vector, last_disp, seg_begin[j] - last_disp,
+                                         -1, &first_bad);
+                last_disp = seg_begin[j];
+                seg_first_bad = SIZE_MAX;
+                seg_wrong = check_prime_pattern(tt, (char*)my_recv_vector + last_disp * tt->size,
+                                                seg_count, 0, 1,
+                                                alltoallv_base(j), &seg_first_bad);
+                if (0 != seg_wrong && last_disp + seg_first_bad < first_bad) {
+                    first_bad = last_disp + seg_first_bad;
+                }
+                num_wrong = num_wrong + seg_wrong;
+                last_disp += seg_count;
+            }
+        }
+    }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, payload_size_actual);
+
+    if (0 == num_wrong) {
+        printf("Rank %2d: PASSED\n", world_rank);
+    } else {
+        printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
+               num_wrong, recv_total,
+               ((num_wrong * 1.0) / recv_total * 100.0));
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
+        ret = 1;
+    }
+
+    record_result(mpi_function, dtype, recv_total, payload_size_actual,
+                  variant, mode, false, num_wrong, &timer);
+
+    for (j = 0; j < world_size; j++) {
+        MPI_Type_free(&send_types[j]);
+        MPI_Type_free(&receive_types[j]);
+    }
+    if (NULL != my_send_vector) {
+        safe_free(my_send_vector);
+    }
+    if (NULL != my_recv_vector){
+        safe_free(my_recv_vector);
+    }
+
+    fflush(NULL);
+    MPI_Barrier(test_comm);
+
+    return ret;
+}
+
+/*
+ * Run one payload size of the sweep (see run_sweep)
+ */
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant)
+{
+    return my_c_test_core(dtype, total_num_elements, MODE_PACKED, variant);
+}
@@ -9,8 +9,10 @@
 
 #include <mpi.h>
 #include "common.h"
+#include "reference.h"
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking);
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
 
 int main(int argc, char** argv) {
     /*
@@ -21,35 +23,8 @@ int main(int argc, char** argv) {
     MPI_Init(NULL, NULL);
     init_environment(argc, argv);
 
-#ifndef TEST_UNIFORM_COUNT
-    // Each rank contribues: V_SIZE_INT elements
-    // Largest buffer is   : V_SIZE_INT elements
-    ret += my_c_test_core(MPI_INT, V_SIZE_INT, true);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, true);
-    if (allow_nonblocked) {
-        ret += my_c_test_core(MPI_INT, V_SIZE_INT, false);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, false);
-    }
-#else
-    size_t proposed_count;
-
-    // Each rank contribues: TEST_UNIFORM_COUNT elements
-    // Largest buffer is   : TEST_UNIFORM_COUNT elements
-    proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                        2, 2); // 1 send, 1 recv buffer each
-    ret += my_c_test_core(MPI_INT, proposed_count, true);
-    proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                        2, 2); // 1 send, 1 recv buffer each
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count, true);
-    if (allow_nonblocked) {
-        proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                            2, 2); // 1 send, 1 recv buffer each
-        ret += my_c_test_core(MPI_INT, proposed_count, false);
-        proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                            2, 2); // 1 send, 1 recv buffer each
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count, false);
-    }
-#endif
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes_inter(run_tests);
 
     /*
      * All done
@@ -58,12 +33,53 @@ int main(int argc, char** argv) {
     return ret;
 }
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count;
+
+    if( sweep_enabled ) {
+        return run_sweep("bcast", 1, my_c_test_core);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+#ifndef TEST_UNIFORM_COUNT
+            // Each rank contribues: V_SIZE elements
+            // Largest buffer is   : V_SIZE elements
+            count = test_types[t].v_size;
+#else
+            // Each rank contribues: TEST_UNIFORM_COUNT elements
+            // Largest buffer is   : TEST_UNIFORM_COUNT elements
+            count = calc_coll_count("bcast", test_types[t].size, TEST_UNIFORM_COUNT);
+#endif
+            ret += my_c_test_core(test_types[t].dtype, count, v);
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant)
 {
     int ret = 0;
-    int i;
     MPI_Request request;
-    char *mpi_function = blocking ? "MPI_Bcast" : "MPI_Ibcast";
+    coll_timer_t timer;
+    coll_comm_t cc;
+    const test_type_t *tt = find_test_type(dtype);
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Bcast" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ibcast" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Bcast_init" : "ref_bcast";
 
     // Actual payload size as divisible by the sizeof(dt)
     size_t payload_size_actual;
@@ -71,84 +87,94 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
     /*
      * Initialize vector
      */
-    int *my_int_vector = NULL;
-    double _Complex *my_dc_vector = NULL;
     void *buff_ptr = NULL;
-    unsigned int num_wrong = 0;
-
-    assert(MPI_INT == dtype || MPI_C_DOUBLE_COMPLEX == dtype);
-    assert(total_num_elements <= INT_MAX);
+    size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
+    // On inter_comm the rest of the root group (low half) receives nothing
+    bool receives;
 
-    if( MPI_INT == dtype ) {
-        payload_size_actual = total_num_elements * sizeof(int);
-        my_int_vector = (int*)safe_malloc(payload_size_actual);
-        buff_ptr = my_int_vector;
-    } else {
-        payload_size_actual = total_num_elements * sizeof(double _Complex);
-        my_dc_vector = (double _Complex*)safe_malloc(payload_size_actual);
-        buff_ptr = my_dc_vector;
+    if( journal_start(dtype, &total_num_elements, 0, false, variant, &ret) ) {
+        return ret;
     }
 
-    for(i = 0; i < total_num_elements; ++i) {
-        if( MPI_INT == dtype ) {
-            if (world_rank == 0) {
-                my_int_vector[i] = i;
-            } else {
-                my_int_vector[i] = -1;
-            }
-        } else {
-            if (world_rank == 0) {
-                my_dc_vector[i] = 1.0*i - 1.0*i*I;
-            } else {
-                my_dc_vector[i] = -1.0 - 1.0*I;
-            }
-        }
+    assert(total_num_elements <= TEST_COUNT_MAX);
+    coll_comm_init(&cc);
+    receives = !(cc.inter && inter_low && !cc.is_root);
+
+    payload_size_actual = total_num_elements * tt->size;
+    buff_ptr = safe_malloc(payload_size_actual);
+
+    if (cc.is_root) {
+        fill_linear(tt, buff_ptr, total_num_elements, BCAST_FIRST);
+    } else {
+        fill_value(tt, buff_ptr, total_num_elements, -1);
     }
 
     if (world_rank == 0) {
         printf("---------------------\nResults from %s(%s x %zu = %zu or %s):\n",
-               mpi_function, (MPI_INT == dtype ? "int" : "double _Complex"),
+               mpi_function, tt->name,
                total_num_elements, payload_size_actual, human_bytes(payload_size_actual));
     }
-    if (blocking) {
-        MPI_Bcast(buff_ptr, (int)total_num_elements, dtype, 0, MPI_COMM_WORLD);
-    }
-    else {
-        MPI_Ibcast(buff_ptr, (int)total_num_elements, dtype, 0, MPI_COMM_WORLD, &request);
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Bcast)(buff_ptr, (test_count_t)total_num_elements, dtype, cc.root, cc.comm,
+                         MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
     }
-
-    /*
-     * Check results.
-     */
-    for(i = 0; i < total_num_elements; ++i) {
-        if( MPI_INT == dtype ) {
-            if(my_int_vector[i] != i) {
-                ++num_wrong;
-            }
-        } else {
-            if(my_dc_vector[i] != 1.0*i - 1.0*i*I) {
-                ++num_wrong;
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) && !cc.is_root ) {
+            fill_value(tt, buff_ptr, total_num_elements, -1);
+        }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Bcast)(buff_ptr, (test_count_t)total_num_elements, dtype, cc.root, cc.comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ibcast)(buff_ptr, (test_count_t)total_num_elements, dtype, cc.root, cc.comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_bcast(buff_ptr, (test_count_t)total_num_elements, dtype, cc.root, cc.comm);
+        }
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         */
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            if( receives ) {
+                num_wrong = check_linear(tt, buff_ptr, 0, total_num_elements, BCAST_FIRST, &first_bad);
+            } else {
+                num_wrong = check_value(tt, buff_ptr, 0, total_num_elements, -1, &first_bad);
             }
         }
     }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, payload_size_actual);
 
     if( 0 == num_wrong) {
         printf("Rank %2d: Passed\n", world_rank);
     } else {
-        printf("Rank %2d:  ERROR: DI in %14u of %14zu slots (%6.1f %% wrong)\n", world_rank,
+        printf("Rank %2d:  ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
                num_wrong, total_num_elements, ((num_wrong * 1.0)/total_num_elements)*100.0);
+        printf("Rank %2d:  ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
         ret = 1;
     }
 
-    if(NULL != my_int_vector) {
-        free(my_int_vector);
-    }
-    if(NULL != my_dc_vector) {
-        free(my_dc_vector);
-    }
+    record_result(mpi_function, dtype, total_num_elements, payload_size_actual,
+                  variant, 0, false, num_wrong, &timer);
+
+    safe_free(buff_ptr);
     fflush(NULL);
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(test_comm);
 
     return ret;
 }
@@ -9,8 +9,10 @@
 
 #include <mpi.h>
 #include "common.h"
+#include "reference.h"
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking);
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
 
 int main(int argc, char** argv) {
     /*
@@ -21,36 +23,8 @@ int main(int argc, char** argv) {
     MPI_Init(NULL, NULL);
     init_environment(argc, argv);
 
-#ifndef TEST_UNIFORM_COUNT
-    // Each rank contribues: V_SIZE_INT / world_size elements
-    // Largest buffer is   : V_SIZE_INT elements
-    ret += my_c_test_core(MPI_INT, V_SIZE_INT, true);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, true);
-    if (allow_nonblocked) {
-        ret += my_c_test_core(MPI_INT, V_SIZE_INT, false);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, false);
-    }
-#else
-    size_t proposed_count;
-
-    // Each rank contribues: TEST_UNIFORM_COUNT elements
-    // Largest buffer is   : TEST_UNIFORM_COUNT x world_size
-    proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                        (size_t)world_size, 1);
-    ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, true);
-
-    proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                        (size_t)world_size, 1);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, true);
-    if (allow_nonblocked) {
-        proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                            (size_t)world_size, 1);
-        ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, false);
-        proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                            (size_t)world_size, 1);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, false);
-    }
-#endif
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes_inter(run_tests);
 
     /*
      * All done
@@ -59,139 +33,171 @@ int main(int argc, char** argv) {
     return ret;
 }
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count;
+
+    if( sweep_enabled ) {
+        return run_sweep("gather", (size_t)world_size, my_c_test_core);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+#ifndef TEST_UNIFORM_COUNT
+            // Each rank contribues: V_SIZE / world_size elements
+            // Largest buffer is   : V_SIZE elements
+            count = test_types[t].v_size;
+#else
+            // Each rank contribues: TEST_UNIFORM_COUNT elements
+            // Largest buffer is   : TEST_UNIFORM_COUNT x world_size
+            count = calc_coll_count("gather", test_types[t].size, TEST_UNIFORM_COUNT) * (size_t)world_size;
+#endif
+            ret += my_c_test_core(test_types[t].dtype, count, v);
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant)
 {
     int ret = 0;
-    size_t i;
     MPI_Request request;
-    char *mpi_function = blocking ? "MPI_Gather" : "MPI_Igather";
+    coll_timer_t timer;
+    coll_comm_t cc;
+    const test_type_t *tt = find_test_type(dtype);
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Gather" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Igather" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Gather_init" : "ref_gather";
 
     // Actual payload size as divisible by the sizeof(dt)
-    size_t payload_size_actual;
+    size_t payload_size_actual = 0;
 
     /*
      * Initialize vector
      */
-    int *my_int_recv_vector = NULL;
-    int *my_int_send_vector = NULL;
-    double _Complex *my_dc_recv_vector = NULL;
-    double _Complex *my_dc_send_vector = NULL;
+    void *my_recv_vector = NULL;
+    void *my_send_vector = NULL;
     size_t recv_count = 0;
     size_t send_count = 0;
-    int exp;
+    int p;
     size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
 
-    assert(MPI_INT == dtype || MPI_C_DOUBLE_COMPLEX == dtype);
-
-    send_count = total_num_elements / (size_t)world_size;
-    recv_count = total_num_elements / (size_t)world_size;
-    assert(send_count <= INT_MAX);
-    assert(recv_count <= INT_MAX);
-    // total_num_elements must be a multiple of world_size. Drop any remainder
-    total_num_elements = send_count * (size_t)world_size;
-
-    if( MPI_INT == dtype ) {
-        if (world_rank == 0) {
-            payload_size_actual = total_num_elements * sizeof(int);
-            my_int_recv_vector = (int*)safe_malloc(payload_size_actual);
-        }
-        my_int_send_vector = (int*)safe_malloc(send_count * sizeof(int));
-    } else {
-        if (world_rank == 0) {
-            payload_size_actual = total_num_elements * sizeof(double _Complex);
-            my_dc_recv_vector = (double _Complex*)safe_malloc(payload_size_actual);
-        }
-        my_dc_send_vector = (double _Complex*)safe_malloc(send_count * sizeof(double _Complex));
+    if( journal_start(dtype, &total_num_elements, 0, false, variant, &ret) ) {
+        return ret;
     }
 
-    for(i = 0; i < send_count; ++i) {
-        exp = 1 + world_rank;
-        if( MPI_INT == dtype ) {
-            my_int_send_vector[i] = exp;
-        } else {
-            my_dc_send_vector[i] = 1.0*exp - 1.0*exp*I;
-        }
+    coll_comm_init(&cc);
+    send_count = total_num_elements / (size_t)cc.blocks;
+    recv_count = total_num_elements / (size_t)cc.blocks;
+    assert(send_count <= TEST_COUNT_MAX);
+    assert(recv_count <= TEST_COUNT_MAX);
+    // total_num_elements must be a multiple of cc.blocks. Drop any remainder,
+    // the root handles one block per peer
+    total_num_elements = send_count * (size_t)cc.peers;
+
+    if (cc.is_root) {
+        payload_size_actual = total_num_elements * tt->size;
+        my_recv_vector = safe_malloc(payload_size_actual);
     }
-    if (world_rank == 0) {
-        for(i = 0; i < total_num_elements; ++i) {
-            if( MPI_INT == dtype ) {
-                my_int_recv_vector[i] = -1;
-            } else {
-                my_dc_recv_vector[i] = 1.0 + 1.0*I;
-            }
-        }
+    my_send_vector = safe_malloc(send_count * tt->size);
+
+    fill_value(tt, my_send_vector, send_count, gather_value(cc.rank, cc.send_base));
+    if (cc.is_root) {
+        fill_value(tt, my_recv_vector, total_num_elements, -1);
     }
 
     if (world_rank == 0) {
         printf("---------------------\nResults from %s(%s x %zu = %zu or %s):\n",
-               mpi_function, (MPI_INT == dtype ? "int" : "double _Complex"),
+               mpi_function, tt->name,
                total_num_elements, payload_size_actual, human_bytes(payload_size_actual));
     }
-    if (blocking) {
-        if( MPI_INT == dtype ) {
-            MPI_Gather(my_int_send_vector, (int)send_count, dtype,
-                       my_int_recv_vector, (int)recv_count, dtype,
-                       0, MPI_COMM_WORLD);
-        } else {
-            MPI_Gather(my_dc_send_vector,  (int)send_count, dtype,
-                       my_dc_recv_vector,  (int)recv_count, dtype,
-                       0, MPI_COMM_WORLD);
-        }
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Gather)(my_send_vector, (test_count_t)send_count, dtype,
+                          my_recv_vector, (test_count_t)recv_count, dtype,
+                          cc.root, cc.comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
     }
-    else {
-        if( MPI_INT == dtype ) {
-            MPI_Igather(my_int_send_vector, (int)send_count, dtype,
-                       my_int_recv_vector, (int)recv_count, dtype,
-                       0, MPI_COMM_WORLD, &request);
-        } else {
-            MPI_Igather(my_dc_send_vector,  (int)send_count, dtype,
-                       my_dc_recv_vector,  (int)recv_count, dtype,
-                       0, MPI_COMM_WORLD, &request);
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) && cc.is_root ) {
+            fill_value(tt, my_recv_vector, total_num_elements, -1);
         }
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
-    }
-
-    /*
-     * Check results.
-     */
-    if (world_rank == 0) {
-        exp = 0;
-        for(i = 0; i < total_num_elements; ++i) {
-            exp = (int)(1 + (i / (size_t)recv_count));
-            if( MPI_INT == dtype ) {
-                if(my_int_recv_vector[i] != exp) {
-                    ++num_wrong;
-                }
-            } else {
-                if(my_dc_recv_vector[i] != 1.0*exp - 1.0*exp*I) {
-                    ++num_wrong;
-                }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Gather)(my_send_vector, (test_count_t)send_count, dtype,
+                                 my_recv_vector, (test_count_t)recv_count, dtype,
+                                 cc.root, cc.comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Igather)(my_send_vector, (test_count_t)send_count, dtype,
+                                 my_recv_vector, (test_count_t)recv_count, dtype,
+                                 cc.root, cc.comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_gather(my_send_vector, (test_count_t)send_count, dtype,
+                       my_recv_vector, (test_count_t)recv_count, dtype,
+                       cc.root, cc.comm);
+        }
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         */
+        if( cc.is_root && 0 == num_wrong && timer_check_due(&timer) ) {
+            // Block p holds the constant value of peer p
+            for(p = 0; p < cc.peers; ++p) {
+                num_wrong += check_value(tt, my_recv_vector, (size_t)p * recv_count, recv_count,
+                                         gather_value(p, cc.recv_base), &first_bad);
             }
         }
+    }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, payload_size_actual);
 
+    if (cc.is_root) {
         if( 0 == num_wrong) {
             printf("Rank %2d: PASSED\n", world_rank);
         } else {
             printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
                    num_wrong, total_num_elements, ((num_wrong * 1.0)/total_num_elements)*100.0);
+            printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
             ret = 1;
         }
     }
 
-    if( NULL != my_int_send_vector ) {
-        free(my_int_send_vector);
-    }
-    if( NULL != my_int_recv_vector ){
-        free(my_int_recv_vector);
-    }
-    if( NULL != my_dc_send_vector ) {
-        free(my_dc_send_vector);
+    record_result(mpi_function, dtype, total_num_elements, payload_size_actual,
+                  variant, 0, false, num_wrong, &timer);
+
+    if( NULL != my_send_vector ) {
+        safe_free(my_send_vector);
     }
-    if( NULL != my_dc_recv_vector ){
-        free(my_dc_recv_vector);
+    if( NULL != my_recv_vector ){
+        safe_free(my_recv_vector);
     }
     fflush(NULL);
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(test_comm);
 
     return ret;
 }
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2022 IBM Corporation.  All rights reserved.
+ *
+ * $COPYRIGHT$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <mpi.h>
+#include "common.h"
+#include "reference.h"
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_topo_tests(void);
+static int run_tests(void);
+
+int main(int argc, char** argv) {
+    /*
+     * Initialize the MPI environment
+     */
+    int ret = 0;
+
+    MPI_Init(NULL, NULL);
+    init_environment(argc, argv);
+
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes(run_tests);
+
+    /*
+     * All done
+     */
+    MPI_Finalize();
+    return ret;
+}
+
+/*
+ * Run all the test cases on each topology (BIGCOUNT_TOPOLOGIES) of test_comm
+ */
+static int run_tests(void)
+{
+    return run_topologies(run_topo_tests);
+}
+
+/*
+ * Run all the test cases on test_topo
+ */
+static int run_topo_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count;
+
+    if( sweep_enabled ) {
+        return run_sweep("neighbor_allgather", (size_t)test_topo->blocks, my_c_test_core);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+#ifndef TEST_UNIFORM_COUNT
+            // Each rank sends    : V_SIZE / neighbors elements to all its neighbors
+            // Largest buffer is  : V_SIZE elements
+            count = test_types[t].v_size;
+#else
+            // Each rank sends    : TEST_UNIFORM_COUNT elements to all its neighbors
+            // Largest buffer is  : TEST_UNIFORM_COUNT x neighbors
+            count = calc_coll_count("neighbor_allgather", test_types[t].size, TEST_UNIFORM_COUNT) * (size_t)test_topo->blocks;
+#endif
+            ret += my_c_test_core(test_types[t].dtype, count, v);
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant)
+{
+    int ret = 0;
+    int j;
+
+    // Actual payload size as divisible by the sizeof(dt)
+    size_t payload_size_actual;
+    // Bytes received from the neighbors that are not MPI_PROC_NULL (bandwidth)
+    size_t moved_bytes;
+
+    /*
+     * Initialize vector
+     */
+    void *my_recv_vector = NULL;
+    void *my_send_vector = NULL;
+    size_t block_count = 0;
+    size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
+    MPI_Request request;
+    coll_timer_t timer;
+    const test_type_t *tt = find_test_type(dtype);
+    const test_topo_t *tp = test_topo;
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Neighbor_allgather" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ineighbor_allgather" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Neighbor_allgather_init" : "ref_neighbor_allgather";
+
+    if( journal_start(dtype, &total_num_elements, 0, false, variant, &ret) ) {
+        return ret;
+    }
+
+    block_count = total_num_elements / (size_t)tp->blocks;
+    // total_num_elements must be a multiple of the number of neighbors. Drop any remainder
+    total_num_elements = block_count * (size_t)tp->blocks;
+    assert(block_count <= TEST_COUNT_MAX);
+
+    payload_size_actual = total_num_elements * tt->size;
+    moved_bytes = topo_moved_bytes(tp, NULL, block_count, tt->size);
+    my_recv_vector = safe_malloc(payload_size_actual);
+    my_send_vector = safe_malloc(block_count * tt->size);
+
+    // The same block goes to all the destinations
+    fill_neighbor_block(tt, my_send_vector, block_count, world_rank, 0);
+    fill_value(tt, my_recv_vector, total_num_elements, -1);
+
+    if (world_rank == 0) {
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): %s\n",
+               mpi_function, tt->name,
+               total_num_elements, payload_size_actual, human_bytes(payload_size_actual), tp->name);
+    }
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Neighbor_allgather)(my_send_vector, (test_count_t)block_count, dtype,
+                                     my_recv_vector, (test_count_t)block_count, dtype,
+                                     tp->comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
+    }
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) ) {
+            fill_value(tt, my_recv_vector, total_num_elements, -1);
+        }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Neighbor_allgather)(my_send_vector, (test_count_t)block_count, dtype,
+                                            my_recv_vector, (test_count_t)block_count, dtype,
+                                            tp->comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ineighbor_allgather)(my_send_vector, (test_count_t)block_count, dtype,
+                                             my_recv_vector, (test_count_t)block_count, dtype,
+                                             tp->comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_neighbor_allgather(my_send_vector, (test_count_t)block_count, dtype,
+                                  my_recv_vector, (test_count_t)block_count, dtype,
+                                  tp->comm);
+        }
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         * Block j comes from source j. The blocks of MPI_PROC_NULL sources
+         * (non-periodic boundary of a Cartesian grid) are not modified.
+         */
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            for(j = 0; j < tp->blocks; ++j) {
+                num_wrong += check_neighbor_block(tt, my_recv_vector, (size_t)j * block_count,
+                                                  block_count, tp->sources[j], 0, &first_bad);
+            }
+        }
+    }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, moved_bytes);
+
+    if( 0 == num_wrong) {
+        printf("Rank %2d: PASSED\n", world_rank);
+    } else {
+        printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
+               num_wrong, total_num_elements, ((num_wrong * 1.0)/total_num_elements)*100.0);
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
+        ret = 1;
+    }
+
+    record_result(mpi_function, dtype, total_num_elements, moved_bytes,
+                  variant, 0, false, num_wrong, &timer);
+
+    if( NULL != my_send_vector ) {
+        safe_free(my_send_vector);
+    }
+    if( NULL != my_recv_vector ){
+        safe_free(my_recv_vector);
+    }
+
+    fflush(NULL);
+    MPI_Barrier(test_comm);
+
+    return ret;
+}
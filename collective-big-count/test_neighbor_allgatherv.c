@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2022 IBM Corporation.  All rights reserved.
+ *
+ * $COPYRIGHT$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <mpi.h>
+#include "common.h"
+#include "reference.h"
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, int variant);
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_topo_tests(void);
+static int run_tests(void);
+
+int main(int argc, char** argv) {
+    /*
+     * Initialize the MPI environment
+     */
+    int ret = 0;
+
+    MPI_Init(NULL, NULL);
+    init_environment(argc, argv);
+
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes(run_tests);
+
+    /*
+     * All done
+     */
+    MPI_Finalize();
+    return ret;
+}
+
+/*
+ * Run all the test cases on each topology (BIGCOUNT_TOPOLOGIES) of test_comm
+ */
+static int run_tests(void)
+{
+    return run_topologies(run_topo_tests);
+}
+
+/*
+ * Run all the test cases on test_topo
+ */
+static int run_topo_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count, skip_count;
+    size_t blocks = (size_t)test_topo->blocks;
+
+    if( sweep_enabled ) {
+        return run_sweep("neighbor_allgatherv", blocks, sweep_case);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+#ifndef TEST_UNIFORM_COUNT
+            // Each rank sends    : V_SIZE / neighbors elements to all its neighbors
+            // Largest buffer is  : V_SIZE elements
+            count = test_types[t].v_size;
+            // Adjust these to be V_SIZE - displacement strides so it will pass
+            skip_count = count - disp_stride*blocks;
+#else
+            // Each rank sends    : TEST_UNIFORM_COUNT / neighbors elements to all its neighbors
+            // Largest buffer is  : TEST_UNIFORM_COUNT elements
+
+            // Note: Displacement is an int, so the recv buffer cannot be too large as to overflow the int
+            // As such divide by the number of neighbors
+            count = calc_coll_count("neighbor_allgatherv", test_types[t].size, TEST_UNIFORM_COUNT / blocks);
+            // Adjust these to be V_SIZE - displacement strides so it will pass
+            skip_count = (count - disp_stride) * blocks;
+            count *= blocks;
+#endif
+            ret += my_c_test_core(test_types[t].dtype, count, MODE_PACKED, v);
+            ret += my_c_test_core(test_types[t].dtype, skip_count, MODE_SKIP, v);
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, int variant)
+{
+    int ret = 0;
+    int j;
+
+    // Actual payload size as divisible by the sizeof(dt)
+    size_t payload_size_actual;
+    // Bytes received from the neighbors that are not MPI_PROC_NULL (bandwidth)
+    size_t moved_bytes;
+
+    /*
+     * Initialize vector
+     */
+    void *my_send_vector = NULL;
+    void *my_recv_vector = NULL;
+    test_count_t my_recv_counts[TOPO_MAX_DEGREE];
+    test_disp_t my_recv_disp[TOPO_MAX_DEGREE];
+    test_count_t send_count = 0;
+    size_t last_disp;
+    size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
+    size_t v_size, v_rem;
+    MPI_Request request;
+    coll_timer_t timer;
+    const test_type_t *tt = find_test_type(dtype);
+    const test_topo_t *tp = test_topo;
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Neighbor_allgatherv" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ineighbor_allgatherv" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Neighbor_allgatherv_init" : "ref_neighbor_allgatherv";
+
+    if( journal_start(dtype, &total_num_elements, mode, false, variant, &ret) ) {
+        return ret;
+    }
+
+    // The highest rank sends the excess (total_num_elements % neighbors), so
+    // the receive count of a source depends on its rank
+    v_size = total_num_elements / (size_t)tp->blocks;
+    v_rem  = total_num_elements % (size_t)tp->blocks;
+    send_count = (test_count_t)(v_size + ((world_rank == world_size - 1) ? v_rem : 0));
+    assert((size_t)send_count <= TEST_COUNT_MAX);
+
+    /* Strategy for testing:
+     *  - Packed: displacement skips 0 elements producing a tightly packed buffer
+     *  - Skip  : displacement skips 'disp_stride' elements before each source
+     *            making a small gap (left untouched)
+     *
+     * 4 neighbors, the last one is the highest rank, and total_num_elements = 9
+     * (packed), then the final buffer will be:
+     * [s0, s0, s1, s1, s2, s2, s3, s3, s3]
+     */
+    last_disp = 0;
+    for(j = 0; j < tp->indegree; ++j) {
+        if( MODE_SKIP == mode ) {
+            last_disp += disp_stride;
+        }
+        my_recv_counts[j] = (test_count_t)(v_size + ((tp->sources[j] == world_size - 1) ? v_rem : 0));
+        assert(last_disp <= TEST_COUNT_MAX);
+        my_recv_disp[j] = (test_disp_t)last_disp;
+        last_disp += (size_t)my_recv_counts[j];
+    }
+    total_num_elements = last_disp;
+
+    payload_size_actual = total_num_elements * tt->size;
+    moved_bytes = topo_moved_bytes(tp, my_recv_counts, 0, tt->size);
+    my_recv_vector = safe_malloc(payload_size_actual);
+    my_send_vector = safe_malloc((size_t)send_count * tt->size);
+    fill_value(tt, my_recv_vector, total_num_elements, -1);
+    fill_neighbor_block(tt, my_send_vector, (size_t)send_count, world_rank, 0);
+
+    if (world_rank == 0) {
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): Mode: %s, %s\n",
+               mpi_function, tt->name,
+               total_num_elements, payload_size_actual, human_bytes(payload_size_actual),
+               (MODE_PACKED == mode ? "PACKED" : "SKIPPY"), tp->name);
+    }
+
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Neighbor_allgatherv)(my_send_vector, send_count, dtype,
+                                       my_recv_vector, my_recv_counts, my_recv_disp, dtype,
+                                       tp->comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
+    }
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) ) {
+            fill_value(tt, my_recv_vector, total_num_elements, -1);
+        }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Neighbor_allgatherv)(my_send_vector, send_count, dtype,
+                                              my_recv_vector, my_recv_counts, my_recv_disp, dtype,
+                                              tp->comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ineighbor_allgatherv)(my_send_vector, send_count, dtype,
+                                               my_recv_vector, my_recv_counts, my_recv_disp, dtype,
+                                               tp->comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_neighbor_allgatherv(my_send_vector, send_count, dtype,
+                                    my_recv_vector, my_recv_counts, my_recv_disp, dtype,
+                                    tp->comm);
+        }
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         * The gaps before the segments and the segments of MPI_PROC_NULL sources
+         * must not be modified.
+         */
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            last_disp = 0;
+            for(j = 0; j < tp->indegree; ++j) {
+                // Gap before the segment
+                num_wrong += check_value(tt, my_recv_vector, last_disp,
+                                         (size_t)my_recv_disp[j] - last_disp, -1, &first_bad);
+                num_wrong += check_neighbor_block(tt, my_recv_vector, (size_t)my_recv_disp[j],
+                                                  (size_t)my_recv_counts[j], tp->sources[j], 0,
+                                                  &first_bad);
+                last_disp = (size_t)my_recv_disp[j] + (size_t)my_recv_counts[j];
+            }
+        }
+    }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, moved_bytes);
+
+    if( 0 == num_wrong) {
+        printf("Rank %2d: PASSED\n", world_rank);
+    } else {
+        printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
+               num_wrong, total_num_elements, ((num_wrong * 1.0)/total_num_elements)*100.0);
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
+        ret = 1;
+    }
+
+    record_result(mpi_function, dtype, total_num_elements, moved_bytes,
+                  variant, mode, false, num_wrong, &timer);
+
+    if( NULL != my_send_vector ) {
+        safe_free(my_send_vector);
+    }
+    if( NULL != my_recv_vector ) {
+        safe_free(my_recv_vector);
+    }
+
+    fflush(NULL);
+    MPI_Barrier(test_comm);
+
+    return ret;
+}
+
+/*
+ * Run one payload size of the sweep (see run_sweep)
+ */
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant)
+{
+    return my_c_test_core(dtype, total_num_elements, MODE_PACKED, variant);
+}
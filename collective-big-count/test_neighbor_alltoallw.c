@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2022 IBM Corporation.  All rights reserved.
+ *
+ * $COPYRIGHT$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <mpi.h>
+#include "common.h"
+#include "reference.h"
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_topo_tests(void);
+static int run_tests(void);
+
+int main(int argc, char** argv) {
+    // Initialize the MPI environment
+    int ret = 0;
+
+    MPI_Init(NULL, NULL);
+    init_environment(argc, argv);
+
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes(run_tests);
+
+    /*
+     * All done
+     */
+    MPI_Finalize();
+    return ret;
+}
+
+/*
+ * Run all the test cases on each topology (BIGCOUNT_TOPOLOGIES) of test_comm
+ */
+static int run_tests(void)
+{
+    return run_topologies(run_topo_tests);
+}
+
+/*
+ * Run all the test cases on test_topo
+ */
+static int run_topo_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count;
+
+    if( sweep_enabled ) {
+        return run_sweep("neighbor_alltoallw", (size_t)test_topo->blocks, my_c_test_core);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+#ifndef TEST_UNIFORM_COUNT
+            // Each rank sends    : V_SIZE / neighbors elements to each neighbor
+            // Largest buffer is  : V_SIZE elements
+            count = test_types[t].v_size;
+#else
+            // Each rank sends    : TEST_UNIFORM_COUNT / neighbors elements to each neighbor
+            // Largest buffer is  : TEST_UNIFORM_COUNT elements
+
+            // Note: The counts are ints, so divide by the number of neighbors
+            count = calc_coll_count("neighbor_alltoallw", test_types[t].size,
+                                    TEST_UNIFORM_COUNT / (size_t)test_topo->blocks) * (size_t)test_topo->blocks;
+#endif
+            ret += my_c_test_core(test_types[t].dtype, count, v);
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant)
+{
+    int ret = 0;
+    int j;
+
+    // Actual payload size as divisible by the sizeof(dt)
+    size_t payload_size_actual;
+    // Bytes received from the neighbors that are not MPI_PROC_NULL (bandwidth)
+    size_t moved_bytes;
+
+    void *my_recv_vector = NULL;
+    void *my_send_vector = NULL;
+    MPI_Request request;
+    coll_timer_t timer;
+    const test_type_t *tt = find_test_type(dtype);
+    const test_topo_t *tp = test_topo;
+    size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
+    size_t v_size, v_rem, send_total, recv_total;
+    test_count_t receive_counts[TOPO_MAX_DEGREE];
+    MPI_Aint receive_offsets[TOPO_MAX_DEGREE];
+    MPI_Datatype receive_types[TOPO_MAX_DEGREE];
+    test_count_t send_counts[TOPO_MAX_DEGREE];
+    MPI_Aint send_offsets[TOPO_MAX_DEGREE];
+    MPI_Datatype send_types[TOPO_MAX_DEGREE];
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Neighbor_alltoallw" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ineighbor_alltoallw" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Neighbor_alltoallw_init" : "ref_neighbor_alltoallw";
+
+    if( journal_start(dtype, &total_num_elements, 0, false, variant, &ret) ) {
+        return ret;
+    }
+
+    if (total_num_elements > TEST_COUNT_MAX) {
+        total_num_elements = TEST_COUNT_MAX;
+    }
+
+    // Data sent to all neighbors other than the highest rank is
+    // (total_num_elements / neighbors) elements. All ranks send that data plus
+    // the excess (total_num_elements % neighbors) to the highest rank, so the
+    // count depends on the neighbor. The receive count of a source is the
+    // send count of that source to this rank.
+    // The displacements are in bytes and the received segments are stored in
+    // the reverse order of the sources (the last source at the start).
+    v_size = total_num_elements / (size_t)tp->blocks;
+    v_rem  = total_num_elements % (size_t)tp->blocks;
+    if( (v_size + v_rem) * (size_t)tp->blocks > TEST_COUNT_MAX ) {
+        v_rem = 0;
+    }
+    send_total = 0;
+    for (j = 0; j < tp->outdegree; j++) {
+        send_counts[j] = (test_count_t)(v_size + ((tp->destinations[j] == world_size - 1) ? v_rem : 0));
+        send_offsets[j] = (MPI_Aint)(send_total * tt->size);
+        send_types[j] = dtype;
+        send_total += (size_t)send_counts[j];
+    }
+    recv_total = 0;
+    for (j = tp->indegree - 1; j >= 0; j--) {
+        receive_counts[j] = (test_count_t)(v_size + ((world_rank == world_size - 1) ? v_rem : 0));
+        receive_offsets[j] = (MPI_Aint)(recv_total * tt->size);
+        receive_types[j] = dtype;
+        recv_total += (size_t)receive_counts[j];
+    }
+
+    payload_size_actual = recv_total * tt->size;
+    moved_bytes = topo_moved_bytes(tp, receive_counts, 0, tt->size);
+    my_recv_vector = safe_malloc(payload_size_actual);
+    my_send_vector = safe_malloc(send_total * tt->size);
+
+    for (j = 0; j < tp->outdegree; j++) {
+        fill_neighbor_block(tt, (char*)my_send_vector + (size_t)send_offsets[j],
+                            (size_t)send_counts[j], world_rank, tp->destinations[j]);
+    }
+    fill_value(tt, my_recv_vector, recv_total, -1);
+
+    if (world_rank == 0) {
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): %s\n",
+               mpi_function, tt->name,
+               recv_total, payload_size_actual, human_bytes(payload_size_actual), tp->name);
+    }
+
+    // Perform the MPI_Neighbor_alltoallw operation
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Neighbor_alltoallw)(my_send_vector,  send_counts,
+                                      send_offsets,    send_types,
+                                      my_recv_vector,  receive_counts,
+                                      receive_offsets, receive_types,
+                                      tp->comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
+    }
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) ) {
+            fill_value(tt, my_recv_vector, recv_total, -1);
+        }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Neighbor_alltoallw)(my_send_vector,  send_counts,
+                                             send_offsets,    send_types,
+                                             my_recv_vector,  receive_counts,
+                                             receive_offsets, receive_types,
+                                             tp->comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ineighbor_alltoallw)(my_send_vector,  send_counts,
+                                              send_offsets,    send_types,
+                                              my_recv_vector,  receive_counts,
+                                              receive_offsets, receive_types,
+                                              tp->comm,        &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_neighbor_alltoallw(my_send_vector,  send_counts,
+                                   send_offsets,    send_types,
+                                   my_recv_vector,  receive_counts,
+                                   receive_offsets, receive_types,
+                                   tp->comm);
+        }
+        timer_stop(&timer);
+
+        // Check results (after every start of the persistent request). Each
+        // receive buffer segment must match the values that its source sent to
+        // this rank (MPI_PROC_NULL segments are not modified).
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            for (j = 0; j < tp->indegree; j++) {
+                num_wrong += check_neighbor_block(tt, my_recv_vector, (size_t)receive_offsets[j] / tt->size,
+                                                  (size_t)receive_counts[j], tp->sources[j],
+                                                  world_rank, &first_bad);
+            }
+        }
+    }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, moved_bytes);
+
+    if (0 == num_wrong) {
+        printf("Rank %2d: PASSED\n", world_rank);
+    } else {
+        printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
+               num_wrong, recv_total,
+               ((num_wrong * 1.0) / recv_total * 100.0));
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
+        ret = 1;
+    }
+
+    record_result(mpi_function, dtype, recv_total, moved_bytes,
+                  variant, 0, false, num_wrong, &timer);
+
+    if (NULL != my_send_vector) {
+        safe_free(my_send_vector);
+    }
+    if (NULL != my_recv_vector){
+        safe_free(my_recv_vector);
+    }
+
+    fflush(NULL);
+    MPI_Barrier(test_comm);
+
+    return ret;
+}
@@ -9,8 +9,10 @@
 
 #include <mpi.h>
 #include "common.h"
+#include "reference.h"
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking);
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
 
 int main(int argc, char** argv) {
     /*
@@ -21,36 +23,8 @@ int main(int argc, char** argv) {
     MPI_Init(NULL, NULL);
     init_environment(argc, argv);
 
-#ifndef TEST_UNIFORM_COUNT
-    // Each rank contribues: V_SIZE_INT elements
-    // Largest buffer is   : V_SIZE_INT elements
-    ret += my_c_test_core(MPI_INT, V_SIZE_INT, true);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, true);
-    if (allow_nonblocked) {
-        ret += my_c_test_core(MPI_INT, V_SIZE_INT, false);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, false);
-    }
-#else
-    size_t proposed_count;
-
-    // Each rank contribues: TEST_UNIFORM_COUNT elements
-    // Largest buffer is   : TEST_UNIFORM_COUNT elements
-    proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                        2, 2); // 1 send, 1 recv buffer each
-    ret += my_c_test_core(MPI_INT, proposed_count, true);
-
-    proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                        2, 2); // 1 send, 1 recv buffer each
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count, true);
-    if (allow_nonblocked) {
-        proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                            2, 2); // 1 send, 1 recv buffer each
-        ret += my_c_test_core(MPI_INT, proposed_count, false);
-        proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                            2, 2); // 1 send, 1 recv buffer each
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count, false);
-    }
-#endif
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes(run_tests);
 
     /*
      * All done
@@ -59,12 +33,60 @@ int main(int argc, char** argv) {
     return ret;
 }
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, o, v, t;
+    size_t count;
+
+    test_op = &test_ops[TO_SUM];
+    if( sweep_enabled ) {
+        return run_sweep("reduce", 1, my_c_test_core);
+    }
+
+    // Run the tests of each enabled op (BIGCOUNT_OPS), variant and datatype (BIGCOUNT_DATATYPES)
+    for( o = 0; o < NUM_TEST_OPS; ++o ) {
+        if( !test_ops[o].enabled ) {
+            continue;
+        }
+        test_op = &test_ops[o];
+        for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+            if( !variant_enabled(v) ) {
+                continue;
+            }
+            for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+                if( !op_runs_on(test_op, &test_types[t]) ) {
+                    continue;
+                }
+#ifndef TEST_UNIFORM_COUNT
+                // Each rank contribues: V_SIZE elements
+                // Largest buffer is   : V_SIZE elements
+                count = test_types[t].v_size;
+#else
+                // Each rank contribues: TEST_UNIFORM_COUNT elements
+                // Largest buffer is   : TEST_UNIFORM_COUNT elements
+                count = calc_coll_count("reduce", test_types[t].size, TEST_UNIFORM_COUNT);
+#endif
+                ret += my_c_test_core(test_types[t].dtype, count, v);
+            }
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int variant)
 {
     int ret = 0;
-    size_t i;
     MPI_Request request;
-    char *mpi_function = blocking ? "MPI_Reduce" : "MPI_Ireduce";
+    coll_timer_t timer;
+    const test_type_t *tt = find_test_type(dtype);
+    MPI_Op op = op_handle(test_op, tt);
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Reduce" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ireduce" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Reduce_init" : "ref_reduce";
 
     // Actual payload size as divisible by the sizeof(dt)
     size_t payload_size_actual;
@@ -72,116 +94,105 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, bool blocking)
     /*
      * Initialize vector
      */
-    int *my_int_recv_vector = NULL;
-    int *my_int_send_vector = NULL;
-    double _Complex *my_dc_recv_vector = NULL;
-    double _Complex *my_dc_send_vector = NULL;
+    void *my_recv_vector = NULL;
+    void *my_send_vector = NULL;
     size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
 
-    assert(MPI_INT == dtype || MPI_C_DOUBLE_COMPLEX == dtype);
-    assert(total_num_elements <= INT_MAX);
-
-    if( MPI_INT == dtype ) {
-        payload_size_actual = total_num_elements * sizeof(int);
-        if (world_rank == 0) {
-            my_int_recv_vector = (int*)safe_malloc(payload_size_actual);
-        }
-        my_int_send_vector = (int*)safe_malloc(payload_size_actual);
-    } else {
-        payload_size_actual = total_num_elements * sizeof(double _Complex);
-        if (world_rank == 0) {
-            my_dc_recv_vector = (double _Complex*)safe_malloc(payload_size_actual);
-        }
-        my_dc_send_vector = (double _Complex*)safe_malloc(payload_size_actual);
+    if( journal_start(dtype, &total_num_elements, 0, false, variant, &ret) ) {
+        return ret;
     }
 
-    for(i = 0; i < total_num_elements; ++i) {
-        if( MPI_INT == dtype ) {
-            my_int_send_vector[i] = 1;
-            if (world_rank == 0) {
-                my_int_recv_vector[i] = -1;
-            }
-        } else {
-            my_dc_send_vector[i] = 1.0 - 1.0*I;
-            if (world_rank == 0) {
-                my_dc_recv_vector[i] = -1.0 + 1.0*I;
-            }
-        }
+    assert(total_num_elements <= TEST_COUNT_MAX);
+
+    payload_size_actual = total_num_elements * tt->size;
+    if (world_rank == 0) {
+        my_recv_vector = safe_malloc(payload_size_actual);
+        fill_value(tt, my_recv_vector, total_num_elements, -1);
     }
+    my_send_vector = safe_malloc(payload_size_actual);
+    fill_op_input(tt, test_op, my_send_vector, total_num_elements, 0, world_rank);
 
     /*
      * MPI_Allreduce fails when size of my_int_vector is large
      */
     if (world_rank == 0) {
-        printf("---------------------\nResults from %s(%s x %zu = %zu or %s):\n",
-               mpi_function, (MPI_INT == dtype ? "int" : "double _Complex"),
-               total_num_elements, payload_size_actual, human_bytes(payload_size_actual));
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s, %s):\n",
+               mpi_function, tt->name,
+               total_num_elements, payload_size_actual, human_bytes(payload_size_actual), test_op->name);
     }
-    if (blocking) {
-        if( MPI_INT == dtype ) {
-            MPI_Reduce(my_int_send_vector, my_int_recv_vector,
-                       (int)total_num_elements, dtype,
-                       MPI_SUM, 0, MPI_COMM_WORLD);
-        } else {
-            MPI_Reduce(my_dc_send_vector, my_dc_recv_vector,
-                       (int)total_num_elements, dtype,
-                       MPI_SUM, 0, MPI_COMM_WORLD);
-        }
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Reduce)(my_send_vector, my_recv_vector,
+                          (test_count_t)total_num_elements, dtype,
+                          op, 0, test_comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
     }
-    else {
-        if( MPI_INT == dtype ) {
-            MPI_Ireduce(my_int_send_vector, my_int_recv_vector,
-                       (int)total_num_elements, dtype,
-                       MPI_SUM, 0, MPI_COMM_WORLD, &request);
-        } else {
-            MPI_Ireduce(my_dc_send_vector, my_dc_recv_vector,
-                       (int)total_num_elements, dtype,
-                       MPI_SUM, 0, MPI_COMM_WORLD, &request);
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) && world_rank == 0 ) {
+            fill_value(tt, my_recv_vector, total_num_elements, -1);
+        }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Reduce)(my_send_vector, my_recv_vector,
+                                 (test_count_t)total_num_elements, dtype,
+                                 op, 0, test_comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ireduce)(my_send_vector, my_recv_vector,
+                                  (test_count_t)total_num_elements, dtype,
+                                  op, 0, test_comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_reduce(my_send_vector, my_recv_vector,
+                       (test_count_t)total_num_elements, dtype,
+                       op, 0, test_comm);
         }
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         * Each output array element must be the reduction of the inputs of all
+         * the ranks (see the test_ops table for the closed form of each op).
+         */
+        if( world_rank == 0 && 0 == num_wrong && timer_check_due(&timer) ) {
+            num_wrong = check_op_result(tt, test_op, my_recv_vector, total_num_elements,
+                                        0, world_size, &first_bad);
+        }
+    }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
     }
+    timer_report(&timer, payload_size_actual);
 
-    /*
-     * Check results.
-     * The exact result = (size*number_of_processes, -size*number_of_processes)
-     */
     if (world_rank == 0) {
-        for(i = 0; i < total_num_elements; ++i) {
-            if( MPI_INT == dtype ) {
-                if(my_int_recv_vector[i] != world_size) {
-                    ++num_wrong;
-                }
-            } else {
-                if(my_dc_recv_vector[i] != 1.0*world_size - 1.0*world_size*I) {
-                    ++num_wrong;
-                }
-            }
-        }
-
         if( 0 == num_wrong) {
             printf("Rank %2d: PASSED\n", world_rank);
         } else {
             printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
                    num_wrong, total_num_elements, ((num_wrong * 1.0)/total_num_elements)*100.0);
+            printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
             ret = 1;
         }
     }
 
-    if( NULL != my_int_send_vector ) {
-        free(my_int_send_vector);
-    }
-    if( NULL != my_int_recv_vector ){
-        free(my_int_recv_vector);
-    }
-    if( NULL != my_dc_send_vector ) {
-        free(my_dc_send_vector);
-    }
-    if( NULL != my_dc_recv_vector ){
-        free(my_dc_recv_vector);
+    record_result(mpi_function, dtype, total_num_elements, payload_size_actual,
+                  variant, 0, false, num_wrong, &timer);
+
+    safe_free(my_send_vector);
+    if( NULL != my_recv_vector ){
+        safe_free(my_recv_vector);
     }
 
     fflush(NULL);
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(test_comm);
 
     return ret;
 }
@@ -9,9 +9,12 @@
 
 #include <mpi.h>
 #include "common.h"
+#include "reference.h"
 
 int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements,
-                   int world_size, bool blocking);
+                   int world_size, int variant);
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
 
 int main(int argc, char** argv) {
     /*
@@ -22,41 +25,8 @@ int main(int argc, char** argv) {
     MPI_Init(NULL, NULL);
     init_environment(argc, argv);
 
-    // Run the tests
-#ifndef TEST_UNIFORM_COUNT
-    // Each rank contribues: V_SIZE_INT elements
-    // Largest buffer is   : V_SIZE_INT elements
-    ret += my_c_test_core(MPI_INT, V_SIZE_INT, world_size, true);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX,
-                          world_size, true);
-    if (allow_nonblocked) {
-        ret += my_c_test_core(MPI_INT, V_SIZE_INT, world_size, false);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX,
-                              world_size, false);
-    }
-#else
-    size_t proposed_count;
-
-    // Each rank contribues: TEST_UNIFORM_COUNT elements
-    // Largest buffer is   : TEST_UNIFORM_COUNT elements
-    proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                        2, 2); // 1 send, 1 recv buffer each
-    ret += my_c_test_core(MPI_INT, proposed_count, world_size, true);
-
-    proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                        2, 2); // 1 send, 1 recv buffer each
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count, world_size,
-                          true);
-    if (allow_nonblocked) {
-        proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT,
-                                            2, 2); // 1 send, 1 recv buffer each
-        ret += my_c_test_core(MPI_INT, proposed_count, world_size, false);
-        proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT,
-                                            2, 2); // 1 send, 1 recv buffer each
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count,
-                              world_size, false);
-    }
-#endif
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes(run_tests);
 
     /*
      * All done
@@ -65,20 +35,73 @@ int main(int argc, char** argv) {
     return ret;
 }
 
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, o, v, t;
+    size_t count;
+
+    test_op = &test_ops[TO_SUM];
+    if( sweep_enabled ) {
+        return run_sweep("reduce_scatter", 1, sweep_case);
+    }
+
+    // Run the tests of each enabled op (BIGCOUNT_OPS), variant and datatype (BIGCOUNT_DATATYPES)
+    for( o = 0; o < NUM_TEST_OPS; ++o ) {
+        if( !test_ops[o].enabled ) {
+            continue;
+        }
+        test_op = &test_ops[o];
+        for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+            if( !variant_enabled(v) ) {
+                continue;
+            }
+            for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+                if( !op_runs_on(test_op, &test_types[t]) ) {
+                    continue;
+                }
+#ifndef TEST_UNIFORM_COUNT
+                // Each rank contribues: V_SIZE elements
+                // Largest buffer is   : V_SIZE elements
+                count = test_types[t].v_size;
+#else
+                // Each rank contribues: TEST_UNIFORM_COUNT elements
+                // Largest buffer is   : TEST_UNIFORM_COUNT elements
+                count = calc_coll_count("reduce_scatter", test_types[t].size, TEST_UNIFORM_COUNT);
+#endif
+                ret += my_c_test_core(test_types[t].dtype, count, world_size, v);
+            }
+        }
+    }
+
+    return ret;
+}
+
 int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements,
-                   int world_size, bool blocking)
+                   int world_size, int variant)
 {
     int ret = 0;
     size_t i;
-    int count_for_task[world_size];
+    test_count_t count_for_task[world_size];
     size_t in_lbound;
     MPI_Request request;
-    char *mpi_function = blocking ? "MPI_Reduce_scatter" : "MPI_Ireduce_scatter";
+    coll_timer_t timer;
+    const test_type_t *tt = find_test_type(dtype);
+    MPI_Op op = op_handle(test_op, tt);
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Reduce_scatter" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ireduce_scatter" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Reduce_scatter_init" : "ref_reduce_scatter";
 
     // Actual payload size as divisible by the sizeof(dt)
     size_t payload_size_actual;
     size_t recv_size_actual;
 
+    if( journal_start(dtype, &total_num_elements, 0, false, variant, &ret) ) {
+        return ret;
+    }
+
     // Assign same number of results to each task, last task gets excess
     for (i = 0; i < world_size; i++) {
         count_for_task[i] = total_num_elements / world_size;
@@ -88,124 +111,120 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements,
     /*
      * Initialize vector
      */
-    int *my_int_recv_vector = NULL;
-    int *my_int_send_vector = NULL;
-    double _Complex *my_dc_recv_vector = NULL;
-    double _Complex *my_dc_send_vector = NULL;
+    void *my_recv_vector = NULL;
+    void *my_send_vector = NULL;
     size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
 
-    assert(MPI_INT == dtype || MPI_C_DOUBLE_COMPLEX == dtype);
-    assert(total_num_elements <= INT_MAX);
+    assert(total_num_elements <= TEST_COUNT_MAX);
 
-    if( MPI_INT == dtype ) {
-        payload_size_actual = total_num_elements * sizeof(int);
-        recv_size_actual = count_for_task[world_rank] * sizeof(int);
-        my_int_recv_vector = (int*)safe_malloc(recv_size_actual);
-        my_int_send_vector = (int*)safe_malloc(payload_size_actual);
-    } else {
-        payload_size_actual = total_num_elements * sizeof(double _Complex);
-        recv_size_actual = count_for_task[world_rank] * sizeof(double _Complex);
-        my_dc_recv_vector = (double _Complex*)safe_malloc(recv_size_actual);
-        my_dc_send_vector = (double _Complex*)safe_malloc(payload_size_actual);
-    }
+    payload_size_actual = total_num_elements * tt->size;
+    recv_size_actual = count_for_task[world_rank] * tt->size;
+    my_recv_vector = safe_malloc(recv_size_actual);
+    my_send_vector = safe_malloc(payload_size_actual);
 
     /*
-     * Assign each input array element the value of its array index modulo some
-     * prime as an attempt to assign unique values to each array elements and catch
+     * Assign each input array element the value of its array index plus the rank,
+     * modulo some prime, as an attempt to assign unique values to each array elements and catch
      * errors where array elements get updated with wrong values. Use a prime
      * number in order to avoid problems related to powers of 2.
+     * (This is the input of the sum, see the test_ops table for the other ops.)
      */
-    for(i = 0; i < total_num_elements; ++i) {
-        if( MPI_INT == dtype ) {
-            my_int_send_vector[i] = i % PRIME_MODULUS;
-        } else {
-            my_dc_send_vector[i] = i * PRIME_MODULUS - i * PRIME_MODULUS*I;
-        }
-    }
-    for(i = 0; i < count_for_task[world_rank]; ++i) {
-        if( MPI_INT == dtype ) {
-            my_int_recv_vector[i] = -1;
-        } else {
-            my_dc_recv_vector[i] = -1.0 + 1.0*I;
-        }
-    }
+    fill_op_input(tt, test_op, my_send_vector, total_num_elements, 0, world_rank);
+    fill_value(tt, my_recv_vector, count_for_task[world_rank], -1);
 
     if (world_rank == 0) {
-        printf("---------------------\nResults from %s(%s x %zu = %zu or %s):\n",
-               mpi_function, (MPI_INT == dtype ? "int" : "double _Complex"),
-               total_num_elements, payload_size_actual, human_bytes(payload_size_actual));
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s, %s):\n",
+               mpi_function, tt->name,
+               total_num_elements, payload_size_actual, human_bytes(payload_size_actual), test_op->name);
     }
-    if (blocking) {
-        if( MPI_INT == dtype ) {
-            MPI_Reduce_scatter(my_int_send_vector, my_int_recv_vector,
-                               count_for_task, dtype,
-                               MPI_SUM, MPI_COMM_WORLD);
-        } else {
-            MPI_Reduce_scatter(my_dc_send_vector, my_dc_recv_vector,
-                               count_for_task, dtype,
-                               MPI_SUM, MPI_COMM_WORLD);
-        }
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Reduce_scatter)(my_send_vector, my_recv_vector,
+                                  count_for_task, dtype,
+                                  op, test_comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
     }
-    else {
-        if( MPI_INT == dtype ) {
-            MPI_Ireduce_scatter(my_int_send_vector, my_int_recv_vector,
-                                count_for_task, dtype,
-                                MPI_SUM, MPI_COMM_WORLD, &request);
-        } else {
-            MPI_Ireduce_scatter(my_dc_send_vector, my_dc_recv_vector,
-                                count_for_task, dtype,
-                                MPI_SUM, MPI_COMM_WORLD, &request);
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) ) {
+            fill_value(tt, my_recv_vector, count_for_task[world_rank], -1);
         }
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
-    }
-
-    /*
-     * Check results.
-     * The reduce-scatter operation performs a reduction (sum) for all elements 
-     * of the input array then scatters the reduction result such that each task
-     * gets the number of elements specified by count_for_task[world_rank].
-     * The input array element for each task is set to the value of its array index
-     * modulo a prime number, so the output value for each array element must be 
-     * the corresponding input array element value * number of tasks in the application.
-     */
-    in_lbound = (total_num_elements / world_size) * world_rank;
-    for (i = 0; i < count_for_task[world_rank]; ++i) {
-        if (MPI_INT == dtype) {
-            if (my_int_recv_vector[i] != my_int_send_vector[in_lbound + i] * world_size) {
-                ++num_wrong;
-            }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Reduce_scatter)(my_send_vector, my_recv_vector,
+                                         count_for_task, dtype,
+                                         op, test_comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ireduce_scatter)(my_send_vector, my_recv_vector,
+                                          count_for_task, dtype,
+                                          op, test_comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
         }
         else {
-            if (my_dc_recv_vector[i] != my_dc_send_vector[in_lbound + i] * world_size) {
-                ++num_wrong;
-            }
+            ref_reduce_scatter(my_send_vector, my_recv_vector,
+                               count_for_task, dtype,
+                               op, test_comm);
+        }
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         * The reduce-scatter operation performs a reduction (sum) for all elements 
+         * of the input array then scatters the reduction result such that each task
+         * gets the number of elements specified by count_for_task[world_rank].
+         * Task r sets input array element i to (i + r) modulo a prime number, so
+         * the output value for each array element must be the sum of these over
+         * all the tasks in the application
+         * (see the test_ops table for the closed form of each op).
+         */
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            in_lbound = (total_num_elements / world_size) * world_rank;
+            num_wrong = check_op_result(tt, test_op, my_recv_vector, count_for_task[world_rank],
+                                        in_lbound, world_size, &first_bad);
         }
     }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, payload_size_actual);
 
     if( 0 == num_wrong) {
         printf("Rank %2d: PASSED\n", world_rank);
     } else {
-        printf("Rank %2d: ERROR: DI in %14zu of %14u slots (%6.1f %% wrong)\n", world_rank,
-               num_wrong, count_for_task[world_rank],
+        printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
+               num_wrong, (size_t)count_for_task[world_rank],
                ((num_wrong * 1.0) / count_for_task[world_rank])*100.0);
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
         ret = 1;
     }
 
-    if( NULL != my_int_send_vector ) {
-        free(my_int_send_vector);
-    }
-    if( NULL != my_int_recv_vector ){
-        free(my_int_recv_vector);
-    }
-    if( NULL != my_dc_send_vector ) {
-        free(my_dc_send_vector);
+    record_result(mpi_function, dtype, total_num_elements, payload_size_actual,
+                  variant, 0, false, num_wrong, &timer);
+
+    if( NULL != my_send_vector ) {
+        safe_free(my_send_vector);
     }
-    if( NULL != my_dc_recv_vector ){
-        free(my_dc_recv_vector);
+    if( NULL != my_recv_vector ){
+        safe_free(my_recv_vector);
     }
 
     fflush(NULL);
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(test_comm);
 
     return ret;
 }
+
+/*
+ * Run one payload size of the sweep (see run_sweep)
+ */
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant)
+{
+    return my_c_test_core(dtype, total_num_elements, world_size, variant);
+}
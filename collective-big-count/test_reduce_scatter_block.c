@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2022 IBM Corporation.  All rights reserved.
+ *
+ * $COPYRIGHT$
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <mpi.h>
+#include "common.h"
+#include "reference.h"
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, int variant);
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
+
+int main(int argc, char** argv) {
+    /*
+     * Initialize the MPI environment
+     */
+    int ret = 0;
+
+    MPI_Init(NULL, NULL);
+    init_environment(argc, argv);
+
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes(run_tests);
+
+    /*
+     * All done
+     */
+    MPI_Finalize();
+    return ret;
+}
+
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, o, v, t;
+    size_t count;
+
+    test_op = &test_ops[TO_SUM];
+    if( sweep_enabled ) {
+        return run_sweep("reduce_scatter_block", (size_t)world_size, sweep_case);
+    }
+
+    // Run the tests of each enabled op (BIGCOUNT_OPS), variant and datatype (BIGCOUNT_DATATYPES)
+    for( o = 0; o < NUM_TEST_OPS; ++o ) {
+        if( !test_ops[o].enabled ) {
+            continue;
+        }
+        test_op = &test_ops[o];
+        for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+            if( !variant_enabled(v) ) {
+                continue;
+            }
+            for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+                if( !op_runs_on(test_op, &test_types[t]) ) {
+                    continue;
+                }
+#ifndef TEST_UNIFORM_COUNT
+                // Each rank contribues: V_SIZE elements
+                // Largest buffer is   : V_SIZE elements
+                count = test_types[t].v_size;
+#else
+                // Each rank receives  : TEST_UNIFORM_COUNT elements
+                // Largest buffer is   : TEST_UNIFORM_COUNT x world_size
+                count = calc_coll_count("reduce_scatter_block", test_types[t].size, TEST_UNIFORM_COUNT) * (size_t)world_size;
+#endif
+                ret += my_c_test_core(test_types[t].dtype, count, MODE_PACKED, v);
+                ret += my_c_test_core(test_types[t].dtype, count, MODE_SKIP, v);
+            }
+        }
+    }
+
+    return ret;
+}
+
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, int variant)
+{
+    int ret = 0;
+    size_t block_count, skip, in_lbound;
+    MPI_Request request;
+    coll_timer_t timer;
+    const test_type_t *tt = find_test_type(dtype);
+    MPI_Op op = op_handle(test_op, tt);
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Reduce_scatter_block" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Ireduce_scatter_block" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Reduce_scatter_block_init" : "ref_reduce_scatter_block";
+
+    // Actual payload size as divisible by the sizeof(dt)
+    size_t payload_size_actual;
+    size_t recv_size_actual;
+
+    /*
+     * Initialize vector
+     */
+    void *my_recv_vector = NULL;
+    void *my_send_vector = NULL;
+    void *my_recv_block = NULL;
+    size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
+    size_t block_first_bad = SIZE_MAX;
+
+    if( journal_start(dtype, &total_num_elements, mode, false, variant, &ret) ) {
+        return ret;
+    }
+
+    /* Strategy for testing:
+     *  - Every task gets the same number of results (block_count). The
+     *    remainder of total_num_elements is dropped.
+     *  - Packed: the results are at the start of the receive buffer
+     *  - Skip  : the results are 'disp_stride' elements into the receive
+     *            buffer, leaving a small gap (left untouched)
+     */
+    block_count = total_num_elements / world_size;
+    total_num_elements = block_count * world_size;
+    skip = (MODE_SKIP == mode) ? (size_t)disp_stride : 0;
+    assert(block_count <= TEST_COUNT_MAX);
+
+    payload_size_actual = total_num_elements * tt->size;
+    recv_size_actual = (skip + block_count) * tt->size;
+    my_recv_vector = safe_malloc(recv_size_actual);
+    my_send_vector = safe_malloc(payload_size_actual);
+    my_recv_block = (char*)my_recv_vector + skip * tt->size;
+
+    /*
+     * Assign each input array element the value of its array index plus the rank,
+     * modulo some prime, as an attempt to assign unique values to each array elements and catch
+     * errors where array elements get updated with wrong values. Use a prime
+     * number in order to avoid problems related to powers of 2.
+     * (This is the input of the sum, see the test_ops table for the other ops.)
+     */
+    fill_op_input(tt, test_op, my_send_vector, total_num_elements, 0, world_rank);
+    fill_value(tt, my_recv_vector, skip + block_count, -1);
+
+    if (world_rank == 0) {
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s, %s): Mode: %s\n",
+               mpi_function, tt->name,
+               total_num_elements, payload_size_actual, human_bytes(payload_size_actual), test_op->name,
+               (MODE_PACKED == mode) ? "PACKED" : "SKIPPY");
+    }
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Reduce_scatter_block)(my_send_vector, my_recv_block,
+                                        (test_count_t)block_count, dtype,
+                                        op, test_comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
+    }
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) ) {
+            fill_value(tt, my_recv_vector, skip + block_count, -1);
+        }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Reduce_scatter_block)(my_send_vector, my_recv_block,
+                                               (test_count_t)block_count, dtype,
+                                               op, test_comm);
+        }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Ireduce_scatter_block)(my_send_vector, my_recv_block,
+                                                (test_count_t)block_count, dtype,
+                                                op, test_comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_reduce_scatter_block(my_send_vector, my_recv_block,
+                                     (test_count_t)block_count, dtype,
+                                     op, test_comm);
+        }
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         * The reduce-scatter-block operation performs a reduction (sum) for all
+         * elements of the input array then scatters the reduction result such that
+         * each task gets block_count elements, the block of task i starting at
+         * element i * block_count.
+         * Task r sets input array element i to (i + r) modulo a prime number, so
+         * the output value for each array element must be the sum of these over
+         * all the tasks in the application
+         * (see the test_ops table for the closed form of each op).
+         * The gap before the results must not be modified.
+         */
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            num_wrong += check_value(tt, my_recv_vector, 0, skip, -1, &first_bad);
+            in_lbound = block_count * world_rank;
+            num_wrong += check_op_result(tt, test_op, my_recv_block, block_count,
+                                         in_lbound, world_size, &block_first_bad);
+            if( SIZE_MAX != block_first_bad && skip + block_first_bad < first_bad ) {
+                first_bad = skip + block_first_bad;
+            }
+        }
+    }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, payload_size_actual);
+
+    if( 0 == num_wrong) {
+        printf("Rank %2d: PASSED\n", world_rank);
+    } else {
+        printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
+               num_wrong, skip + block_count,
+               ((num_wrong * 1.0) / (skip + block_count))*100.0);
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad);
+        ret = 1;
+    }
+
+    record_result(mpi_function, dtype, total_num_elements, payload_size_actual,
+                  variant, mode, false, num_wrong, &timer);
+
+    if( NULL != my_send_vector ) {
+        safe_free(my_send_vector);
+    }
+    if( NULL != my_recv_vector ){
+        safe_free(my_recv_vector);
+    }
+
+    fflush(NULL);
+    MPI_Barrier(test_comm);
+
+    return ret;
+}
+
+/*
+ * Run one payload size of the sweep (see run_sweep)
+ */
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant)
+{
+    return my_c_test_core(dtype, total_num_elements, MODE_PACKED, variant);
+}
@@ -9,8 +9,11 @@
 
 #include <mpi.h>
 #include "common.h"
+#include "reference.h"
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool blocking);
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool in_place, int variant);
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant);
+static int run_tests(void);
 
 int main(int argc, char** argv) {
     /*
@@ -21,114 +24,104 @@ int main(int argc, char** argv) {
     MPI_Init(NULL, NULL);
     init_environment(argc, argv);
 
-    // Run the tests
+    // Run the tests on each communicator shape (BIGCOUNT_COMM_SHAPES)
+    ret = run_comm_shapes(run_tests);
+
+    /*
+     * All done
+     */
+    MPI_Finalize();
+    return ret;
+}
+
+/*
+ * Packed count of a datatype (as passed to my_c_test_core)
+ */
+static size_t packed_count(const test_type_t *tt)
+{
 #ifndef TEST_UNIFORM_COUNT
-    // Each rank contribues: V_SIZE_INT / world_size elements
-    // Largest buffer is   : V_SIZE_INT elements
-    ret += my_c_test_core(MPI_INT, V_SIZE_INT,MODE_PACKED, true);
-    // Adjust these to be V_SIZE_INT - displacement strides so it will pass
-    ret += my_c_test_core(MPI_INT,
-                          (V_SIZE_INT - disp_stride*world_size),
-                          MODE_SKIP, true);
-
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, MODE_PACKED,
-                          true);
-    // Adjust these to be V_SIZE_INT - displacement strides so it will pass
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX,
-                          (V_SIZE_DOUBLE_COMPLEX - disp_stride*world_size),
-                          MODE_SKIP, true);
-    if (allow_nonblocked) {
-        ret += my_c_test_core(MPI_INT, V_SIZE_INT,MODE_PACKED, false);
-        // Adjust these to be V_SIZE_INT - displacement strides so it will pass
-        ret += my_c_test_core(MPI_INT,
-                              (V_SIZE_INT - disp_stride*world_size),
-                              MODE_SKIP, false);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, V_SIZE_DOUBLE_COMPLEX, MODE_PACKED,
-                              false);
-        // Adjust these to be V_SIZE_INT - displacement strides so it will pass
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX,
-                              (V_SIZE_DOUBLE_COMPLEX - disp_stride*world_size),
-                              MODE_SKIP, false);
-    }
+    // Each rank contribues: V_SIZE / world_size elements
+    // Largest buffer is   : V_SIZE elements
+    return tt->v_size;
 #else
-    size_t proposed_count;
-
     // Each rank contribues: TEST_UNIFORM_COUNT elements
     // Largest buffer is   : TEST_UNIFORM_COUNT x world_size
 
     // Note: Displacement is an int, so the recv buffer cannot be too large as to overflow the int
     // As such divide by the world_size
-    proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT / (size_t)world_size,
-                                        (size_t)world_size, 1);
-    ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, MODE_PACKED, true);
-    // Adjust these to be V_SIZE_INT - displacement strides so it will pass
-    ret += my_c_test_core(MPI_INT,
-                          (proposed_count - disp_stride*world_size) * (size_t)world_size,
-                          MODE_SKIP, true);
+    return calc_coll_count("scatterv", tt->size, TEST_UNIFORM_COUNT / (size_t)world_size) * (size_t)world_size;
+#endif
+}
 
-    // Note: Displacement is an int, so the recv buffer cannot be too large as to overflow the int
-    // As such divide by the world_size
-    proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT / (size_t)world_size,
-                                        (size_t)world_size, 1);
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, MODE_PACKED, true);
-    // Adjust these to be V_SIZE_INT - displacement strides so it will pass
-    ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX,
-                          (proposed_count - disp_stride*world_size) * (size_t)world_size,
-                          MODE_SKIP, true);
-    if (allow_nonblocked) {
-        proposed_count = calc_uniform_count(sizeof(int), TEST_UNIFORM_COUNT / (size_t)world_size,
-                                            (size_t)world_size, 1);
-        ret += my_c_test_core(MPI_INT, proposed_count * (size_t)world_size, MODE_PACKED, false);
-        ret += my_c_test_core(MPI_INT,
-                              (proposed_count - disp_stride*world_size) * (size_t)world_size,
-                              MODE_SKIP, false);
-        proposed_count = calc_uniform_count(sizeof(double _Complex), TEST_UNIFORM_COUNT / (size_t)world_size,
-                                            (size_t)world_size, 1);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX, proposed_count * (size_t)world_size, MODE_PACKED,
-                              false);
-        ret += my_c_test_core(MPI_C_DOUBLE_COMPLEX,
-                              (proposed_count - disp_stride*world_size) * (size_t)world_size,
-                              MODE_SKIP, false);
+/*
+ * Run all the test cases on test_comm
+ */
+static int run_tests(void)
+{
+    int ret = 0, v, t;
+    size_t count, skip_count;
+
+    if( sweep_enabled ) {
+        return run_sweep("scatterv", (size_t)world_size, sweep_case);
+    }
+    if( num_strides > 0 ) {
+        return run_stride_sweep("scatterv", packed_count(&test_types[sweep_type]), my_c_test_core);
+    }
+
+    // Run the tests of each enabled variant and datatype (BIGCOUNT_DATATYPES)
+    for( v = 0; v < NUM_COLL_VARIANTS; ++v ) {
+        if( !variant_enabled(v) ) {
+            continue;
+        }
+        for( t = 0; t < NUM_TEST_TYPES; ++t ) {
+            if( !test_types[t].enabled ) {
+                continue;
+            }
+            count = packed_count(&test_types[t]);
+            // Adjust these to be V_SIZE - displacement strides so it will pass
+            skip_count = count - disp_stride*world_size;
+            ret += my_c_test_core(test_types[t].dtype, count, MODE_PACKED, false, v);
+            ret += my_c_test_core(test_types[t].dtype, skip_count, MODE_SKIP, false, v);
+        }
     }
-#endif
 
-    /*
-     * All done
-     */
-    MPI_Finalize();
     return ret;
 }
 
-int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool blocking)
+int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool in_place, int variant)
 {
     int ret = 0;
-    size_t i;
     MPI_Request request;
-    char *mpi_function = blocking ? "MPI_Scatterv" : "MPI_Iscatterv";
+    coll_timer_t timer;
+    const test_type_t *tt = find_test_type(dtype);
+    char *mpi_function = (COLL_BLOCKING == variant) ? "MPI_Scatterv" :
+                         (COLL_NONBLOCKING == variant) ? "MPI_Iscatterv" :
+                         (COLL_PERSISTENT == variant) ? "MPI_Scatterv_init" : "ref_scatterv";
 
     // Actual payload size as divisible by the sizeof(dt)
-    size_t payload_size_actual;
+    size_t payload_size_actual = 0;
 
     /*
      * Initialize vector
      */
-    int *my_int_send_vector = NULL;
-    int *my_int_recv_vector = NULL;
-    int int_exp;
-
-    double _Complex *my_dc_send_vector = NULL;
-    double _Complex *my_dc_recv_vector = NULL;
-    double _Complex dc_exp;
-
-    int *my_send_counts = NULL;
-    int *my_send_disp = NULL;
-    int recv_count = 0;
+    void *my_send_vector = NULL;
+    void *my_recv_vector = NULL;
+    void *recv_arg = NULL;
+    void *check_vector = NULL;
+    size_t check_base;
+
+    test_count_t *my_send_counts = NULL;
+    test_disp_t *my_send_disp = NULL;
+    test_count_t recv_count = 0;
     int d_idx, r_idx;
-    size_t last_disp, last_count;
+    size_t last_disp, last_count, seg_begin;
     size_t num_wrong = 0;
+    size_t first_bad = SIZE_MAX;
     size_t v_size, v_rem;
 
-    assert(MPI_INT == dtype || MPI_C_DOUBLE_COMPLEX == dtype);
+    if( journal_start(dtype, &total_num_elements, mode, in_place, variant, &ret) ) {
+        return ret;
+    }
 
     // total_num_elements = send_size (at root)
     // recv_count         = recv_count
@@ -137,8 +130,8 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool
     if (0 != v_rem && world_rank == world_size-1) {
         v_size += v_rem;
     }
-    assert(recv_count <= INT_MAX);
-    recv_count = (int)v_size;
+    assert(recv_count <= TEST_COUNT_MAX);
+    recv_count = (test_count_t)v_size;
 
     if (world_rank == 0) {
         if( MODE_PACKED == mode ) {
@@ -150,15 +143,10 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool
              * NP = 4 and total_num_elements = 9 then the final buffer will be:
              * [1, 1, 2, 2, 3, 3, 4, 4, 4]
              */
-            if( MPI_INT == dtype ) {
-                payload_size_actual = total_num_elements * sizeof(int);
-                my_int_send_vector = (int*)safe_malloc(payload_size_actual);
-            } else {
-                payload_size_actual = total_num_elements * sizeof(double _Complex);
-                my_dc_send_vector = (double _Complex*)safe_malloc(payload_size_actual);
-            }
-            my_send_counts = (int*)safe_malloc(sizeof(int) * world_size);
-            my_send_disp   = (int*)safe_malloc(sizeof(int) * world_size);
+            payload_size_actual = total_num_elements * tt->size;
+            my_send_vector = safe_malloc(payload_size_actual);
+            my_send_counts = (test_count_t*)safe_malloc(sizeof(test_count_t) * world_size);
+            my_send_disp   = (test_disp_t*)safe_malloc(sizeof(test_disp_t) * world_size);
             last_disp = 0;
             last_count = v_size;
 
@@ -166,41 +154,17 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool
                 if (0 != v_rem && d_idx == world_size-1) {
                     last_count += v_rem;
                 }
-                assert(last_count <= INT_MAX);
-                my_send_counts[d_idx] = (int)last_count;
-                assert(last_disp <= INT_MAX);
-                my_send_disp[d_idx]   = (int)last_disp;
+                assert(last_count <= TEST_COUNT_MAX);
+                my_send_counts[d_idx] = (test_count_t)last_count;
+                assert(last_disp <= TEST_COUNT_MAX);
+                my_send_disp[d_idx]   = (test_disp_t)last_disp;
                 if( debug > 0 ) {
-                    printf("d_idx %3d / last_disp %9d / last_count %9d | total_count %10zu / payload_size %10zu\n",
-                           d_idx, (int)last_disp, (int)last_count, total_num_elements, payload_size_actual);
+                    printf("d_idx %3d / last_disp %9zu / last_count %9zu | total_count %10zu / payload_size %10zu\n",
+                           d_idx, last_disp, last_count, total_num_elements, payload_size_actual);
                 }
                 // Shift displacement by the count for tightly packed buffer
                 last_disp += last_count;
             }
-
-            r_idx = 0;
-            if( world_size > 1 ) {
-                last_disp = my_send_counts[r_idx] + my_send_disp[r_idx];
-            } else {
-                last_disp = 0;
-            }
-            if( MPI_INT == dtype ) {
-                for(i = 0; i < total_num_elements; ++i) {
-                    if( world_size > r_idx+1 && i == last_disp ) {
-                        ++r_idx;
-                        last_disp = my_send_counts[r_idx] + my_send_disp[r_idx];
-                    }
-                    my_int_send_vector[i] = 1 + r_idx;
-                }
-            } else {
-                for(i = 0; i < total_num_elements; ++i) {
-                    if( world_size > r_idx+1 && i == last_disp ) {
-                        ++r_idx;
-                        last_disp = my_send_counts[r_idx] + my_send_disp[r_idx];
-                    }
-                    my_dc_send_vector[i] = 1.0*(1+r_idx) + 1.0*(1+r_idx)*I;
-                }
-            }
         } else {
             /* Strategy for testing:
              *  - Displacement should skip 2 elements before first element and between each peer making a small gap
@@ -212,15 +176,10 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool
              */
             total_num_elements += disp_stride * (size_t)world_size;
 
-            if( MPI_INT == dtype ) {
-                payload_size_actual = total_num_elements * sizeof(int);
-                my_int_send_vector = (int*)safe_malloc(payload_size_actual);
-            } else {
-                payload_size_actual = total_num_elements * sizeof(double _Complex);
-                my_dc_send_vector = (double _Complex*)safe_malloc(payload_size_actual);
-            }
-            my_send_counts = (int*)safe_malloc(sizeof(int) * world_size);
-            my_send_disp   = (int*)safe_malloc(sizeof(int) * world_size);
+            payload_size_actual = total_num_elements * tt->size;
+            my_send_vector = safe_malloc(payload_size_actual);
+            my_send_counts = (test_count_t*)safe_malloc(sizeof(test_count_t) * world_size);
+            my_send_disp   = (test_disp_t*)safe_malloc(sizeof(test_disp_t) * world_size);
             last_disp = disp_stride;
             last_count = v_size;
 
@@ -228,169 +187,132 @@ int my_c_test_core(MPI_Datatype dtype, size_t total_num_elements, int mode, bool
                 if (0 != v_rem && d_idx == world_size-1) {
                     last_count += v_rem;
                 }
-                assert(last_count <= INT_MAX);
-                my_send_counts[d_idx] = (int)last_count;
-                assert(last_disp <= INT_MAX);
-                my_send_disp[d_idx]   = (int)last_disp;
+                assert(last_count <= TEST_COUNT_MAX);
+                my_send_counts[d_idx] = (test_count_t)last_count;
+                assert(last_disp <= TEST_COUNT_MAX);
+                my_send_disp[d_idx]   = (test_disp_t)last_disp;
                 if( debug  > 0) {
-                    printf("d_idx %3d / last_disp %9d / last_count %9d | total_count %10zu / payload_size %10zu\n",
-                           d_idx, (int)last_disp, (int)last_count, total_num_elements, payload_size_actual);
+                    printf("d_idx %3d / last_disp %9zu / last_count %9zu | total_count %10zu / payload_size %10zu\n",
+                           d_idx, last_disp, last_count, total_num_elements, payload_size_actual);
                 }
                 // Shift displacement by the count for tightly packed buffer
                 last_disp += last_count + disp_stride;
             }
+        }
 
-            r_idx = 0;
-            if( world_size > 1 ) {
-                last_disp = my_send_counts[r_idx] + my_send_disp[r_idx];
-            } else {
-                last_disp = 0;
-            }
-
-            if( MPI_INT == dtype ) {
-                for(i = 0; i < total_num_elements; ++i) {
-                    if( world_size > r_idx+1 && i == last_disp ) {
-                        ++r_idx;
-                        last_disp = my_send_counts[r_idx] + my_send_disp[r_idx];
-                    }
-                    if( i < my_send_disp[r_idx] ) {
-                        my_int_send_vector[i] = -1;
-                    } else {
-                        my_int_send_vector[i] = 1 + r_idx;
-                    }
-                }
-            } else {
-                for(i = 0; i < total_num_elements; ++i) {
-                    if( world_size > r_idx+1 && i == last_disp ) {
-                        ++r_idx;
-                        last_disp = my_send_counts[r_idx] + my_send_disp[r_idx];
-                    }
-                    if( i < my_send_disp[r_idx] ) {
-                        my_dc_send_vector[i] = -1.0 - 1.0*I;
-                    } else {
-                        my_dc_send_vector[i] = 1.0*(1+r_idx) + 1.0*(1+r_idx)*I;
-                    }
-                }
-            }
+        last_disp = 0;
+        for(r_idx = 0; r_idx < world_size; ++r_idx) {
+            // The gap before the segment (skip mode), then the constant value of peer r_idx
+            seg_begin = (size_t)my_send_disp[r_idx];
+            fill_value(tt, (char*)my_send_vector + last_disp * tt->size, seg_begin - last_disp, -1);
+            fill_value(tt, (char*)my_send_vector + seg_begin * tt->size, (size_t)my_send_counts[r_idx],
+                       gather_value(r_idx, 0));
+            last_disp = seg_begin + (size_t)my_send_counts[r_idx];
         }
     }
 
-    if( MPI_INT == dtype ) {
-        my_int_recv_vector = (int*)safe_malloc(sizeof(int) * recv_count);
-        for(i = 0; i < recv_count; ++i) {
-            my_int_recv_vector[i] = -1;
-        }
+    my_recv_vector = safe_malloc(tt->size * recv_count);
+    fill_value(tt, my_recv_vector, recv_count, -1);
+    // With MPI_IN_PLACE the segment of the root stays in the send buffer
+    if( in_place && world_rank == 0 ) {
+        recv_arg = MPI_IN_PLACE;
+        check_vector = my_send_vector;
+        check_base = (size_t)my_send_disp[0];
     } else {
-        my_dc_recv_vector = (double _Complex*)safe_malloc(sizeof(double _Complex) * recv_count);
-        for(i = 0; i < recv_count; ++i) {
-            my_dc_recv_vector[i] = -1.0 - 1.0*I;
-        }
+        recv_arg = my_recv_vector;
+        check_vector = my_recv_vector;
+        check_base = 0;
     }
 
     if (world_rank == 0) {
-        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): Mode: %s\n",
-               mpi_function, (MPI_INT == dtype ? "int" : "double _Complex"),
+        printf("---------------------\nResults from %s(%s x %zu = %zu or %s): Mode: %s%s\n",
+               mpi_function, tt->name,
                total_num_elements, payload_size_actual, human_bytes(payload_size_actual),
-               (MODE_PACKED == mode) ? "PACKED" : "SKIPPY");
+               ((MODE_PACKED == mode) ? "PACKED" : "SKIPPY"),
+               ((in_place) ? " MPI_IN_PLACE" : ""));
     }
 
-    if (blocking) {
-        if( MPI_INT == dtype ) {
-            MPI_Scatterv(my_int_send_vector, my_send_counts, my_send_disp, dtype,
-                         my_int_recv_vector, recv_count, dtype,
-                         0, MPI_COMM_WORLD);
-        } else {
-            MPI_Scatterv(my_dc_send_vector, my_send_counts, my_send_disp, dtype,
-                         my_dc_recv_vector, recv_count, dtype,
-                         0, MPI_COMM_WORLD);
-        }
+    timer_init(&timer, variant);
+    if( COLL_PERSISTENT == variant ) {
+        timer_setup_start(&timer);
+        MPI_PCOLL(Scatterv)(my_send_vector, my_send_counts, my_send_disp, dtype,
+                            recv_arg, recv_count, dtype,
+                            0, test_comm, MPI_INFO_NULL, &request);
+        timer_setup_stop(&timer);
     }
-    else {
-        if( MPI_INT == dtype ) {
-            MPI_Iscatterv(my_int_send_vector, my_send_counts, my_send_disp, dtype,
-                         my_int_recv_vector, recv_count, dtype,
-                         0, MPI_COMM_WORLD, &request);
-        } else {
-            MPI_Iscatterv(my_dc_send_vector, my_send_counts, my_send_disp, dtype,
-                         my_dc_recv_vector, recv_count, dtype,
-                         0, MPI_COMM_WORLD, &request);
+    while( timer_more(&timer) ) {
+        // Poison the result of the previous start of the persistent request
+        if( timer_poison_due(&timer) ) {
+            fill_value(tt, my_recv_vector, recv_count, -1);
         }
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
-    }
-
-    /*
-     * Check results.
-     */
-    int_exp = 0;
-
-    if( MODE_PACKED == mode ) {
-        for(i = 0; i < recv_count; ++i) {
-            int_exp = 1 + world_rank;
-            if( MPI_INT == dtype ) {
-                if( debug > 1) {
-                    printf("%2d CHECK: %2zu : %3d vs %3d\n",
-                           world_rank, i, my_int_recv_vector[i], int_exp);
-                }
-                if(my_int_recv_vector[i] != int_exp) {
-                    ++num_wrong;
-                }
-            } else {
-                dc_exp = 1.0*int_exp + 1.0*int_exp*I;
-                if( debug > 1) {
-                    printf("%2d CHECK: %2zu : (%14.0f,%14.0fi) vs (%14.0f,%14.0fi)\n",
-                           world_rank, i, creal(my_dc_recv_vector[i]), cimag(my_dc_recv_vector[i]), creal(dc_exp), cimag(dc_exp));
-                }
-                if(my_dc_recv_vector[i] != dc_exp) {
-                    ++num_wrong;
-                }
-            }
+        timer_start(&timer);
+        if (COLL_BLOCKING == variant) {
+            MPI_COLL(MPI_Scatterv)(my_send_vector, my_send_counts, my_send_disp, dtype,
+                                   recv_arg, recv_count, dtype,
+                                   0, test_comm);
         }
-    } else {
-        for(i = 0; i < recv_count; ++i) {
-            int_exp = 1 + world_rank;
-            if( MPI_INT == dtype ) {
-                if( debug > 1) {
-                    printf("%2d CHECK: %2zu : %3d vs %3d\n",
-                           world_rank, i, my_int_recv_vector[i], int_exp);
-                }
-                if(my_int_recv_vector[i] != int_exp) {
-                    ++num_wrong;
-                }
-            } else {
-                dc_exp = 1.0*int_exp + 1.0*int_exp*I;
-                if( debug > 1) {
-                    printf("%2d CHECK: %2zu : (%14.0f,%14.0fi) vs (%14.0f,%14.0fi)\n",
-                           world_rank, i, creal(my_dc_recv_vector[i]), cimag(my_dc_recv_vector[i]), creal(dc_exp), cimag(dc_exp));
-                }
-                if(my_dc_recv_vector[i] != dc_exp) {
-                    ++num_wrong;
-                }
+        else if (COLL_NONBLOCKING == variant) {
+            MPI_COLL(MPI_Iscatterv)(my_send_vector, my_send_counts, my_send_disp, dtype,
+                                   recv_arg, recv_count, dtype,
+                                   0, test_comm, &request);
+            timer_wait(&timer, &request);
+        }
+        else if (COLL_PERSISTENT == variant) {
+            MPI_Start(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        else {
+            ref_scatterv(my_send_vector, my_send_counts, my_send_disp, dtype,
+                         recv_arg, recv_count, dtype,
+                         0, test_comm);
+        }
+        timer_stop(&timer);
+
+        /*
+         * Check results (after every start of the persistent request).
+         */
+        if( 0 == num_wrong && timer_check_due(&timer) ) {
+            num_wrong = check_value(tt, check_vector, check_base, (size_t)recv_count,
+                                    gather_value(world_rank, 0), &first_bad);
+            if( debug > 1) {
+                printf("%2d CHECK: %s [%3zu + %3zu] : %zu wrong\n", world_rank, (0 == num_wrong) ? "ok " : "BAD",
+                       check_base, (size_t)recv_count, num_wrong);
             }
         }
     }
+    if( COLL_PERSISTENT == variant ) {
+        MPI_Request_free(&request);
+    }
+    timer_report(&timer, payload_size_actual);
 
     if( 0 == num_wrong) {
         printf("Rank %2d: PASSED\n", world_rank);
     } else {
         printf("Rank %2d: ERROR: DI in %14zu of %14zu slots (%6.1f %% wrong)\n", world_rank,
                num_wrong, total_num_elements, ((num_wrong * 1.0)/total_num_elements)*100.0);
+        printf("Rank %2d: ERROR: First wrong slot at index %zu\n", world_rank, first_bad - check_base);
         ret = 1;
     }
 
-    if( NULL != my_int_send_vector ) {
-        free(my_int_send_vector);
-    }
-    if( NULL != my_int_recv_vector ){
-        free(my_int_recv_vector);
-    }
-    if( NULL != my_dc_send_vector ) {
-        free(my_dc_send_vector);
+    record_result(mpi_function, dtype, total_num_elements, payload_size_actual,
+                  variant, mode, in_place, num_wrong, &timer);
+
+    if( NULL != my_send_vector ) {
+        safe_free(my_send_vector);
     }
-    if( NULL != my_dc_recv_vector ){
-        free(my_dc_recv_vector);
+    if( NULL != my_recv_vector ){
+        safe_free(my_recv_vector);
     }
     fflush(NULL);
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(test_comm);
 
     return ret;
 }
+
+/*
+ * Run one payload size of the sweep (see run_sweep)
+ */
+static int sweep_case(MPI_Datatype dtype, size_t total_num_elements, int variant)
+{
+    return my_c_test_core(dtype, total_num_elements, MODE_PACKED, false, variant);
+}